@@ -28,13 +28,60 @@
 
 // valid sound buffer sizes for audio:
 #define DEFAULTSOUNDBUFFERSIZE (2048)
-#define MINSOUNDBUFFERSIZE 512
+#define MINSOUNDBUFFERSIZE 128
 #define MAXSOUNDBUFFERSIZE (1024 * 10)
 
 // since waveout is shit, we'll need a bigger buffer for it:
 #define WAVEOUTMINBUFFERSIZE (2048)
 
 #ifdef USE_AUDIO
+#if defined(USE_SDL_AUDIO) || defined(WINDOWS)
+
+#include "audio.h"
+
+// device timing statistics, updated by the sound thread:
+static int statlatency = 0;
+static int statbuffertime = 0;  // how long one buffer plays in microseconds
+static int statunderruns = 0;
+static int statcallbacktime = 0;
+static int statcallbacktimepeak = 0;
+
+static void audio_ResetStats(int latency, int buffertime) {
+    __atomic_store_n(&statlatency, latency, __ATOMIC_RELAXED);
+    __atomic_store_n(&statbuffertime, buffertime, __ATOMIC_RELAXED);
+    __atomic_store_n(&statunderruns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&statcallbacktime, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&statcallbacktimepeak, 0, __ATOMIC_RELAXED);
+}
+
+static void audio_RecordCallbackTime(int microseconds) { // SOUND THREAD
+    // a callback taking longer than its buffer plays can't keep up:
+    if (microseconds > __atomic_load_n(&statbuffertime, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&statunderruns, 1, __ATOMIC_RELAXED);
+    }
+
+    // keep a moving average:
+    int average = __atomic_load_n(&statcallbacktime, __ATOMIC_RELAXED);
+    __atomic_store_n(&statcallbacktime, (average * 15 + microseconds) / 16,
+    __ATOMIC_RELAXED);
+
+    if (microseconds > __atomic_load_n(&statcallbacktimepeak,
+    __ATOMIC_RELAXED)) {
+        __atomic_store_n(&statcallbacktimepeak, microseconds,
+        __ATOMIC_RELAXED);
+    }
+}
+
+void audio_GetStats(struct audiostats* stats) {
+    stats->latency = __atomic_load_n(&statlatency, __ATOMIC_RELAXED);
+    stats->underruns = __atomic_load_n(&statunderruns, __ATOMIC_RELAXED);
+    stats->callbacktime = __atomic_load_n(&statcallbacktime,
+    __ATOMIC_RELAXED);
+    stats->callbacktimepeak = __atomic_exchange_n(&statcallbacktimepeak, 0,
+    __ATOMIC_RELAXED);
+}
+
+#endif  // USE_SDL_AUDIO || WINDOWS
 #ifdef USE_SDL_AUDIO
 
 #include "SDL.h"
@@ -43,7 +90,10 @@ static void (*samplecallbackptr)(void*, unsigned int) = NULL;
 static int soundenabled = 0;
 
 void audiocallback(void *intentionally_unused, Uint8 *stream, int len) {
+    Uint64 start = SDL_GetPerformanceCounter();
     samplecallbackptr(stream, (unsigned int)len);
+    audio_RecordCallbackTime((int)((SDL_GetPerformanceCounter() - start) *
+    1000000 / SDL_GetPerformanceFrequency()));
 }
 
 const char* audio_GetCurrentBackendName() {
@@ -168,6 +218,11 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
         return 0;
     }
 
+    // SDL double-buffers, so the latency is about two buffers:
+    int buffertime = (int)((uint64_t)actualfmt.samples * 1000000 /
+    actualfmt.freq);
+    audio_ResetStats((buffertime * 2) / 1000, buffertime);
+
     soundenabled = 1;
     SDL_PauseAudio(0);
     return 1;
@@ -239,7 +294,13 @@ static void queueBlock(void) {
     waveheader[i].dwLoops = 0;
 
     // set block audio data:
+    LARGE_INTEGER start,end,frequency;
+    QueryPerformanceCounter(&start);
     samplecallbackptr(blockbuffer[i], (unsigned int)waveoutbytes);
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&frequency);
+    audio_RecordCallbackTime((int)((end.QuadPart - start.QuadPart) *
+    1000000 / frequency.QuadPart));
     waveheader[i].lpData = blockbuffer[i];
 
     // queue up block:
@@ -446,9 +507,10 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
     waveoutfmt.nBlockAlign = (2 * 16) / 8;
     waveoutfmt.nAvgBytesPerSec = waveoutfmt.nSamplesPerSec * waveoutfmt.nBlockAlign;
 
+    // waveout buffers are sized in bytes, the requested size in samples:
     int custombuffersize = DEFAULTSOUNDBUFFERSIZE;
     if (buffersize > 0) {
-        custombuffersize = buffersize;
+        custombuffersize = buffersize * waveoutfmt.nBlockAlign;
     }
     if (custombuffersize < WAVEOUTMINBUFFERSIZE) {
         custombuffersize = WAVEOUTMINBUFFERSIZE;
@@ -458,6 +520,12 @@ unsigned int buffersize, const char* backend, int s16, char** error) {
     }
     waveoutbytes = custombuffersize;
     samplecallbackptr = samplecallback;
+
+    // all queued blocks are in front of newly mixed audio:
+    int buffertime = (int)((uint64_t)(waveoutbytes / waveoutfmt.nBlockAlign)
+    * 1000000 / waveoutfmt.nSamplesPerSec);
+    audio_ResetStats((buffertime * AUDIOBLOCKS) / 1000, buffertime);
+
     waveout_LaunchWaveoutThread();
 
     time_Sleep(50);
@@ -28,6 +28,13 @@ const char* audio_GetCurrentBackendName(void);
 
 #include "os.h"
 
+struct audiostats {
+    int latency;  // approximate output latency in milliseconds
+    int underruns;  // callbacks that took longer than their buffer plays
+    int callbacktime;  // average callback duration in microseconds
+    int callbacktimepeak;  // longest callback since the last query
+};
+
 #if defined(USE_SDL_AUDIO) || defined(WINDOWS)
 
 int audio_Init(void (*samplecallback)(void*, unsigned int bytes),
@@ -36,8 +43,8 @@ unsigned int buffersize, const char* backend, int s16, char** error);
 // error will be modified so *error points at an error message you
 // must free() yourself).
 // Pass either 0/NULL to buffersize/backend, or:
-//  buffersize: preferred sound buffer size (lower = less stable but
-//              less latency)
+//  buffersize: preferred sound buffer size in samples per channel
+//              (lower = less stable but less latency)
 //  backend: available alternative backends like "waveout" on windows.
 //  s16: if 1, you will need to feed 16bit signed int audio.
 //       if 0, you need to feed 32bit float audio.
@@ -56,6 +63,11 @@ void audio_UnlockAudioThread(void);
 void audio_Quit(void);
 // Quit audio backend completely
 
+void audio_GetStats(struct audiostats* stats);
+// Get latency and callback timing information about the opened audio
+// device. The underrun count and statistics start over with each
+// audio_Init().
+
 #else  // USE_SDL_AUDIO || WINDOWS
 
 #define compiled_without_audio "No audio available - this binary was compiled with audio (including null device) disabled"
@@ -0,0 +1,331 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "audiosource.h"
+#include "audioconvertkernel.h"
+#include "audiomixerkernel.h"
+
+// Like the mixing kernels, the SSE2 kernels are compiled with per-function
+// target attributes and only picked by audioconvertkernel_Init() when the
+// CPU supports them. NEON is part of the baseline on ARM targets that
+// define __ARM_NEON, so those kernels are simply compiled in there.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define CONVERTKERNEL_X86
+#include <immintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define CONVERTKERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+// The C kernels load and store through memcpy() since the buffers passed
+// in may be unaligned and source and target may overlap (in place use).
+// Conversions to s16le round to nearest (like fastdoubletoint32 does in
+// regular builds) instead of truncating.
+
+static void audioconvertkernel_U8ToS16C(void* target, const void* source,
+unsigned int samples) {
+    const unsigned char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        int16_t v = (int16_t)lrint(((int)s[i] - 128) * (32767.0 / 128.0));
+        memcpy(t + i * 2, &v, sizeof(v));
+        i++;
+    }
+}
+
+static void audioconvertkernel_U8ToF32C(void* target, const void* source,
+unsigned int samples) {
+    const unsigned char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        float v = ((int)s[i] - 128) * (1.0f / 128.0f);
+        memcpy(t + i * 4, &v, sizeof(v));
+        i++;
+    }
+}
+
+static void audioconvertkernel_S16ToF32C(void* target, const void* source,
+unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        int16_t old;
+        memcpy(&old, s + i * 2, sizeof(old));
+        float v = old * (1.0f / 32768.0f);
+        memcpy(t + i * 4, &v, sizeof(v));
+        i++;
+    }
+}
+
+static inline int32_t audioconvertkernel_LoadS24(const unsigned char* b) {
+    // shift the sample into the upper 24 bits to get the sign right:
+    return (int32_t)(((uint32_t)b[0] << 8) |
+    ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 24));
+}
+
+static void audioconvertkernel_S24ToS16C(void* target, const void* source,
+unsigned int samples) {
+    const unsigned char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        int32_t old = audioconvertkernel_LoadS24(s + i * 3) / 256;
+        int16_t v = (int16_t)lrint(old * (32767.0 / 8388608.0));
+        memcpy(t + i * 2, &v, sizeof(v));
+        i++;
+    }
+}
+
+static void audioconvertkernel_S24ToF32C(void* target, const void* source,
+unsigned int samples) {
+    const unsigned char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        float v = (float)audioconvertkernel_LoadS24(s + i * 3) *
+        (1.0f / 2147483648.0f);
+        memcpy(t + i * 4, &v, sizeof(v));
+        i++;
+    }
+}
+
+static void audioconvertkernel_S32ToS16C(void* target, const void* source,
+unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        int32_t old;
+        memcpy(&old, s + i * 4, sizeof(old));
+        int16_t v = (int16_t)lrint(old * (32767.0 / 2147483648.0));
+        memcpy(t + i * 2, &v, sizeof(v));
+        i++;
+    }
+}
+
+static void audioconvertkernel_S32ToF32C(void* target, const void* source,
+unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    unsigned int i = 0;
+    while (i < samples) {
+        int32_t old;
+        memcpy(&old, s + i * 4, sizeof(old));
+        float v = (float)((double)old * (1.0 / 2147483648.0));
+        memcpy(t + i * 4, &v, sizeof(v));
+        i++;
+    }
+}
+
+static void audioconvertkernel_F32ToS16(void* target, const void* source,
+unsigned int samples) {
+    // the mixer's kernel already does this (vectorized and with clipping):
+    audiomixerkernel_FloatToS16(target, source, samples);
+}
+
+#ifdef CONVERTKERNEL_X86
+
+__attribute__((target("sse2")))
+static void audioconvertkernel_S16ToF32SSE2(void* target,
+const void* source, unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    unsigned int i = 0;
+    while (i + 8 <= samples) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i * 2));
+        // duplicate each sample into both halves of a 32bit lane, then
+        // shift it down again to sign extend it:
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps((float*)(t + i * 4),
+        _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps((float*)(t + i * 4 + 16),
+        _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        i += 8;
+    }
+    audioconvertkernel_S16ToF32C(t + i * 4, s + i * 2, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void audioconvertkernel_S24ToF32SSE2(void* target,
+const void* source, unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    unsigned int i = 0;
+    // each step loads 16 bytes for 4 samples (12 bytes), so only do it
+    // while there are at least 4 more bytes of other samples behind them:
+    while (i + 6 <= samples) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i * 3));
+        // move sample 1, 2 and 3 to the start of a register each, then
+        // gather the lowest 32bit of all four:
+        __m128i ab = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+        __m128i cd = _mm_unpacklo_epi32(_mm_srli_si128(v, 6),
+        _mm_srli_si128(v, 9));
+        __m128i samples32 = _mm_slli_epi32(_mm_unpacklo_epi64(ab, cd), 8);
+        _mm_storeu_ps((float*)(t + i * 4),
+        _mm_mul_ps(_mm_cvtepi32_ps(samples32), scale));
+        i += 4;
+    }
+    audioconvertkernel_S24ToF32C(t + i * 4, s + i * 3, samples - i);
+}
+
+#endif  // CONVERTKERNEL_X86
+
+#ifdef CONVERTKERNEL_NEON
+
+static void audioconvertkernel_S16ToF32NEON(void* target,
+const void* source, unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    const float32x4_t scale = vdupq_n_f32(1.0f / 32768.0f);
+    unsigned int i = 0;
+    while (i + 8 <= samples) {
+        int16x8_t v = vld1q_s16((const int16_t*)(s + i * 2));
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32((float*)(t + i * 4), vmulq_f32(lo, scale));
+        vst1q_f32((float*)(t + i * 4 + 16), vmulq_f32(hi, scale));
+        i += 8;
+    }
+    audioconvertkernel_S16ToF32C(t + i * 4, s + i * 2, samples - i);
+}
+
+static void audioconvertkernel_S24ToF32NEON(void* target,
+const void* source, unsigned int samples) {
+    const char* s = source;
+    char* t = target;
+    const float32x4_t scale = vdupq_n_f32(1.0f / 2147483648.0f);
+    unsigned int i = 0;
+    while (i + 8 <= samples) {
+        // deinterleave the three bytes of 8 samples:
+        uint8x8x3_t b = vld3_u8((const uint8_t*)(s + i * 3));
+        // assemble b0 << 8 | b1 << 16 | b2 << 24 as 32bit value:
+        uint16x8_t low = vshll_n_u8(b.val[0], 8);
+        uint16x8_t high = vorrq_u16(vmovl_u8(b.val[1]),
+        vshll_n_u8(b.val[2], 8));
+        uint32x4_t v1 = vorrq_u32(vmovl_u16(vget_low_u16(low)),
+        vshll_n_u16(vget_low_u16(high), 16));
+        uint32x4_t v2 = vorrq_u32(vmovl_u16(vget_high_u16(low)),
+        vshll_n_u16(vget_high_u16(high), 16));
+        vst1q_f32((float*)(t + i * 4), vmulq_f32(
+        vcvtq_f32_s32(vreinterpretq_s32_u32(v1)), scale));
+        vst1q_f32((float*)(t + i * 4 + 16), vmulq_f32(
+        vcvtq_f32_s32(vreinterpretq_s32_u32(v2)), scale));
+        i += 8;
+    }
+    audioconvertkernel_S24ToF32C(t + i * 4, s + i * 3, samples - i);
+}
+
+#endif  // CONVERTKERNEL_NEON
+
+// conversion table indexed by [source format][target format]:
+#define FORMATCOUNT (AUDIOSOURCEFORMAT_S32LE + 1)
+static audioconvertkernel_func convertfuncs[FORMATCOUNT][FORMATCOUNT] = {
+    [AUDIOSOURCEFORMAT_U8] = {
+        [AUDIOSOURCEFORMAT_S16LE] = &audioconvertkernel_U8ToS16C,
+        [AUDIOSOURCEFORMAT_F32LE] = &audioconvertkernel_U8ToF32C,
+    },
+    [AUDIOSOURCEFORMAT_S16LE] = {
+        [AUDIOSOURCEFORMAT_F32LE] = &audioconvertkernel_S16ToF32C,
+    },
+    [AUDIOSOURCEFORMAT_S24LE] = {
+        [AUDIOSOURCEFORMAT_S16LE] = &audioconvertkernel_S24ToS16C,
+        [AUDIOSOURCEFORMAT_F32LE] = &audioconvertkernel_S24ToF32C,
+    },
+    [AUDIOSOURCEFORMAT_F32LE] = {
+        [AUDIOSOURCEFORMAT_S16LE] = &audioconvertkernel_F32ToS16,
+    },
+    [AUDIOSOURCEFORMAT_S32LE] = {
+        [AUDIOSOURCEFORMAT_S16LE] = &audioconvertkernel_S32ToS16C,
+        [AUDIOSOURCEFORMAT_F32LE] = &audioconvertkernel_S32ToF32C,
+    },
+};
+static const char* kernelname = "c";
+
+void audioconvertkernel_Init(void) {
+    // only the common decoder output formats have vectorized versions:
+    audioconvertkernel_func* s16tof32 =
+    &convertfuncs[AUDIOSOURCEFORMAT_S16LE][AUDIOSOURCEFORMAT_F32LE];
+    audioconvertkernel_func* s24tof32 =
+    &convertfuncs[AUDIOSOURCEFORMAT_S24LE][AUDIOSOURCEFORMAT_F32LE];
+    *s16tof32 = &audioconvertkernel_S16ToF32C;
+    *s24tof32 = &audioconvertkernel_S24ToF32C;
+    kernelname = "c";
+#ifdef CONVERTKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        *s16tof32 = &audioconvertkernel_S16ToF32SSE2;
+        *s24tof32 = &audioconvertkernel_S24ToF32SSE2;
+        kernelname = "sse2";
+    }
+#endif
+#ifdef CONVERTKERNEL_NEON
+    *s16tof32 = &audioconvertkernel_S16ToF32NEON;
+    *s24tof32 = &audioconvertkernel_S24ToF32NEON;
+    kernelname = "neon";
+#endif
+}
+
+const char* audioconvertkernel_GetName(void) {
+    return kernelname;
+}
+
+audioconvertkernel_func audioconvertkernel_Get(unsigned int sourceformat,
+unsigned int targetformat) {
+    if (sourceformat >= FORMATCOUNT || targetformat >= FORMATCOUNT) {
+        return NULL;
+    }
+    return convertfuncs[sourceformat][targetformat];
+}
+
+unsigned int audioconvertkernel_SampleSize(unsigned int format) {
+    switch (format) {
+    case AUDIOSOURCEFORMAT_U8:
+        return 1;
+    case AUDIOSOURCEFORMAT_S16LE:
+        return 2;
+    case AUDIOSOURCEFORMAT_S24LE:
+        return 3;
+    case AUDIOSOURCEFORMAT_F32LE:
+    case AUDIOSOURCEFORMAT_S32LE:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+#endif  // USE_AUDIO
@@ -0,0 +1,53 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOCONVERTKERNEL_H_
+#define BLITWIZARD_AUDIOCONVERTKERNEL_H_
+
+typedef void (*audioconvertkernel_func)(void* target, const void* source,
+unsigned int samples);
+// A sample format conversion kernel: converts the given amount of samples
+// from source into target. All kernels process the samples front to back
+// and load each group of samples before storing its result, so a
+// conversion to a format of the same or larger sample size may be done in
+// place with the source data placed at the end of the target area
+// (source = target + samples * (targetsize - sourcesize)).
+
+void audioconvertkernel_Init(void);
+// Pick the fastest conversion kernel implementations the CPU supports
+// (SSE2/NEON or plain C). Until this is called, the plain C kernels
+// are used.
+
+const char* audioconvertkernel_GetName(void);
+// Get the name of the kernel implementation in use ("sse2", "neon", "c").
+
+audioconvertkernel_func audioconvertkernel_Get(unsigned int sourceformat,
+unsigned int targetformat);
+// Get the conversion kernel for the given pair of AUDIOSOURCEFORMAT_*
+// formats. Returns NULL if that conversion is not supported.
+
+unsigned int audioconvertkernel_SampleSize(unsigned int format);
+// Get the size of one sample of the given AUDIOSOURCEFORMAT_* format
+// in bytes, or 0 for an unknown format.
+
+#endif  // BLITWIZARD_AUDIOCONVERTKERNEL_H_
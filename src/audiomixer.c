@@ -28,93 +28,411 @@
 #include <stdio.h>
 #include <limits.h>
 #include <stdint.h>
+#include <math.h>
 
 #include "os.h"
 #include "audio.h"
+#include "audiomixer.h"
 #include "audiosource.h"
 #include "audiosourcefadepanvol.h"
 #include "audiosourceresample.h"
 #include "audiosourceogg.h"
 #include "audiosourceflac.h"
+#include "audiosourcewave.h"
 #include "audiosourcefile.h"
 #include "audiosourceloop.h"
 #include "audiosourceffmpeg.h"
 #include "audiosourceprereadcache.h"
 #include "audiosourceformatconvert.h"
-#include "mathhelpers.h"
+#include "audiosamplecache.h"
+#include "audiomixerkernel.h"
+#include "audioconvertkernel.h"
+#include "spscqueue.h"
+#include "file.h"
 
 #ifndef USE_SDL_AUDIO
 #define audio_UnlockAudioThread();
 #define audio_LockAudioThread();
 #endif
 
+#define MIXSAMPLERATE 48000
+
 #ifndef ANDROID
-#define MAXCHANNELS 32
+#define DEFAULTCHANNELS 32
 #else
-#define MAXCHANNELS 8
+#define DEFAULTCHANNELS 8
 #endif
-
-int lastusedsoundid = 0;
+#define MAXCHANNELS 4096
 
 struct soundchannel {
     struct audiosource* mixsource;
     struct audiosource* fadepanvolsource;
-    struct audiosource* loopsource;
+    struct audiosource* decodeaheadsource;  // NULL if not streamed
+
+    int priority;
+    unsigned int sequence;  // start order, to steal older sounds first
+    int handle;  // index in the handle table
+    int heappos;  // position in the voice stealing heap
+
+    int bus;  // AUDIOMIXER_BUS_*
+
+    // playback position and the range it loops in, in frames
+    // (loop end 0 if not looping or the length is unknown):
+    size_t position;
+    size_t loopstart, loopend;
+
+    // scheduled start and fade in mix clock frames:
+    uint64_t startclock;  // 0 once started
+    int fadescheduled;
+    uint64_t fadeclock;
+    unsigned int fadeframes;
+    float fadevolume;
+    int fadestop;
+
+    // positional audio:
+    int positioned;
+    float x, y, z;
+    float gainleft, gainright;  // gains applied at the end of last block
+};
+static struct soundchannel* channels = NULL;
+static int channelcount = 0;
+static int playingchannels = 0;
+
+// stack of unused channel slots:
+static int* freeslots = NULL;
+static int freeslotcount = 0;
+
+// all playing channel slots as a heap with the least important
+// (lowest priority, then oldest) sound at the top for voice stealing:
+static int* stealheap = NULL;
+static int stealheapsize = 0;
+static unsigned int lastsequence = 0;
 
+// Sound ids are handles: the lower bits are an index into the handle
+// table, the upper bits the generation of that handle table entry.
+// The generation is increased each time an entry is reused, so ids
+// of old sounds never match a newer sound using the same entry.
+#define HANDLEINDEXBITS 16
+#define HANDLEINDEXMASK ((1 << HANDLEINDEXBITS) - 1)
+#define MAXHANDLEGENERATION (INT_MAX >> HANDLEINDEXBITS)
+struct soundhandle {
+    int generation;
+    int slot;  // channel slot, or -1 if not playing (yet) (SOUND THREAD)
+    int nextfree;  // next unused handle (MAIN THREAD)
+    int status;  // sound id while playing or queued, otherwise 0 (atomic)
+    int filllevel;  // decode-ahead fill level in percent (atomic)
+    unsigned int position;  // playback position in frames (atomic)
+};
+static struct soundhandle* handles = NULL;
+static int handlecount = 0;
+
+// Handles are taken by the main thread when starting a sound, and
+// returned by the audio thread through a queue when the sound ends:
+static int firstfreehandle = -1;  // MAIN THREAD
+static spscqueue* freedhandles = NULL;
+
+// Starting, stopping and adjusting sounds is done by posting commands
+// to this queue which the audio thread drains at the start of each mix,
+// so the main thread doesn't need to lock the audio thread for it.
+// Sounds are fully set up (file opened, decoder chain built and the
+// first block decoded) before their play command is posted.
+// The only producer is the main thread.
+#define MIXERCOMMAND_PLAY 1
+#define MIXERCOMMAND_STOP 2
+#define MIXERCOMMAND_ADJUST 3
+#define MIXERCOMMAND_LISTENER 4
+#define MIXERCOMMAND_DISTANCEMODEL 5
+#define MIXERCOMMAND_BUSVOLUME 6
+#define MIXERCOMMAND_BUSMUTE 7
+#define MIXERCOMMAND_FADE 8
+struct mixercommand {
+    int type;
+    int id;
+
+    // MIXERCOMMAND_PLAY:
+    struct audiosource* fadepanvolsource;
+    struct audiosource* decodeaheadsource;
     int priority;
+    int handle;
+
+    // MIXERCOMMAND_PLAY, MIXERCOMMAND_BUSVOLUME, MIXERCOMMAND_BUSMUTE:
+    int bus;
+    float fadeseconds;
+    int mute;
+
+    // MIXERCOMMAND_ADJUST, MIXERCOMMAND_FADE:
+    float volume;
+    float panning;
+    int noamplify;
+
+    // MIXERCOMMAND_PLAY (if positioned), MIXERCOMMAND_LISTENER:
+    int positioned;
+    float x, y, z;
+
+    // MIXERCOMMAND_PLAY:
+    size_t startframe;
+    size_t length;
+    size_t loopstart, loopend;
+
+    // MIXERCOMMAND_PLAY, MIXERCOMMAND_FADE (in mix clock frames):
+    uint64_t clock;
+    unsigned int fadeframes;
+    int stop;
+
+    // MIXERCOMMAND_DISTANCEMODEL:
+    float referencedistance, maxdistance, rolloff;
+};
+#define MAXMIXERCOMMANDS 1024
+static spscqueue* mixercommands = NULL;
+
+// Positions of positioned sounds are updated through a separate, larger
+// queue since games usually update all of them each frame:
+struct positionupdate {
     int id;
+    float x, y, z;
+};
+#define MAXPOSITIONUPDATES 8192
+static spscqueue* positionupdates = NULL;
+
+// Mix buses. Each sound plays on one of them, and all sounds of a bus
+// are mixed together first before the bus volume is applied (SOUND THREAD):
+struct mixbus {
+    float volume;
+    float targetvolume;
+    float fadeperframe;  // volume change per frame while fading
+    int mute;
+    float appliedgain;  // gain applied at the end of last block
+};
+static struct mixbus buses[AUDIOMIXER_BUSCOUNT] = {
+    {1, 1, 0, 0, 1}, {1, 1, 0, 0, 1}, {1, 1, 0, 0, 1}, {1, 1, 0, 0, 1}
 };
-struct soundchannel channels[MAXCHANNELS];
+
+// listener and distance model (SOUND THREAD):
+static float listenerx = 0, listenery = 0, listenerz = 0;
+static float referencedistance = 1;
+static float maxdistance = 1000;
+static float rolloff = 1;
+
+// The mixer works in fixed blocks of a power-of-two amount of frames
+// matching the device buffer, so normally each audio callback is served
+// by exactly one block:
+#define MINMIXBLOCKFRAMES 64
+#define MAXMIXBLOCKFRAMES 4096
+
+// The mix clock counts the frames mixed so far. It is advanced by the
+// audio thread and may be read by the main thread to schedule sounds:
+static uint64_t mixclock = 0;
 
 char mixedaudiobuf[256];
 int mixedaudiobuflen = 0;
 
-void audiomixer_Init(void) {
-    memset(&channels,0,sizeof(struct soundchannel) * MAXCHANNELS);
+static void audiomixer_CancelChannel(int slot);
+
+static void audiomixer_CollectFreedHandles(void) {
+    // take back handles the audio thread is done with (MAIN THREAD)
+    int h;
+    while (freedhandles && spscqueue_Pop(freedhandles, &h)) {
+        handles[h].nextfree = firstfreehandle;
+        firstfreehandle = h;
+    }
 }
 
-// Check whether no sound is playing right now (1), or if some is playing (0):
-int audiomixer_NoSoundsPlaying(void) {
-    int i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].mixsource) {
+static int audiomixer_ResizeChannels(int count) {
+    // Audio thread needs to be locked or not running.
+    // Every playing or queued sound needs a handle, so we need one
+    // for each channel, each queued command and the one currently
+    // being prepared by audiomixer_PlaySoundFromDisk:
+    int newhandlecount = count + MAXMIXERCOMMANDS + 1;
+    if (newhandlecount > handlecount) {
+        struct soundhandle* newhandles = realloc(handles,
+        sizeof(*newhandles) * newhandlecount);
+        if (!newhandles) {
             return 0;
         }
+        handles = newhandles;
+        spscqueue* newfreedhandles = spscqueue_Create(sizeof(int),
+        newhandlecount);
+        if (!newfreedhandles) {
+            return 0;
+        }
+        audiomixer_CollectFreedHandles();
+        spscqueue_Destroy(freedhandles);
+        freedhandles = newfreedhandles;
+        int i = newhandlecount - 1;
+        while (i >= handlecount) {
+            handles[i].generation = 0;
+            handles[i].slot = -1;
+            handles[i].status = 0;
+            handles[i].nextfree = firstfreehandle;
+            firstfreehandle = i;
+            i--;
+        }
+        handlecount = newhandlecount;
+    }
+
+    // stop sounds in channels which are about to go away
+    int i = count;
+    while (i < channelcount) {
+        audiomixer_CancelChannel(i);
         i++;
     }
+
+    // resize channel table:
+    struct soundchannel* newchannels = realloc(channels,
+    sizeof(*newchannels) * count);
+    if (!newchannels) {
+        return 0;
+    }
+    channels = newchannels;
+    if (count > channelcount) {
+        memset(channels + channelcount, 0,
+        sizeof(*channels) * (count - channelcount));
+    }
+    int* newfreeslots = realloc(freeslots, sizeof(int) * count);
+    if (!newfreeslots) {
+        return 0;
+    }
+    freeslots = newfreeslots;
+    int* newstealheap = realloc(stealheap, sizeof(int) * count);
+    if (!newstealheap) {
+        return 0;
+    }
+    stealheap = newstealheap;
+    channelcount = count;
+
+    // rebuild list of free slots (lowest slot on top):
+    freeslotcount = 0;
+    i = channelcount - 1;
+    while (i >= 0) {
+        if (!channels[i].mixsource) {
+            freeslots[freeslotcount] = i;
+            freeslotcount++;
+        }
+        i--;
+    }
+    return 1;
+}
+
+void audiomixer_Init(void) {
+    audiomixerkernel_Init();
+    audioconvertkernel_Init();
+    if (!mixercommands) {
+        mixercommands = spscqueue_Create(sizeof(struct mixercommand),
+        MAXMIXERCOMMANDS);
+    }
+    if (!positionupdates) {
+        positionupdates = spscqueue_Create(sizeof(struct positionupdate),
+        MAXPOSITIONUPDATES);
+    }
+    if (channelcount == 0) {
+        audiomixer_ResizeChannels(DEFAULTCHANNELS);
+    }
+}
+
+// Check whether no sound is playing right now (1), or if some is playing (0):
+int audiomixer_NoSoundsPlaying(void) {
+    if (mixercommands && spscqueue_Count(mixercommands) > 0) {
+        // sounds are about to be started
+        return 0;
+    }
+    if (playingchannels > 0) {
+        return 0;
+    }
     return 1;
 }
 
+static int audiomixer_HeapLess(int slot1, int slot2) {
+    // check if slot1 should be stolen before slot2
+    if (channels[slot1].priority != channels[slot2].priority) {
+        return (channels[slot1].priority < channels[slot2].priority);
+    }
+    return ((int)(channels[slot1].sequence - channels[slot2].sequence) < 0);
+}
+
+static void audiomixer_HeapSet(int pos, int slot) {
+    stealheap[pos] = slot;
+    channels[slot].heappos = pos;
+}
+
+static void audiomixer_HeapUp(int pos) {
+    int slot = stealheap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!audiomixer_HeapLess(slot, stealheap[parent])) {
+            break;
+        }
+        audiomixer_HeapSet(pos, stealheap[parent]);
+        pos = parent;
+    }
+    audiomixer_HeapSet(pos, slot);
+}
+
+static void audiomixer_HeapDown(int pos) {
+    int slot = stealheap[pos];
+    while (1) {
+        int child = pos * 2 + 1;
+        if (child >= stealheapsize) {
+            break;
+        }
+        if (child + 1 < stealheapsize &&
+        audiomixer_HeapLess(stealheap[child + 1], stealheap[child])) {
+            child++;
+        }
+        if (!audiomixer_HeapLess(stealheap[child], slot)) {
+            break;
+        }
+        audiomixer_HeapSet(pos, stealheap[child]);
+        pos = child;
+    }
+    audiomixer_HeapSet(pos, slot);
+}
+
+static void audiomixer_HeapRemove(int slot) {
+    int pos = channels[slot].heappos;
+    stealheapsize--;
+    if (pos == stealheapsize) {
+        return;
+    }
+    audiomixer_HeapSet(pos, stealheap[stealheapsize]);
+    audiomixer_HeapUp(pos);
+    audiomixer_HeapDown(channels[stealheap[pos]].heappos);
+}
+
+static void audiomixer_ReleaseHandle(int handle) {
+    // give a handle back to the main thread
+    handles[handle].slot = -1;
+    __atomic_store_n(&handles[handle].status, 0, __ATOMIC_RELEASE);
+    spscqueue_Push(freedhandles, &handle);
+}
+
 // Cancel channel, we are in the sound thread
 static void audiomixer_CancelChannel(int slot) {
     if (channels[slot].mixsource) {
         channels[slot].mixsource->close(channels[slot].mixsource);
         channels[slot].mixsource = NULL;
-        channels[slot].loopsource = NULL;
         channels[slot].fadepanvolsource = NULL;
-        channels[slot].id = 0;
+        channels[slot].decodeaheadsource = NULL;
+        audiomixer_HeapRemove(slot);
+        audiomixer_ReleaseHandle(channels[slot].handle);
+        freeslots[freeslotcount] = slot;
+        freeslotcount++;
+        playingchannels--;
     }
 }
 
 static int audiomixer_GetFreeChannelSlot(int priority) {
-    int i = 0;
     // first, attempt to find an empty slot
-    while (i < MAXCHANNELS) {
-        if (!channels[i].mixsource) {
-            return i;
+    if (freeslotcount == 0 && stealheapsize > 0) {
+        // then override the least important one if it's not
+        // more important than ours
+        int slot = stealheap[0];
+        if (channels[slot].priority <= priority) {
+            audiomixer_CancelChannel(slot);
         }
-        i++;
     }
-    // then override one
-    i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].mixsource) {
-            if (channels[i].priority <= priority) {
-                audiomixer_CancelChannel(priority);
-                return i;
-            }
-        }
-        i++;
+    if (freeslotcount > 0) {
+        freeslotcount--;
+        return freeslots[freeslotcount];
     }
     return -1;
 }
@@ -123,77 +441,454 @@ static int audiomixer_GetChannelSlotById(int id) {
     if (id <= 0) {
         return -1;
     }
-    int i = 0;
-    while (i < MAXCHANNELS) {
-        if (channels[i].id == id && channels[i].mixsource) {
-            return i;
-        }
+    int handle = (id & HANDLEINDEXMASK);
+    if (handle >= handlecount ||
+    __atomic_load_n(&handles[handle].generation, __ATOMIC_RELAXED) !=
+    (id >> HANDLEINDEXBITS)) {
+        return -1;
+    }
+    return handles[handle].slot;
+}
+
+static int audiomixer_TakeHandle(void) {
+    // get an unused handle (MAIN THREAD)
+    audiomixer_CollectFreedHandles();
+    if (firstfreehandle < 0) {
+        return -1;
+    }
+    int handle = firstfreehandle;
+    firstfreehandle = handles[handle].nextfree;
+    int generation = handles[handle].generation + 1;
+    if (generation > MAXHANDLEGENERATION) {
+        generation = 1;
+    }
+    __atomic_store_n(&handles[handle].generation, generation,
+    __ATOMIC_RELAXED);
+    return handle;
+}
+
+static void audiomixer_PositionGains(float x, float y, float z,
+float* left, float* right) {
+    // Calculate gains for a sound at the given position (SOUND THREAD)
+    float dx = x - listenerx;
+    float dy = y - listenery;
+    float dz = z - listenerz;
+    float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+    // distance attenuation (inverse distance, clamped):
+    float d = distance;
+    if (d < referencedistance) {
+        d = referencedistance;
+    }
+    if (d > maxdistance) {
+        d = maxdistance;
+    }
+    float gain = 1;
+    if (referencedistance > 0) {
+        gain = referencedistance / (referencedistance +
+        rolloff * (d - referencedistance));
+    }
+
+    // panning from 1 (left) to -1 (right) by horizontal direction,
+    // fading to the center for sounds very close to the listener:
+    float panning = 0;
+    float panningdistance = distance;
+    if (panningdistance < referencedistance) {
+        panningdistance = referencedistance;
+    }
+    if (panningdistance > 0) {
+        panning = -dx / panningdistance;
+    }
+    if (panning < -1) {
+        panning = -1;
+    }
+    if (panning > 1) {
+        panning = 1;
+    }
+
+    // equal-power panning:
+    float angle = (1 - panning) * (float)M_PI / 4;
+    *left = gain * cosf(angle);
+    *right = gain * sinf(angle);
+}
+
+static void audiomixer_ApplyPositioning(int slot, float* samples,
+unsigned int frames) {
+    // Apply positional gains to a block of stereo samples, going
+    // smoothly from the gains of the last block to the new ones
+    // (SOUND THREAD)
+    float left, right;
+    audiomixer_PositionGains(channels[slot].x, channels[slot].y,
+    channels[slot].z, &left, &right);
+    if (frames == 0) {
+        return;
+    }
+    float gainleft = channels[slot].gainleft;
+    float gainright = channels[slot].gainright;
+    float stepleft = (left - gainleft) / frames;
+    float stepright = (right - gainright) / frames;
+    unsigned int i = 0;
+    while (i < frames) {
+        gainleft += stepleft;
+        gainright += stepright;
+        samples[i * 2] *= gainleft;
+        samples[i * 2 + 1] *= gainright;
         i++;
     }
-    return -1;
+    channels[slot].gainleft = left;
+    channels[slot].gainright = right;
 }
 
-static int audiomixer_FreeSoundId(void) {
-    while (1) {
-        lastusedsoundid++;
-        if (lastusedsoundid >= INT_MAX-1) {
-            lastusedsoundid = 0;
-            continue;
+static void audiomixer_SpliceSound(struct mixercommand* s) {
+    // put a fully prepared sound into a channel slot.
+    // Audio thread needs to be locked or we are in the sound thread.
+    int slot = audiomixer_GetFreeChannelSlot(s->priority);
+    if (slot < 0) {
+        // all slots are busy with more important sounds
+        s->fadepanvolsource->close(s->fadepanvolsource);
+        audiomixer_ReleaseHandle(s->handle);
+        return;
+    }
+    channels[slot].fadepanvolsource = s->fadepanvolsource;
+    channels[slot].mixsource = s->fadepanvolsource;
+    channels[slot].decodeaheadsource = s->decodeaheadsource;
+    channels[slot].position = s->startframe;
+    channels[slot].loopstart = s->loopstart;
+    channels[slot].loopend = s->loopend;
+    channels[slot].startclock = s->clock;
+    channels[slot].fadescheduled = 0;
+    channels[slot].priority = s->priority;
+    channels[slot].handle = s->handle;
+    channels[slot].bus = s->bus;
+    channels[slot].positioned = s->positioned;
+    if (s->positioned) {
+        channels[slot].x = s->x;
+        channels[slot].y = s->y;
+        channels[slot].z = s->z;
+        // start right at the proper gains:
+        audiomixer_PositionGains(s->x, s->y, s->z,
+        &channels[slot].gainleft, &channels[slot].gainright);
+    }
+    lastsequence++;
+    channels[slot].sequence = lastsequence;
+    handles[s->handle].slot = slot;
+
+    // add to voice stealing heap
+    stealheapsize++;
+    audiomixer_HeapSet(stealheapsize - 1, slot);
+    audiomixer_HeapUp(stealheapsize - 1);
+    playingchannels++;
+}
+
+static void audiomixer_RunCommand(struct mixercommand* c) {
+    // Audio thread needs to be locked or we are in the sound thread.
+    if (c->type == MIXERCOMMAND_PLAY) {
+        audiomixer_SpliceSound(c);
+        return;
+    }
+    if (c->type == MIXERCOMMAND_LISTENER) {
+        listenerx = c->x;
+        listenery = c->y;
+        listenerz = c->z;
+        return;
+    }
+    if (c->type == MIXERCOMMAND_BUSVOLUME) {
+        struct mixbus* b = &buses[c->bus];
+        b->targetvolume = c->volume;
+        if (c->fadeseconds > 0) {
+            b->fadeperframe = (b->targetvolume - b->volume) /
+            (c->fadeseconds * MIXSAMPLERATE);
+        } else {
+            b->volume = b->targetvolume;
+            b->fadeperframe = 0;
         }
-        if (audiomixer_GetChannelSlotById(lastusedsoundid) >= 0) {
-            continue;
+        return;
+    }
+    if (c->type == MIXERCOMMAND_BUSMUTE) {
+        buses[c->bus].mute = c->mute;
+        return;
+    }
+    if (c->type == MIXERCOMMAND_DISTANCEMODEL) {
+        referencedistance = c->referencedistance;
+        maxdistance = c->maxdistance;
+        rolloff = c->rolloff;
+        return;
+    }
+    int slot = audiomixer_GetChannelSlotById(c->id);
+    if (slot < 0) {
+        // sound has already stopped
+        return;
+    }
+    if (c->type == MIXERCOMMAND_STOP) {
+        audiomixer_CancelChannel(slot);
+    } else if (c->type == MIXERCOMMAND_FADE) {
+        channels[slot].fadescheduled = 1;
+        channels[slot].fadeclock = c->clock;
+        channels[slot].fadeframes = c->fadeframes;
+        channels[slot].fadevolume = c->volume;
+        channels[slot].fadestop = c->stop;
+    } else if (c->type == MIXERCOMMAND_ADJUST) {
+        if (channels[slot].fadepanvolsource) {
+            audiosourcefadepanvol_SetPanVol(channels[slot].fadepanvolsource,
+            c->volume, c->panning, c->noamplify);
         }
-        break;
     }
-    return lastusedsoundid;
 }
 
-int audiomixer_IsSoundPlaying(int id) {
-    audio_LockAudioThread();
-    if (audiomixer_GetChannelSlotById(id) >= 0) {
+static void audiomixer_ProcessCommands(void) {
+    // run all commands posted by the main thread in order.
+    // Audio thread needs to be locked or we are in the sound thread.
+    if (!mixercommands) {
+        return;
+    }
+    struct mixercommand c;
+    while (spscqueue_Pop(mixercommands, &c)) {
+        audiomixer_RunCommand(&c);
+    }
+
+    // update sound positions:
+    struct positionupdate u;
+    while (positionupdates && spscqueue_Pop(positionupdates, &u)) {
+        int slot = audiomixer_GetChannelSlotById(u.id);
+        if (slot >= 0 && channels[slot].positioned) {
+            channels[slot].x = u.x;
+            channels[slot].y = u.y;
+            channels[slot].z = u.z;
+        }
+    }
+}
+
+static void audiomixer_PostCommand(struct mixercommand* c) {
+    // hand a command over to the audio thread (MAIN THREAD)
+    if (!mixercommands || !spscqueue_Push(mixercommands, c)) {
+        // queue is full (or missing), run the command directly:
+        audio_LockAudioThread();
+        audiomixer_ProcessCommands();
+        audiomixer_RunCommand(c);
         audio_UnlockAudioThread();
-        return 1;
     }
+}
+
+int audiomixer_SetMaxChannels(int count) {
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > MAXCHANNELS) {
+        count = MAXCHANNELS;
+    }
+    audio_LockAudioThread();
+    audiomixer_ProcessCommands();
+    int result = audiomixer_ResizeChannels(count);
     audio_UnlockAudioThread();
+    return result;
+}
+
+int audiomixer_IsSoundPlaying(int id) {
+    // the status of a sound is published by the audio thread,
+    // no locking needed:
+    if (id <= 0) {
+        return 0;
+    }
+    int handle = (id & HANDLEINDEXMASK);
+    if (handle >= handlecount) {
+        return 0;
+    }
+    if (__atomic_load_n(&handles[handle].status, __ATOMIC_ACQUIRE) == id) {
+        return 1;
+    }
     return 0;
 }
 
+int audiomixer_GetStreamFillLevel(int id) {
+    if (!audiomixer_IsSoundPlaying(id)) {
+        return -1;
+    }
+    return __atomic_load_n(&handles[id & HANDLEINDEXMASK].filllevel,
+    __ATOMIC_RELAXED);
+}
+
 void audiomixer_StopSound(int id) {
-    audio_LockAudioThread();
-    int slot = audiomixer_GetChannelSlotById(id);
-    if (slot >= 0) {
-        audiomixer_CancelChannel(slot);
+    if (!audiomixer_IsSoundPlaying(id)) {
+        return;
     }
-    audio_UnlockAudioThread();
+    // report the sound as stopped right away:
+    __atomic_store_n(&handles[id & HANDLEINDEXMASK].status, 0,
+    __ATOMIC_RELEASE);
+
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_STOP;
+    c.id = id;
+    audiomixer_PostCommand(&c);
+}
+
+void audiomixer_SetSoundPositions(int count, const int* ids,
+const float* positions) {
+    int i = 0;
+    while (i < count) {
+        struct positionupdate u;
+        u.id = ids[i];
+        u.x = positions[i * 3];
+        u.y = positions[i * 3 + 1];
+        u.z = positions[i * 3 + 2];
+        if (!positionupdates || !spscqueue_Push(positionupdates, &u)) {
+            // queue is full, make the audio thread catch up:
+            audio_LockAudioThread();
+            audiomixer_ProcessCommands();
+            audio_UnlockAudioThread();
+            if (!positionupdates || !spscqueue_Push(positionupdates, &u)) {
+                return;
+            }
+        }
+        i++;
+    }
+}
+
+int audiomixer_GetBusByName(const char* name) {
+    if (strcasecmp(name, "music") == 0) {
+        return AUDIOMIXER_BUS_MUSIC;
+    }
+    if (strcasecmp(name, "sfx") == 0) {
+        return AUDIOMIXER_BUS_SFX;
+    }
+    if (strcasecmp(name, "ui") == 0) {
+        return AUDIOMIXER_BUS_UI;
+    }
+    if (strcasecmp(name, "voice") == 0) {
+        return AUDIOMIXER_BUS_VOICE;
+    }
+    return -1;
+}
+
+void audiomixer_SetBusVolume(int bus, float volume, float fadeseconds) {
+    if (bus < 0 || bus >= AUDIOMIXER_BUSCOUNT) {
+        return;
+    }
+    if (volume < 0) {
+        volume = 0;
+    }
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_BUSVOLUME;
+    c.bus = bus;
+    c.volume = volume;
+    c.fadeseconds = fadeseconds;
+    audiomixer_PostCommand(&c);
+}
+
+void audiomixer_SetBusMute(int bus, int mute) {
+    if (bus < 0 || bus >= AUDIOMIXER_BUSCOUNT) {
+        return;
+    }
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_BUSMUTE;
+    c.bus = bus;
+    c.mute = (mute != 0);
+    audiomixer_PostCommand(&c);
+}
+
+void audiomixer_SetListenerPosition(float x, float y, float z) {
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_LISTENER;
+    c.x = x;
+    c.y = y;
+    c.z = z;
+    audiomixer_PostCommand(&c);
+}
+
+void audiomixer_SetDistanceModel(float referencedistance, float maxdistance,
+float rolloff) {
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_DISTANCEMODEL;
+    if (referencedistance < 0) {
+        referencedistance = 0;
+    }
+    if (maxdistance < referencedistance) {
+        maxdistance = referencedistance;
+    }
+    if (rolloff < 0) {
+        rolloff = 0;
+    }
+    c.referencedistance = referencedistance;
+    c.maxdistance = maxdistance;
+    c.rolloff = rolloff;
+    audiomixer_PostCommand(&c);
 }
 
 void audiomixer_AdjustSound(int id, float volume, float panning, int noamplify) {
-    audio_LockAudioThread();
-    int slot = audiomixer_GetChannelSlotById(id);
-    if (slot >= 0 && channels[slot].fadepanvolsource) {
-        audiosourcefadepanvol_SetPanVol(channels[slot].fadepanvolsource, volume, panning, noamplify);
+    if (!audiomixer_IsSoundPlaying(id)) {
+        return;
     }
-    audio_UnlockAudioThread();
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_ADJUST;
+    c.id = id;
+    c.volume = volume;
+    c.panning = panning;
+    c.noamplify = noamplify;
+    audiomixer_PostCommand(&c);
 }
 
 
-int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, float panning, int noamplify, float fadeinseconds, int loop) {
-    audio_LockAudioThread();
-    int id = audiomixer_FreeSoundId();
-    int slot = audiomixer_GetFreeChannelSlot(priority);
-    if (slot < 0) {
-        // all slots are full. do nothing and simply return an unused unplaying id
-        audio_UnlockAudioThread();
-        return id;
+// Files at least this large are assumed to be streamed music and get
+// a large cache kept filled by an I/O worker thread:
+#define STREAMINGFILESIZE (1024 * 1024)
+#define STREAMINGCACHESIZE (256 * 1024)
+
+// Streamed sounds are decoded ahead by this much (~0.5s at 48kHz):
+#define DECODEAHEADSIZE (MIXSAMPLERATE * 2 * sizeof(float) / 2)
+
+static struct audiosource* audiomixer_CreateFileSource(const char* path) {
+    if (file_GetSize(path) >= STREAMINGFILESIZE) {
+        return audiosourceprereadcache_CreateSized(
+        audiosourcefile_Create(path), STREAMINGCACHESIZE, 1);
+    }
+    struct audiosource* file = audiosourcefile_Create(path);
+    if (file && audiosourcefile_IsMemoryMapped(file)) {
+        // reading is a plain memory copy already
+        return file;
     }
+    return audiosourceprereadcache_Create(file);
+}
 
-    // try ogg format:
+static struct audiosource* audiomixer_CreateDecodeSource(const char* path,
+int* hasloop, size_t* loopstart, size_t* looplength) {
+    // try wave format:
     struct audiosource* decodesource = NULL;
+    if (strlen(path) > strlen(".wav") &&
+    strcasecmp(path+strlen(path)-strlen(".wav"), ".wav") == 0) {
+        // (format conversion is skipped if it is float already)
+        decodesource = audiosourceformatconvert_Create(
+            audiosourcewave_Create(
+            audiomixer_CreateFileSource(path)
+            ),
+            AUDIOSOURCEFORMAT_F32LE
+        );
+    }
+
+    // try ogg format:
     if (!decodesource && strlen(path) > strlen(".ogg") &&
     strcasecmp(path+strlen(path)-strlen(".ogg"), ".ogg") == 0) {
         decodesource = audiosourceogg_Create(
-        audiosourceprereadcache_Create(audiosourcefile_Create(path))
+        audiomixer_CreateFileSource(path)
         );
+        if (decodesource && file_GetSize(path) >= STREAMINGFILESIZE) {
+            // long music is likely to be seeked in
+            audiosourceogg_UsePageIndex(decodesource, path);
+        }
+
+        // get loop points (converted to our mixing sample rate):
+        if (decodesource && audiosourceogg_GetLoopPoints(decodesource,
+        loopstart, looplength) && decodesource->samplerate > 0) {
+            *hasloop = 1;
+            *loopstart = (size_t)((uint64_t)*loopstart * MIXSAMPLERATE /
+            decodesource->samplerate);
+            *looplength = (size_t)((uint64_t)*looplength * MIXSAMPLERATE /
+            decodesource->samplerate);
+        }
     }
 
     // try flac format:
@@ -201,7 +896,7 @@ int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, f
     strcasecmp(path+strlen(path)-strlen(".flac"), ".flac") == 0) {
         decodesource = audiosourceformatconvert_Create(
             audiosourceflac_Create(
-            audiosourceprereadcache_Create(audiosourcefile_Create(path))
+            audiomixer_CreateFileSource(path)
             ),
             AUDIOSOURCEFORMAT_F32LE
         );
@@ -211,46 +906,250 @@ int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, f
     if (!decodesource) {
         decodesource = audiosourceformatconvert_Create(
         audiosourceffmpeg_Create(
-        audiosourceprereadcache_Create(audiosourcefile_Create(path))),
+        audiomixer_CreateFileSource(path)),
         AUDIOSOURCEFORMAT_F32LE);
     }
+    return decodesource;
+}
+
+static int audiomixer_SeekDecodeSource(struct mixercommand* s,
+struct audiosource* decodesource) {
+    // remember the length for position reporting, and go to the
+    // requested start position:
+    if (!decodesource->seekable) {
+        return (s->startframe == 0);
+    }
+    s->length = decodesource->length(decodesource);
+    if (s->length > 0 && s->startframe >= s->length) {
+        return 0;
+    }
+    if (s->startframe > 0 &&
+    !decodesource->seek(decodesource, s->startframe)) {
+        return 0;
+    }
+    return 1;
+}
+
+static int audiomixer_PlaySound(const char* path, int priority, int bus, float volume, float panning, int noamplify, float fadeinseconds, int loop, struct mixercommand* options) {
+    // Everything up to the hand-over to the audio thread happens
+    // without locking it, so opening and decoding the file can't
+    // stall the audio output.
+    struct mixercommand s;
+    memset(&s, 0, sizeof(s));
+    s.type = MIXERCOMMAND_PLAY;
+    s.priority = priority;
+    if (bus < 0 || bus >= AUDIOMIXER_BUSCOUNT) {
+        bus = AUDIOMIXER_BUS_SFX;
+    }
+    s.bus = bus;
+    if (options) {
+        s.positioned = options->positioned;
+        s.x = options->x;
+        s.y = options->y;
+        s.z = options->z;
+        s.startframe = options->startframe;
+        s.clock = options->clock;
+    }
 
-    // if we got no decode source at this point, the audio file is unsupported:
+    // short sounds are played from the decoded sample cache:
+    int hasloop = 0;
+    size_t loopstart = 0;
+    size_t looplength = 0;
+    int streamed = 0;
+    struct audiosource* decodesource = audiosamplecache_Open(path);
+    if (decodesource) {
+        hasloop = audiosamplecache_GetLoopPoints(path, &loopstart,
+        &looplength);
+        if (!audiomixer_SeekDecodeSource(&s, decodesource)) {
+            decodesource->close(decodesource);
+            return -1;
+        }
+    }else{
+        // if we got no decode source, the audio file is unsupported:
+        decodesource = audiomixer_CreateDecodeSource(path, &hasloop,
+        &loopstart, &looplength);
+        if (!decodesource) {
+            return -1;
+        }
+
+        // resample and try to put it into the cache:
+        struct audiosource* resampled = audiosourceresample_Create(
+        decodesource, MIXSAMPLERATE);
+        decodesource = audiosamplecache_Store(path, resampled);
+        if (!decodesource) {
+            return -1;
+        }
+        if (hasloop) {
+            audiosamplecache_SetLoopPoints(path, loopstart, looplength);
+        }
+
+        if (!audiomixer_SeekDecodeSource(&s, decodesource)) {
+            decodesource->close(decodesource);
+            return -1;
+        }
+
+        // if it is too long to be cached, it is streamed. (Don't compare
+        // with the resampled source: it is closed when the samples were
+        // cached, and the cache source may get the same address.)
+        streamed = !audiosamplecache_IsCached(path);
+    }
+
+    // Loop right on top of the decoded audio. Looping jumps back by
+    // seeking if possible, and for streamed sounds this happens ahead
+    // of time on the decode-ahead worker, so there is no gap:
+    decodesource = audiosourceloop_Create(decodesource);
     if (!decodesource) {
-        // unsupported audio format
-        audio_UnlockAudioThread();
         return -1;
     }
+    audiosourceloop_SetLooping(decodesource, loop);
+    if (hasloop) {
+        audiosourceloop_SetLoopPoints(decodesource, loopstart, looplength);
+    }
+    if (loop) {
+        // remember the loop range for position reporting:
+        s.loopstart = loopstart;
+        s.loopend = s.length;
+        if (looplength > 0) {
+            s.loopend = loopstart + looplength;
+        }
+        if (s.loopend <= s.loopstart) {
+            s.loopend = 0;
+        }
+    }
 
-    // wrap up the decoded audio into the resampler and fade/pan/vol modifier
-    channels[slot].fadepanvolsource = audiosourcefadepanvol_Create(audiosourceresample_Create(decodesource, 48000));
-    if (!channels[slot].fadepanvolsource) {
-        audio_UnlockAudioThread();
+    if (streamed) {
+        // decode it ahead on the worker pool instead of the audio thread:
+        decodesource = audiosourceprereadcache_CreateSized(
+        decodesource, DECODEAHEADSIZE, 1);
+        if (!decodesource) {
+            return -1;
+        }
+        s.decodeaheadsource = decodesource;
+    }
+
+    // wrap up the decoded audio into the fade/pan/vol modifier
+    s.fadepanvolsource = audiosourcefadepanvol_Create(decodesource);
+    if (!s.fadepanvolsource) {
         return -1;
     }
 
     // set the options for the fade/pan/vol modifier
-    audiosourcefadepanvol_SetPanVol(channels[slot].fadepanvolsource, volume, panning, noamplify);
-    if (fadeinseconds > 0) {
-        audiosourcefadepanvol_StartFade(channels[slot].fadepanvolsource, fadeinseconds, volume, 0);
+    if (fadeinseconds > 0 || (options && options->fadeframes > 0)) {
+        // fade in from silence:
+        audiosourcefadepanvol_SetPanVol(s.fadepanvolsource, 0, panning, noamplify);
+        if (options && options->fadeframes > 0) {
+            audiosourcefadepanvol_StartFadeFrames(s.fadepanvolsource,
+            options->fadeframes, volume, 0);
+        }else{
+            audiosourcefadepanvol_StartFade(s.fadepanvolsource, fadeinseconds, volume, 0);
+        }
+    }else{
+        audiosourcefadepanvol_SetPanVol(s.fadepanvolsource, volume, panning, noamplify);
     }
 
-    // wrap the fade/pan/vol modifier into a loop audio source
-    channels[slot].loopsource = audiosourceloop_Create(channels[slot].fadepanvolsource);
-    if (!channels[slot].loopsource) {
-        channels[slot].fadepanvolsource->close(channels[slot].fadepanvolsource);
-        channels[slot].fadepanvolsource = NULL;
-        audio_UnlockAudioThread();
+    // decode the first block now so the audio thread doesn't need to:
+    audiosourcefadepanvol_Preload(s.fadepanvolsource);
+
+    // get a handle which will be our sound id:
+    s.handle = audiomixer_TakeHandle();
+    if (s.handle < 0) {
+        s.fadepanvolsource->close(s.fadepanvolsource);
         return -1;
     }
+    s.id = (handles[s.handle].generation << HANDLEINDEXBITS) | s.handle;
+    __atomic_store_n(&handles[s.handle].filllevel, 100, __ATOMIC_RELAXED);
+    __atomic_store_n(&handles[s.handle].position,
+    (unsigned int)s.startframe, __ATOMIC_RELAXED);
+    __atomic_store_n(&handles[s.handle].status, s.id, __ATOMIC_RELEASE);
 
-    // set the options for the loop audio source
-    audiosourceloop_SetLooping(channels[slot].loopsource, loop);
+    // hand the sound over to the audio thread:
+    audiomixer_PostCommand(&s);
+    return s.id;
+}
 
-    // remember that loop audio source as final processed audio
-    channels[slot].mixsource = channels[slot].loopsource;
+int audiomixer_PlaySoundFromDisk(const char* path, int priority, int bus, float volume, float panning, int noamplify, float fadeinseconds, int loop) {
+    return audiomixer_PlaySound(path, priority, bus, volume, panning,
+    noamplify, fadeinseconds, loop, NULL);
+}
 
-    audio_UnlockAudioThread();
+int audiomixer_PlayPositionedSoundFromDisk(const char* path, int priority, int bus, float volume, float x, float y, float z, float fadeinseconds, int loop) {
+    struct mixercommand position;
+    memset(&position, 0, sizeof(position));
+    position.positioned = 1;
+    position.x = x;
+    position.y = y;
+    position.z = z;
+    // panning is done by the mixer, so leave it centered and unamplified:
+    return audiomixer_PlaySound(path, priority, bus, volume, 0, 1,
+    fadeinseconds, loop, &position);
+}
+
+int audiomixer_PlaySoundFromDiskAt(const char* path, int priority, int bus, float volume, float fadeinseconds, int loop, double startseconds) {
+    struct mixercommand options;
+    memset(&options, 0, sizeof(options));
+    if (startseconds > 0) {
+        options.startframe = (size_t)(startseconds * MIXSAMPLERATE);
+    }
+    return audiomixer_PlaySound(path, priority, bus, volume, 0, 1,
+    fadeinseconds, loop, &options);
+}
+
+double audiomixer_GetSoundPosition(int id) {
+    if (!audiomixer_IsSoundPlaying(id)) {
+        return -1;
+    }
+    return (double)__atomic_load_n(&handles[id & HANDLEINDEXMASK].position,
+    __ATOMIC_RELAXED) / MIXSAMPLERATE;
+}
+
+uint64_t audiomixer_GetMixClock(void) {
+    return __atomic_load_n(&mixclock, __ATOMIC_ACQUIRE);
+}
+
+int audiomixer_ScheduleSoundFromDisk(const char* path, int priority, int bus, float volume, int loop, uint64_t startclock, unsigned int fadeinframes) {
+    struct mixercommand options;
+    memset(&options, 0, sizeof(options));
+    options.clock = startclock;
+    options.fadeframes = fadeinframes;
+    return audiomixer_PlaySound(path, priority, bus, volume, 0, 1,
+    0, loop, &options);
+}
+
+void audiomixer_FadeSoundAt(int id, uint64_t clock, unsigned int fadeframes, float volume, int stop) {
+    if (!audiomixer_IsSoundPlaying(id)) {
+        return;
+    }
+    if (fadeframes < 1) {
+        fadeframes = 1;
+    }
+    struct mixercommand c;
+    memset(&c, 0, sizeof(c));
+    c.type = MIXERCOMMAND_FADE;
+    c.id = id;
+    c.clock = clock;
+    c.fadeframes = fadeframes;
+    c.volume = volume;
+    c.stop = stop;
+    audiomixer_PostCommand(&c);
+}
+
+int audiomixer_CrossfadeSoundFromDisk(int oldid, const char* path, int priority, int bus, float volume, int loop, uint64_t startclock, unsigned int fadeframes) {
+    if (startclock == 0) {
+        // leave enough time for both commands to arrive in the same block:
+        startclock = audiomixer_GetMixClock() + MAXMIXBLOCKFRAMES;
+    }
+    if (fadeframes < 1) {
+        fadeframes = 1;
+    }
+
+    // the new sound is fully set up and decoding ahead before anything
+    // is handed over to the audio thread:
+    int id = audiomixer_ScheduleSoundFromDisk(path, priority, bus, volume,
+    loop, startclock, fadeframes);
+    if (id < 0) {
+        return -1;
+    }
+    audiomixer_FadeSoundAt(oldid, startclock, fadeframes, 0, 1);
     return id;
 }
 
@@ -266,47 +1165,127 @@ static void audiomixer_HandleChannelEOF(int channel, int returnvalue) { //  SOUN
 }
 
 #define MIXTYPE float
-#define MIXSIZE (1024*10)
 
-char mixbuf[MIXSIZE]; // for mixing the final mix
-char mixbuf2[MIXSIZE]; // for keeping the channel's content
-int filledmixpartial = 0;
-int filledmixfull = 0;
+static int audiomixer_ReadChannel(int slot, char* buf, unsigned int frames,
+uint64_t clock) { // SOUND THREAD
+    // read the given amount of frames of a channel for the block at the
+    // given mix clock time, starting a scheduled fade at the exact frame
+    struct soundchannel* c = &channels[slot];
+    unsigned int bytes = frames * 2 * sizeof(MIXTYPE);
+    int k = 0;
+    if (c->fadescheduled && c->fadeclock < clock + frames) {
+        if (c->fadeclock > clock) {
+            // read up to the start of the fade first
+            unsigned int fadebytes = (unsigned int)(c->fadeclock - clock) *
+            2 * sizeof(MIXTYPE);
+            k = c->mixsource->read(c->mixsource, buf, fadebytes);
+            if (k < (int)fadebytes) {
+                // ended before the fade
+                return k;
+            }
+            buf += k;
+            bytes -= k;
+        }
+        c->fadescheduled = 0;
+        audiosourcefadepanvol_StartFadeFrames(c->fadepanvolsource,
+        c->fadeframes, c->fadevolume, c->fadestop);
+    }
+    int k2 = c->mixsource->read(c->mixsource, buf, bytes);
+    if (k2 <= 0) {
+        if (k > 0) {
+            return k;
+        }
+        return k2;
+    }
+    return k + k2;
+}
+
+#define MIXBLOCKSIZE (MAXMIXBLOCKFRAMES * 2 * sizeof(MIXTYPE))
 
-static void audiomixer_RequestMix(unsigned int bytes) { // SOUND THREAD
-    unsigned int filledbytes = filledmixpartial + filledmixfull * sizeof(MIXTYPE);
+static unsigned int mixblockframes = 0;  // 0 until the first request
+static unsigned int mixblockpos = 0;  // samples of mixbuf handed out
+static unsigned int mixblocksamples = 0;  // samples mixed into mixbuf
+static unsigned int lastrequestframes = 0;
+static unsigned int pendingblockframes = 0;  // block size to switch to
+static uint64_t mixedchannelframes = 0;  // for throughput measurements
 
-    // calculate the desired amount of samples
-    int sampleamount = (bytes - filledbytes)/sizeof(MIXTYPE);
-    while (sampleamount * sizeof(MIXTYPE) < bytes - filledbytes) {
-        sampleamount += sizeof(MIXTYPE);
-    }
+static char mixbuf[MIXBLOCKSIZE]; // for mixing the final mix
+static char mixbuf2[MIXBLOCKSIZE]; // for keeping the channel's content
+static char busbuf[AUDIOMIXER_BUSCOUNT][MIXBLOCKSIZE]; // for each bus
 
-    // limit to possible buffer maximum
-    while (sampleamount * sizeof(MIXTYPE) + filledbytes > MIXSIZE) {
-        sampleamount--;
+static int audiomixer_ApplyBusVolume(int bus, float* samples,
+unsigned int frames, int hascontent) { // SOUND THREAD
+    // Advance the bus fade and apply the bus volume to a block,
+    // going smoothly from the gain of the last block to the new one.
+    // Returns 1 if the bus should be mixed, 0 if it is silent.
+    struct mixbus* b = &buses[bus];
+    if (b->fadeperframe != 0) {
+        b->volume += b->fadeperframe * frames;
+        if ((b->fadeperframe > 0 && b->volume >= b->targetvolume) ||
+        (b->fadeperframe < 0 && b->volume <= b->targetvolume)) {
+            b->volume = b->targetvolume;
+            b->fadeperframe = 0;
+        }
     }
-
-    // check if we want any samples at all
-    if (sampleamount <= 0) {
-        return;
+    float gain = b->volume;
+    if (b->mute) {
+        gain = 0;
+    }
+    float startgain = b->appliedgain;
+    b->appliedgain = gain;
+    if (!hascontent || (startgain <= 0 && gain <= 0)) {
+        return 0;
     }
+    if (startgain == 1 && gain == 1) {
+        // nothing to do
+        return 1;
+    }
+    float step = (gain - startgain) / frames;
+    unsigned int i = 0;
+    while (i < frames) {
+        startgain += step;
+        samples[i * 2] *= startgain;
+        samples[i * 2 + 1] *= startgain;
+        i++;
+    }
+    return 1;
+}
+static void audiomixer_MixBlock(void) { // SOUND THREAD
+    // start/stop/adjust sounds as requested since the last mix:
+    audiomixer_ProcessCommands();
 
+    int sampleamount = mixblockframes * 2;
     int samplebytes = sampleamount * sizeof(MIXTYPE);
 
-    // cycle all channels and mix them into the buffer
-    int notzerochannels = 0;
-    unsigned int i = 0;
-    while (i < MAXCHANNELS) {
+    // cycle all channels and mix them into their bus buffers
+    int busmixedchannels[AUDIOMIXER_BUSCOUNT];
+    memset(busmixedchannels, 0, sizeof(busmixedchannels));
+    int i = 0;
+    while (i < channelcount) {
         if (channels[i].mixsource) {
-            notzerochannels = 1;
+            // scheduled sounds start at their exact frame:
+            unsigned int skipframes = 0;
+            if (channels[i].startclock > mixclock) {
+                if (channels[i].startclock >= mixclock + mixblockframes) {
+                    // not in this block yet
+                    i++;
+                    continue;
+                }
+                skipframes = (unsigned int)(channels[i].startclock - mixclock);
+            }
+            channels[i].startclock = 0;
+            unsigned int skipbytes = skipframes * 2 * sizeof(MIXTYPE);
+            memset(mixbuf2, 0, skipbytes);
+
             // read bytes
-            int k = channels[i].mixsource->read(channels[i].mixsource, mixbuf2, samplebytes);
+            int k = audiomixer_ReadChannel(i, mixbuf2 + skipbytes,
+            mixblockframes - skipframes, mixclock + skipframes);
             if (k <= 0) {
                 audiomixer_HandleChannelEOF(i, k);
                 i++;
                 continue;
             }
+            k += skipbytes;
 
             // see how many samples we can actually mix from this
             unsigned int mixsamples,mixbytes;
@@ -321,122 +1300,142 @@ static void audiomixer_RequestMix(unsigned int bytes) { // SOUND THREAD
                 mixbytes = samplebytes;
             }
 
-            if (i > 0) {
+            mixedchannelframes += mixsamples / 2 - skipframes;
+
+            // advance the playback position (looping back to the start):
+            channels[i].position += mixsamples / 2 - skipframes;
+            if (channels[i].loopend > channels[i].loopstart &&
+            channels[i].position >= channels[i].loopend) {
+                channels[i].position = channels[i].loopstart +
+                (channels[i].position - channels[i].loopstart) %
+                (channels[i].loopend - channels[i].loopstart);
+            }
+            __atomic_store_n(&handles[channels[i].handle].position,
+            (unsigned int)channels[i].position, __ATOMIC_RELAXED);
+
+            if (channels[i].decodeaheadsource) {
+                // publish how well decoding keeps up:
+                __atomic_store_n(&handles[channels[i].handle].filllevel,
+                audiosourceprereadcache_GetFillLevel(
+                channels[i].decodeaheadsource), __ATOMIC_RELAXED);
+            }
+
+            if (channels[i].positioned) {
+                audiomixer_ApplyPositioning(i, (float*)mixbuf2,
+                mixsamples / 2);
+            }
+
+            int bus = channels[i].bus;
+            if (busmixedchannels[bus] > 0) {
                 // mix samples
-                MIXTYPE* mixtarget = (MIXTYPE*)((char*)mixbuf + filledbytes);
-                float* mixsource = (float*)mixbuf2;
-                unsigned int r = 0;
-                while (r < mixsamples) {
-                    float sourcevalue = *mixsource;
-                    float targetvalue = *mixtarget;
-
-                    float result;
-                    if ((targetvalue < 0 && sourcevalue >= 0) || (targetvalue > 0 && sourcevalue <= 0)) {
-                        // different sign -> simply add
-                        result = sourcevalue + targetvalue;
-                    } else {
-                        // same sign -> do intelligent mix thing:
-                        float reversed = 1;
-                        if (sourcevalue < 0 || targetvalue < 0) {
-                            reversed = -1;
-                            sourcevalue = -sourcevalue;
-                            targetvalue = -targetvalue;
-                        }
-                        result = reversed * ((targetvalue + sourcevalue) - (targetvalue * sourcevalue));
-                    }
-                    *mixtarget = (MIXTYPE)result;
-                    r++;
-                    mixsource++;
-                    mixtarget++;
-                }
+                audiomixerkernel_Mix((MIXTYPE*)busbuf[bus],
+                (float*)mixbuf2, mixsamples);
             }else{
-                // simply copy the channel into the stream
-                memcpy(mixbuf + filledbytes, mixbuf2, mixbytes);
+                // simply copy the channel into the bus
+                memcpy(busbuf[bus], mixbuf2, mixbytes);
 
                 // calculate the amount of additional zeroes we might need:
                 int addzeroes = samplebytes - mixbytes;
                 if (addzeroes > 0) {
-                    memset(mixbuf + filledbytes + mixbytes, 0, addzeroes);
+                    memset(busbuf[bus] + mixbytes, 0, addzeroes);
                 }
             }
+            busmixedchannels[bus]++;
         }
         i++;
     }
 
-    // zero buffer if no channel was copied into it:
-    if (!notzerochannels) {
-        memset(mixbuf + filledbytes, 0, samplebytes);
+    // apply bus volumes and mix the buses into the buffer
+    int mixedbuses = 0;
+    int bus = 0;
+    while (bus < AUDIOMIXER_BUSCOUNT) {
+        if (audiomixer_ApplyBusVolume(bus, (float*)busbuf[bus],
+        sampleamount / 2, busmixedchannels[bus] > 0)) {
+            if (mixedbuses > 0) {
+                audiomixerkernel_Mix((MIXTYPE*)mixbuf,
+                (float*)busbuf[bus], sampleamount);
+            }else{
+                memcpy(mixbuf, busbuf[bus], samplebytes);
+            }
+            mixedbuses++;
+        }
+        bus++;
+    }
+
+    // zero buffer if no bus was copied into it:
+    if (!mixedbuses) {
+        memset(mixbuf, 0, samplebytes);
     }
 
-    // remember how much new mix buffer we processed now
-    filledmixfull += sampleamount;
+    // the block is now ready to be handed out
+    mixblockpos = 0;
+    mixblocksamples = sampleamount;
+    __atomic_store_n(&mixclock, mixclock + mixblockframes, __ATOMIC_RELEASE);
+}
+
+static void audiomixer_SetBlockFrames(unsigned int frames) { // SOUND THREAD
+    // pick the smallest power of two holding a whole device request:
+    unsigned int blockframes = MINMIXBLOCKFRAMES;
+    while (blockframes < frames && blockframes < MAXMIXBLOCKFRAMES) {
+        blockframes *= 2;
+    }
+    mixblockframes = blockframes;
 }
 
 int s16mixmode = 0;
 
+uint64_t audiomixer_GetChannelFramesMixed(void) { // SOUND THREAD
+    return mixedchannelframes;
+}
+
 void audiomixer_GetBuffer(void* buf, unsigned int len) { // SOUND THREAD
     char* p = buf;
-    while (len > 0) {
-        audiomixer_RequestMix(len);
+    unsigned int samplesize = sizeof(MIXTYPE);
+    if (s16mixmode) {
+        samplesize = sizeof(int16_t);
+    }
+    unsigned int samples = len / samplesize;
 
-        // see how much bytes we can get
-        unsigned int filledbytes = filledmixpartial + filledmixfull * sizeof(MIXTYPE);
-        unsigned int amount = len+len*s16mixmode;  // doubled for s16mixmode
-        if (amount > filledbytes) {
-            amount = filledbytes;
-        }
-        if (amount == 0) {
-            break;
+    // adapt the block size when the device request size changes. if part
+    // of the current block is still unread, switch once it is used up:
+    if (samples / 2 != lastrequestframes) {
+        lastrequestframes = samples / 2;
+        pendingblockframes = lastrequestframes;
+    }
+    if (mixblockframes == 0) {
+        audiomixer_SetBlockFrames(lastrequestframes);
+        pendingblockframes = 0;
+    }
+
+    while (samples > 0) {
+        if (mixblockpos >= mixblocksamples) {
+            if (pendingblockframes > 0) {
+                audiomixer_SetBlockFrames(pendingblockframes);
+                pendingblockframes = 0;
+            }
+            audiomixer_MixBlock();
         }
 
-        // copy the amount of bytes we have
+        // hand out as much of the current block as fits:
+        unsigned int amount = mixblocksamples - mixblockpos;
+        if (amount > samples) {
+            amount = samples;
+        }
+        MIXTYPE* src = (MIXTYPE*)mixbuf + mixblockpos;
         if (s16mixmode) {
-            // copy them and convert them to S16 on the fly
-            // FIXME: this doesn't work properly with partial samples
-            unsigned int i = 0;
-            while (i <= amount-sizeof(MIXTYPE)) {
-                MIXTYPE fval = *((MIXTYPE*)((char*)mixbuf+i));
-                fval *= 32767;
-                *((int16_t*)((char*)p)) = (int16_t)fastdoubletoint32(fval);
-                p += sizeof(int16_t);
-                len -= sizeof(int16_t);
-                i += sizeof(MIXTYPE);
-            }
+            // convert them to S16 on the fly
+            audiomixerkernel_FloatToS16((int16_t*)p, src, amount);
         } else {
-            // copy them as float 32:
-            memcpy(p, mixbuf, amount);
-            len -= amount;
-            p += amount;
+            memcpy(p, src, amount * sizeof(MIXTYPE));
         }
+        p += amount * samplesize;
+        samples -= amount;
+        mixblockpos += amount;
+    }
 
-        // trim mix buffer:
-        if (amount >= filledbytes) {
-            // simply mark mix buffer as empty
-            filledmixpartial = 0;
-            filledmixfull = 0;
-        }else{
-            // move back contents
-            memmove(mixbuf, mixbuf + amount, filledbytes - amount);
-
-            // update fill state
-            unsigned int fullparsedsamples = amount / sizeof(MIXTYPE);
-            if (fullparsedsamples * sizeof(MIXTYPE) > amount) {
-                fullparsedsamples -= sizeof(MIXTYPE);
-            }
-            int partialparsedbytes = amount - fullparsedsamples * sizeof(MIXTYPE);
-            filledmixfull -= fullparsedsamples;
-            filledmixpartial -= partialparsedbytes;
-
-            // handle partial bytes correctly
-            while (filledmixpartial < 0) {
-                filledmixpartial += sizeof(MIXTYPE);
-                filledmixfull++;
-            }
-            while (filledmixpartial >= (int)sizeof(MIXTYPE)) {
-                filledmixpartial -= sizeof(MIXTYPE);
-                filledmixfull--;
-            }
-        }
+    // zero out the remains of a request not made of whole samples:
+    if (len % samplesize) {
+        memset(p, 0, len % samplesize);
     }
 }
 
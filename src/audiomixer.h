@@ -21,14 +21,94 @@
 
 */
 
+#include <stdint.h>
 
 extern int s16mixmode; // 1: output s16 samples, 0: output float32 samples (default)
 void audiomixer_GetBuffer(void* buf, unsigned int len);
 void audiomixer_Init(void);
-int audiomixer_PlaySoundFromDisk(const char* path, int priority, float volume, float panning, int noamplify, float fadeinseconds, int loop);
+
+// Total amount of frames mixed from all channels so far (summed up over
+// channels). Only read this from the thread calling audiomixer_GetBuffer:
+uint64_t audiomixer_GetChannelFramesMixed(void);
+
+// Mix buses. Every sound plays on one of them:
+#define AUDIOMIXER_BUS_MUSIC 0
+#define AUDIOMIXER_BUS_SFX 1
+#define AUDIOMIXER_BUS_UI 2
+#define AUDIOMIXER_BUS_VOICE 3
+#define AUDIOMIXER_BUSCOUNT 4
+
+int audiomixer_PlaySoundFromDisk(const char* path, int priority, int bus, float volume, float panning, int noamplify, float fadeinseconds, int loop);
 void audiomixer_StopSound(int id);
 void audiomixer_AdjustSound(int id, float volume, float panning, int noamplify);
 int audiomixer_IsSoundPlaying(int id);
 int audiomixer_NoSoundsPlaying(void);
 
+// Long sounds are streamed and decoded ahead by worker threads.
+// Get how far decoding is ahead of playback in percent (100 means
+// fully ahead, 0 means playback caught up with decoding), -1 if the
+// sound isn't playing. Sounds which are not streamed report 100:
+int audiomixer_GetStreamFillLevel(int id);
+
+// Play a sound starting at the given time in seconds (e.g. to resume
+// music). Ogg files are seeked in, so nothing before the start is
+// decoded:
+int audiomixer_PlaySoundFromDiskAt(const char* path, int priority, int bus, float volume, float fadeinseconds, int loop, double startseconds);
+
+// Sounds can be scheduled to start or fade at an exact time of the mix
+// clock, which counts the frames (at 48kHz) mixed so far:
+uint64_t audiomixer_GetMixClock(void);
+
+// Play a sound starting exactly at the given mix clock time, fading in
+// over the given amount of frames (0 for no fade). The sound is opened
+// and starts decoding right away, so schedule it a bit ahead:
+int audiomixer_ScheduleSoundFromDisk(const char* path, int priority, int bus, float volume, int loop, uint64_t startclock, unsigned int fadeinframes);
+
+// Fade a sound to the given volume starting exactly at the given mix
+// clock time. If stop is 1, the sound ends when the fade is done:
+void audiomixer_FadeSoundAt(int id, uint64_t clock, unsigned int fadeframes, float volume, int stop);
+
+// Crossfade from a playing sound to a new one: the new sound fades in
+// while the old one fades out and stops, both starting exactly at
+// startclock (0 for as soon as possible). Returns the new sound's id:
+int audiomixer_CrossfadeSoundFromDisk(int oldid, const char* path, int priority, int bus, float volume, int loop, uint64_t startclock, unsigned int fadeframes);
+
+// Get the current playback time of a sound in seconds (-1 if the
+// sound isn't playing). For looping sounds, it starts over at 0
+// with each loop if the sound's length is known:
+double audiomixer_GetSoundPosition(int id);
+
+// Positional audio: play a sound at the given position.
+// Volume is attenuated by distance to the listener and the sound
+// is panned according to its direction (computed by the mixer):
+int audiomixer_PlayPositionedSoundFromDisk(const char* path, int priority, int bus, float volume, float x, float y, float z, float fadeinseconds, int loop);
+
+// Update the positions of many positioned sounds at once
+// (positions has 3 floats x, y, z for each sound id):
+void audiomixer_SetSoundPositions(int count, const int* ids, const float* positions);
+
+// Set the listener position (default: 0, 0, 0):
+void audiomixer_SetListenerPosition(float x, float y, float z);
+
+// Set how sounds get quieter with distance. Sounds closer than
+// referencedistance play at full volume, sounds farther away than
+// maxdistance don't get any quieter.
+// Defaults: referencedistance 1, maxdistance 1000, rolloff 1
+void audiomixer_SetDistanceModel(float referencedistance, float maxdistance, float rolloff);
+
+// Set the amount of sounds which can play at once (default: 32, 8 on
+// Android). Sounds in channels which go away are stopped.
+// Returns 1 on success, 0 on failure (out of memory):
+int audiomixer_SetMaxChannels(int count);
+
+// Get bus by name ("music", "sfx", "ui" or "voice"), -1 if unknown:
+int audiomixer_GetBusByName(const char* name);
+
+// Set the volume of all sounds on a bus (0 to 1, default 1), fading
+// to the new volume over the given time if fadeseconds is > 0:
+void audiomixer_SetBusVolume(int bus, float volume, float fadeseconds);
+
+// Mute (1) or unmute (0) a bus:
+void audiomixer_SetBusMute(int bus, int mute);
+
 
@@ -0,0 +1,194 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <stdint.h>
+#include <string.h>
+
+#include "audiomixerkernel.h"
+#include "mathhelpers.h"
+
+// The vectorized kernels are compiled with per-function target
+// attributes, so the engine itself can still be built for (and run on)
+// CPUs without SSE2/AVX2. audiomixerkernel_Init() checks at runtime
+// which ones are usable.
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define MIXKERNEL_X86
+#include <immintrin.h>
+#endif
+
+static void audiomixerkernel_MixC(float* target, const float* source,
+unsigned int samples) {
+    unsigned int i = 0;
+    while (i < samples) {
+        // this is the "intelligent mix" formula without branching on
+        // the sign of both values: for the same sign (positive product)
+        // subtract the product mirrored to the sign of the target value,
+        // otherwise simply add both values.
+        float t = target[i];
+        float s = source[i];
+        float product = t * s;
+        if (product < 0) {
+            product = 0;
+        }
+        if (t < 0) {
+            product = -product;
+        }
+        target[i] = (t + s) - product;
+        i++;
+    }
+}
+
+static void audiomixerkernel_FloatToS16C(int16_t* target,
+const float* source, unsigned int samples) {
+    unsigned int i = 0;
+    while (i < samples) {
+        int v = fastdoubletoint32(source[i] * 32767);
+        if (v > 32767) {
+            v = 32767;
+        }
+        if (v < -32768) {
+            v = -32768;
+        }
+        target[i] = (int16_t)v;
+        i++;
+    }
+}
+
+#ifdef MIXKERNEL_X86
+
+__attribute__((target("sse2")))
+static void audiomixerkernel_MixSSE2(float* target, const float* source,
+unsigned int samples) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signmask = _mm_set1_ps(-0.0f);
+    unsigned int i = 0;
+    while (i + 4 <= samples) {
+        __m128 t = _mm_loadu_ps(target + i);
+        __m128 s = _mm_loadu_ps(source + i);
+        __m128 product = _mm_max_ps(_mm_mul_ps(t, s), zero);
+        product = _mm_or_ps(product, _mm_and_ps(t, signmask));
+        _mm_storeu_ps(target + i, _mm_sub_ps(_mm_add_ps(t, s), product));
+        i += 4;
+    }
+    audiomixerkernel_MixC(target + i, source + i, samples - i);
+}
+
+__attribute__((target("sse2")))
+static void audiomixerkernel_FloatToS16SSE2(int16_t* target,
+const float* source, unsigned int samples) {
+    const __m128 scale = _mm_set1_ps(32767);
+    unsigned int i = 0;
+    while (i + 8 <= samples) {
+        __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + i),
+        scale));
+        __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_loadu_ps(source + i + 4),
+        scale));
+        _mm_storeu_si128((__m128i*)(target + i), _mm_packs_epi32(a, b));
+        i += 8;
+    }
+    audiomixerkernel_FloatToS16C(target + i, source + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void audiomixerkernel_MixAVX2(float* target, const float* source,
+unsigned int samples) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 signmask = _mm256_set1_ps(-0.0f);
+    unsigned int i = 0;
+    while (i + 8 <= samples) {
+        __m256 t = _mm256_loadu_ps(target + i);
+        __m256 s = _mm256_loadu_ps(source + i);
+        __m256 product = _mm256_max_ps(_mm256_mul_ps(t, s), zero);
+        product = _mm256_or_ps(product, _mm256_and_ps(t, signmask));
+        _mm256_storeu_ps(target + i,
+        _mm256_sub_ps(_mm256_add_ps(t, s), product));
+        i += 8;
+    }
+    audiomixerkernel_MixSSE2(target + i, source + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void audiomixerkernel_FloatToS16AVX2(int16_t* target,
+const float* source, unsigned int samples) {
+    const __m256 scale = _mm256_set1_ps(32767);
+    unsigned int i = 0;
+    while (i + 16 <= samples) {
+        __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(
+        _mm256_loadu_ps(source + i), scale));
+        __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(
+        _mm256_loadu_ps(source + i + 8), scale));
+        // packs works per 128bit lane, so restore the sample order:
+        __m256i packed = _mm256_permute4x64_epi64(
+        _mm256_packs_epi32(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i*)(target + i), packed);
+        i += 16;
+    }
+    audiomixerkernel_FloatToS16SSE2(target + i, source + i, samples - i);
+}
+
+#endif  // MIXKERNEL_X86
+
+static void (*mixfunc)(float*, const float*, unsigned int) =
+&audiomixerkernel_MixC;
+static void (*tos16func)(int16_t*, const float*, unsigned int) =
+&audiomixerkernel_FloatToS16C;
+static const char* kernelname = "c";
+
+void audiomixerkernel_Init(void) {
+    mixfunc = &audiomixerkernel_MixC;
+    tos16func = &audiomixerkernel_FloatToS16C;
+    kernelname = "c";
+#ifdef MIXKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        mixfunc = &audiomixerkernel_MixSSE2;
+        tos16func = &audiomixerkernel_FloatToS16SSE2;
+        kernelname = "sse2";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        mixfunc = &audiomixerkernel_MixAVX2;
+        tos16func = &audiomixerkernel_FloatToS16AVX2;
+        kernelname = "avx2";
+    }
+#endif
+}
+
+const char* audiomixerkernel_GetName(void) {
+    return kernelname;
+}
+
+void audiomixerkernel_Mix(float* target, const float* source,
+unsigned int samples) {
+    mixfunc(target, source, samples);
+}
+
+void audiomixerkernel_FloatToS16(int16_t* target, const float* source,
+unsigned int samples) {
+    tos16func(target, source, samples);
+}
+
+#endif  // USE_AUDIO
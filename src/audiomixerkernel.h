@@ -0,0 +1,49 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOMIXERKERNEL_H_
+#define BLITWIZARD_AUDIOMIXERKERNEL_H_
+
+#include <stdint.h>
+
+void audiomixerkernel_Init(void);
+// Pick the fastest mixing kernel implementation the CPU supports
+// (AVX2, SSE2 or plain C). Call this once before using the functions below.
+
+const char* audiomixerkernel_GetName(void);
+// Get the name of the kernel implementation in use ("avx2", "sse2", "c").
+
+void audiomixerkernel_Mix(float* target, const float* source,
+unsigned int samples);
+// Mix the given amount of float samples from source into target
+// with soft clipping: samples of different sign are simply added,
+// samples of the same sign are combined as a + b - a * b
+// (mirrored for negative values), so two values inside -1..1
+// always result in a value inside -1..1.
+
+void audiomixerkernel_FloatToS16(int16_t* target, const float* source,
+unsigned int samples);
+// Convert float samples from -1..1 to signed 16bit samples.
+// Values outside of that range are clipped.
+
+#endif  // BLITWIZARD_AUDIOMIXERKERNEL_H_
@@ -0,0 +1,183 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audiomixer.h"
+#include "audiorender.h"
+#include "audiosourceprereadcache.h"
+#include "logging.h"
+
+#define RENDERSAMPLERATE 48000
+
+// we pretend to be a device asking for blocks of this size:
+#define RENDERBLOCKFRAMES 1024
+
+static FILE* renderfile = NULL;
+static uint64_t renderedframes = 0;
+static uint64_t totalframes = 0;
+static uint64_t startchannelframes = 0;
+static clock_t renderstart;
+
+static float renderbuf[RENDERBLOCKFRAMES * 2];
+static unsigned char renderbytes[RENDERBLOCKFRAMES * 2 * 4];
+
+static void audiorender_Write32(unsigned char* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = (value >> 24) & 0xFF;
+}
+
+static int audiorender_WriteHeader(uint32_t databytes) {
+    unsigned char header[44];
+    memcpy(header, "RIFF", 4);
+    audiorender_Write32(header + 4, 36 + databytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    audiorender_Write32(header + 16, 16);
+    header[20] = 3;  // IEEE float
+    header[21] = 0;
+    header[22] = 2;  // channels
+    header[23] = 0;
+    audiorender_Write32(header + 24, RENDERSAMPLERATE);
+    audiorender_Write32(header + 28, RENDERSAMPLERATE * 2 * 4);
+    header[32] = 2 * 4;  // block align
+    header[33] = 0;
+    header[34] = 32;  // bits per sample
+    header[35] = 0;
+    memcpy(header + 36, "data", 4);
+    audiorender_Write32(header + 40, databytes);
+    if (fseek(renderfile, 0, SEEK_SET) != 0) {
+        return 0;
+    }
+    return (fwrite(header, 1, sizeof(header), renderfile) == sizeof(header));
+}
+
+int audiorender_Start(const char* path, double seconds, char** error) {
+    if (renderfile) {
+        *error = strdup("Already rendering audio");
+        return 0;
+    }
+    if (seconds <= 0) {
+        *error = strdup("Render length must be positive");
+        return 0;
+    }
+    // the data chunk size needs to fit into 32bit:
+    if (seconds * RENDERSAMPLERATE * 2 * 4 > 0xFFFFFF00u) {
+        *error = strdup("Render length too long for a .wav file");
+        return 0;
+    }
+    renderfile = fopen(path, "wb");
+    if (!renderfile) {
+        char errbuf[512];
+        snprintf(errbuf, sizeof(errbuf), "Cannot open \"%s\" for writing",
+        path);
+        errbuf[sizeof(errbuf)-1] = 0;
+        *error = strdup(errbuf);
+        return 0;
+    }
+    if (!audiorender_WriteHeader(0)) {
+        fclose(renderfile);
+        renderfile = NULL;
+        *error = strdup("Failed to write .wav header");
+        return 0;
+    }
+    renderedframes = 0;
+    totalframes = (uint64_t)(seconds * RENDERSAMPLERATE + 0.5);
+    startchannelframes = audiomixer_GetChannelFramesMixed();
+    renderstart = clock();
+
+    // we render much faster than real time, so the decode-ahead of
+    // streamed sounds can't keep up. Wait for it instead of getting
+    // silence, so the result is the same each time:
+    audiosourceprereadcache_SetWaitForSource(1);
+    return 1;
+}
+
+int audiorender_Advance(uint64_t gametime) {
+    if (!renderfile) {
+        return 0;
+    }
+    uint64_t targetframes = gametime * RENDERSAMPLERATE / 1000;
+    if (targetframes > totalframes) {
+        targetframes = totalframes;
+    }
+    while (renderedframes < targetframes) {
+        unsigned int frames = RENDERBLOCKFRAMES;
+        if (renderedframes + frames > totalframes) {
+            // the last request is shorter
+            frames = totalframes - renderedframes;
+        }
+        audiomixer_GetBuffer(renderbuf, frames * 2 * sizeof(float));
+
+        // .wav data is little endian:
+        unsigned int i = 0;
+        while (i < frames * 2) {
+            uint32_t value;
+            memcpy(&value, &renderbuf[i], sizeof(value));
+            audiorender_Write32(renderbytes + i * 4, value);
+            i++;
+        }
+        if (fwrite(renderbytes, 1, frames * 2 * 4, renderfile) !=
+        frames * 2 * 4) {
+            printerror("Error: failed to write rendered audio");
+            return 0;
+        }
+        renderedframes += frames;
+    }
+    return (renderedframes < totalframes);
+}
+
+void audiorender_Finish(void) {
+    if (!renderfile) {
+        return;
+    }
+    double cpuseconds = (double)(clock() - renderstart) / CLOCKS_PER_SEC;
+    double audioseconds = (double)renderedframes / RENDERSAMPLERATE;
+    double channelseconds = (double)(audiomixer_GetChannelFramesMixed() -
+    startchannelframes) / RENDERSAMPLERATE;
+
+    if (!audiorender_WriteHeader(renderedframes * 2 * 4)) {
+        printerror("Error: failed to complete .wav header");
+    }
+    fclose(renderfile);
+    renderfile = NULL;
+    audiosourceprereadcache_SetWaitForSource(0);
+
+    printinfo("Rendered %.1f seconds of audio (%.1f channel seconds) "
+    "in %.2f seconds CPU time", audioseconds, channelseconds, cpuseconds);
+    if (cpuseconds > 0) {
+        printinfo("Faster than realtime: %.1fx, "
+        "%.1f channel seconds per CPU second", audioseconds / cpuseconds,
+        channelseconds / cpuseconds);
+    }
+}
+
+#endif  // USE_AUDIO
@@ -0,0 +1,50 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIORENDER_H_
+#define BLITWIZARD_AUDIORENDER_H_
+
+#ifdef USE_AUDIO
+
+#include <stdint.h>
+
+// Headless rendering of the mixer output into a 48kHz float stereo
+// .wav file, as fast as the mixer can go. The game is meant to run on
+// the virtual clock (see timefuncs.h) meanwhile, so the result only
+// depends on the game's scripts and sound files.
+
+int audiorender_Start(const char* path, double seconds, char** error);
+// Open the target file. Returns 1 on success, 0 on error (in which
+// case *error points at an error message you must free() yourself).
+
+int audiorender_Advance(uint64_t gametime);
+// Render all audio up to the given game time in milliseconds since
+// rendering started. Returns 1 if more audio is to be rendered,
+// 0 if the requested length is complete or writing failed.
+
+void audiorender_Finish(void);
+// Complete the .wav file and print throughput statistics.
+
+#endif  // USE_AUDIO
+
+#endif  // BLITWIZARD_AUDIORENDER_H_
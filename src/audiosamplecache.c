@@ -0,0 +1,315 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "os.h"
+#include "audiosource.h"
+#include "audiosourcememory.h"
+#include "audiosamplecache.h"
+#include "hash.h"
+
+// default memory budget for sounds not currently playing:
+#define DEFAULTCACHEBUDGET (1024 * 1024 * 16)
+
+// maximum size of a single cached sound (5 seconds of 48kHz float stereo):
+#define MAXCACHEDSOUNDBYTES (48000 * 4 * 2 * 5)
+
+struct cachedsound {
+    char* path;
+    char* samples;  // NULL if the sound is too long to be cached
+    unsigned int bytes;
+    unsigned int samplerate;
+    unsigned int channels;
+    unsigned int format;
+
+    // loop points of the sound in frames, if it has any:
+    int hasloop;
+    size_t loopstart, looplength;
+
+    // amount of audio sources currently playing this sound.
+    // Decreased from the audio thread, so only use atomic access:
+    int refcount;
+
+    // least recently used list, most recently used first:
+    struct cachedsound* prev,*next;
+};
+
+static hashmap* cachehashmap = NULL;
+static struct cachedsound* cachelistfirst = NULL;
+static struct cachedsound* cachelistlast = NULL;
+static size_t cachedbytes = 0;
+static size_t cachebudget = DEFAULTCACHEBUDGET;
+
+static struct cachedsound* audiosamplecache_Find(const char* path) {
+    if (!cachehashmap) {
+        return NULL;
+    }
+    return hashmap_Get(cachehashmap, path);
+}
+
+static void audiosamplecache_Unlink(struct cachedsound* s) {
+    if (s->prev) {
+        s->prev->next = s->next;
+    } else {
+        cachelistfirst = s->next;
+    }
+    if (s->next) {
+        s->next->prev = s->prev;
+    } else {
+        cachelistlast = s->prev;
+    }
+    s->prev = NULL;
+    s->next = NULL;
+}
+
+static void audiosamplecache_MarkUsed(struct cachedsound* s) {
+    // move to the front of the least recently used list
+    if (cachelistfirst == s) {
+        return;
+    }
+    if (s->prev || s->next || cachelistlast == s) {
+        audiosamplecache_Unlink(s);
+    }
+    s->next = cachelistfirst;
+    if (cachelistfirst) {
+        cachelistfirst->prev = s;
+    }
+    cachelistfirst = s;
+    if (!cachelistlast) {
+        cachelistlast = s;
+    }
+}
+
+static void audiosamplecache_Remove(struct cachedsound* s) {
+    // remove from hash map
+    hashmap_Remove(cachehashmap, s->path);
+
+    // remove from list and free
+    audiosamplecache_Unlink(s);
+    cachedbytes -= s->bytes;
+    free(s->samples);
+    free(s->path);
+    free(s);
+}
+
+static void audiosamplecache_Trim(void) {
+    // drop least recently used sounds which aren't playing
+    // until we are within our memory budget again
+    struct cachedsound* s = cachelistlast;
+    while (s && cachedbytes > cachebudget) {
+        struct cachedsound* sprev = s->prev;
+        if (__atomic_load_n(&s->refcount, __ATOMIC_ACQUIRE) <= 0 &&
+        s->samples) {
+            audiosamplecache_Remove(s);
+        }
+        s = sprev;
+    }
+}
+
+void audiosamplecache_SetMemoryBudget(size_t bytes) {
+    cachebudget = bytes;
+    audiosamplecache_Trim();
+}
+
+static void audiosamplecache_Release(void* userdata) {
+    // called when a memory audio source closes (any thread)
+    struct cachedsound* s = userdata;
+    __atomic_sub_fetch(&s->refcount, 1, __ATOMIC_RELEASE);
+}
+
+static struct audiosource* audiosamplecache_CreateSource(struct cachedsound* s) {
+    __atomic_add_fetch(&s->refcount, 1, __ATOMIC_ACQUIRE);
+    struct audiosource* a = audiosourcememory_Create(s->samples, s->bytes,
+    s->samplerate, s->channels, s->format, &audiosamplecache_Release, s);
+    if (!a) {
+        __atomic_sub_fetch(&s->refcount, 1, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    return a;
+}
+
+struct audiosource* audiosamplecache_Open(const char* path) {
+    struct cachedsound* s = audiosamplecache_Find(path);
+    if (!s || !s->samples) {
+        return NULL;
+    }
+    audiosamplecache_MarkUsed(s);
+    return audiosamplecache_CreateSource(s);
+}
+
+int audiosamplecache_IsCached(const char* path) {
+    struct cachedsound* s = audiosamplecache_Find(path);
+    return (s && s->samples);
+}
+
+static struct cachedsound* audiosamplecache_Add(const char* path) {
+    if (!cachehashmap) {
+        cachehashmap = hashmap_New(64, 0);
+        if (!cachehashmap) {
+            return NULL;
+        }
+    }
+    struct cachedsound* s = malloc(sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->path = strdup(path);
+    if (!s->path) {
+        free(s);
+        return NULL;
+    }
+
+    // add to hash map and list
+    if (!hashmap_Set(cachehashmap, s->path, s)) {
+        free(s->path);
+        free(s);
+        return NULL;
+    }
+    audiosamplecache_MarkUsed(s);
+    return s;
+}
+
+struct audiosource* audiosamplecache_Store(const char* path,
+struct audiosource* source) {
+    if (!source) {
+        return NULL;
+    }
+    struct cachedsound* s = audiosamplecache_Find(path);
+    if (s) {
+        if (!s->samples) {
+            // we already know this one is too long
+            return source;
+        }
+        // already cached, so simply use that
+        source->close(source);
+        return audiosamplecache_Open(path);
+    }
+
+    // decode the whole source into memory:
+    unsigned int size = 1024 * 64;
+    unsigned int bytes = 0;
+    char* samples = malloc(size);
+    if (!samples) {
+        return source;
+    }
+    while (1) {
+        if (bytes >= size) {
+            if (size >= MAXCACHEDSOUNDBYTES) {
+                // the budget is used up. if the sound happens to end
+                // right here, it still fits:
+                char probe[64];
+                int i = source->read(source, probe, sizeof(probe));
+                if (i < 0) {
+                    // decoding error
+                    free(samples);
+                    source->close(source);
+                    return NULL;
+                }
+                if (i == 0) {
+                    break;
+                }
+                // too long, remember not to try again
+                free(samples);
+                audiosamplecache_Add(path);
+                source->rewind(source);
+                return source;
+            }
+            size *= 2;
+            if (size > MAXCACHEDSOUNDBYTES) {
+                size = MAXCACHEDSOUNDBYTES;
+            }
+            char* newsamples = realloc(samples, size);
+            if (!newsamples) {
+                free(samples);
+                source->rewind(source);
+                return source;
+            }
+            samples = newsamples;
+        }
+        int i = source->read(source, samples + bytes, size - bytes);
+        if (i < 0) {
+            // decoding error
+            free(samples);
+            source->close(source);
+            return NULL;
+        }
+        if (i == 0) {
+            break;
+        }
+        bytes += i;
+    }
+
+    // don't keep more memory around than needed:
+    if (bytes > 0 && bytes < size) {
+        char* newsamples = realloc(samples, bytes);
+        if (newsamples) {
+            samples = newsamples;
+        }
+    }
+
+    // add it to the cache:
+    s = audiosamplecache_Add(path);
+    if (!s) {
+        free(samples);
+        source->rewind(source);
+        return source;
+    }
+    s->samples = samples;
+    s->bytes = bytes;
+    s->samplerate = source->samplerate;
+    s->channels = source->channels;
+    s->format = source->format;
+    cachedbytes += bytes;
+    source->close(source);
+
+    // play it from the cache:
+    struct audiosource* a = audiosamplecache_CreateSource(s);
+    audiosamplecache_Trim();
+    return a;
+}
+
+void audiosamplecache_SetLoopPoints(const char* path, size_t loopstart,
+size_t looplength) {
+    struct cachedsound* s = audiosamplecache_Find(path);
+    if (!s) {
+        return;
+    }
+    s->hasloop = 1;
+    s->loopstart = loopstart;
+    s->looplength = looplength;
+}
+
+int audiosamplecache_GetLoopPoints(const char* path, size_t* loopstart,
+size_t* looplength) {
+    struct cachedsound* s = audiosamplecache_Find(path);
+    if (!s || !s->hasloop) {
+        return 0;
+    }
+    *loopstart = s->loopstart;
+    *looplength = s->looplength;
+    return 1;
+}
@@ -0,0 +1,71 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOSAMPLECACHE_H_
+#define BLITWIZARD_AUDIOSAMPLECACHE_H_
+
+#include <stddef.h>
+
+// The sample cache keeps short sounds fully decoded in memory, so
+// playing the same sound effect often doesn't need to open and decode
+// the file each time. Cached sounds are played back through
+// audiosourcememory without copying the samples.
+//
+// All functions must be used from the same thread (the main thread).
+// The audio sources returned may be read and closed from any thread.
+
+void audiosamplecache_SetMemoryBudget(size_t bytes);
+// Set the amount of memory the cache may use for sounds which are
+// currently not playing. Least recently used sounds are dropped first.
+// Sounds still playing are never dropped, so the cache may exceed
+// the budget temporarily.
+
+struct audiosource* audiosamplecache_Open(const char* path);
+// Get an audio source playing the cached sound for the given path.
+// Returns NULL if the sound isn't in the cache.
+
+struct audiosource* audiosamplecache_Store(const char* path,
+struct audiosource* source);
+// Try to decode the given audio source completely into the cache.
+// The source should return the samples exactly as they should be
+// cached (so e.g. already resampled).
+// On success, the source is closed and an audio source playing the
+// cached samples is returned.
+// If the source is too long to be cached, it is rewound and returned
+// as it is (and the path is remembered to not try again next time).
+// If the source fails to decode, it is closed and NULL is returned.
+
+int audiosamplecache_IsCached(const char* path);
+// Check whether the decoded samples for the given path are in the
+// cache (1) or not (0), e.g. to know whether audiosamplecache_Store()
+// returned the source as it is.
+
+void audiosamplecache_SetLoopPoints(const char* path, size_t loopstart,
+size_t looplength);
+int audiosamplecache_GetLoopPoints(const char* path, size_t* loopstart,
+size_t* looplength);
+// Remember the loop points of a sound stored in the cache (in frames
+// of the cached samples), so they don't need to be read from the file
+// again. Get returns 0 if no loop points were set.
+
+#endif  // BLITWIZARD_AUDIOSAMPLECACHE_H_
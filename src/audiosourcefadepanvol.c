@@ -29,6 +29,9 @@
 #include "audiosource.h"
 #include "audiosourcefadepanvol.h"
 
+// amount of stereo samples we pull from our source at once:
+#define FADEPANVOLBLOCKSAMPLES 1024
+
 struct audiosourcefadepanvol_internaldata {
     struct audiosource* source;
     int sourceeof;
@@ -44,8 +47,17 @@ struct audiosourcefadepanvol_internaldata {
     float pan;
     float vol;
 
-    char processedsamplesbuf[512];
+    // samples which are ready to be returned. They are processed
+    // only when they are read, so a fade starts exactly at the next
+    // sample read after it was started:
+    float processedsamplesbuf[FADEPANVOLBLOCKSAMPLES * 2];
+    unsigned int processedsamplesoffset;
     unsigned int processedsamplesbytes;
+    unsigned int processeduptobytes;  // samples processed in the buffer
+
+    // incomplete stereo sample left over from the last block:
+    char partialsample[sizeof(float) * 2];
+    unsigned int partialsamplebytes;
 
     int noamplify; // don't amplify with soft clipping
 };
@@ -57,7 +69,7 @@ static size_t audiosourcefadepanvol_Position(struct audiosource* source) {
 
 static size_t audiosourcefadepanvol_Length(struct audiosource* source) {
     struct audiosourcefadepanvol_internaldata* idata = source->internaldata;
-    return idata->source->position(idata->source);
+    return idata->source->length(idata->source);
 }
 
 static int audiosourcefadepanvol_Seek(struct audiosource* source, size_t pos) {
@@ -69,9 +81,13 @@ static int audiosourcefadepanvol_Seek(struct audiosource* source, size_t pos) {
         // source supports seeking -> attempt to seek:
         if (idata->source->seek(idata->source, pos)) {
             // it worked!
+            idata->sourceeof = 0;
             idata->eof = 0;
             // reset our buffer to empty:
+            idata->processedsamplesoffset = 0;
             idata->processedsamplesbytes = 0;
+            idata->processeduptobytes = 0;
+            idata->partialsamplebytes = 0;
             return 1;
         }
         return 0;
@@ -87,7 +103,9 @@ static void audiosourcefadepanvol_Rewind(struct audiosource* source) {
         idata->sourceeof = 0;
         idata->eof = 0;
         idata->returnerroroneof = 0;
+        idata->processedsamplesoffset = 0;
         idata->processedsamplesbytes = 0;
+        idata->partialsamplebytes = 0;
     }
 }
 
@@ -107,134 +125,184 @@ static float amplify(float value, float amplification) {
     return value;
 }
 
-static int audiosourcefadepanvol_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
-    struct audiosourcefadepanvol_internaldata* idata = source->internaldata;
-    if (idata->eof) {
-        return -1;
-    }
-
-    unsigned int byteswritten = 0;
-    while (bytes > 0) {
-        // see how many samples we want to have minimum
-        int stereosamples = bytes / (sizeof(float) * 2);
-        if (stereosamples * sizeof(float) * 2 < bytes) {
-            stereosamples++;
-        }
-
-        // get new unprocessed samples
-        int unprocessedstart = idata->processedsamplesbytes;
-        if (!idata->sourceeof) {
-            while (idata->processedsamplesbytes + sizeof(float) * 2 <= sizeof(idata->processedsamplesbuf) && stereosamples > 0) {
-                int i = idata->source->read(idata->source, idata->processedsamplesbuf + idata->processedsamplesbytes, sizeof(float) * 2);
-                if (i < (int)sizeof(float)*2) {
-                    if (i < 0) {
-                        // read function returned error
-                        idata->returnerroroneof = 1;
-                    }
+static unsigned int audiosourcefadepanvol_ProcessBlock(struct audiosourcefadepanvol_internaldata* idata, float* samples, unsigned int stereosamples) {
+    // apply fade, volume and panning to the given stereo samples.
+    // Returns the amount of stereo samples which remain valid
+    // (less than given if the fade terminates the sound)
+    float faderange = (-idata->fadesamplestart + idata->fadesampleend);
+    float fadeprogress = idata->fadesampleend;
+    unsigned int i = 0;
+    while (i < stereosamples) {
+        float leftchannel = samples[i * 2];
+        float rightchannel = samples[i * 2 + 1];
+
+        if (idata->fadesamplestart < 0 || idata->fadesampleend > 0) {
+            // calculate fade volume
+            idata->vol = idata->fadevaluestart + (idata->fadevalueend - idata->fadevaluestart)*(1 - fadeprogress/faderange);
+
+            // increase fade progress
+            idata->fadesamplestart--;
+            idata->fadesampleend--;
+            fadeprogress = idata->fadesampleend;
+
+            if (idata->fadesampleend < 0) {
+                // fade ended
+                idata->vol = idata->fadevalueend;
+                idata->fadesamplestart = 0;
+                idata->fadesampleend = 0;
+
+                if (idata->terminateafterfade) {
+                    // drop everything after this sample
                     idata->sourceeof = 1;
-                    break;
-                }else{
-                    idata->processedsamplesbytes += sizeof(float)*2;
+                    stereosamples = i + 1;
                 }
-                stereosamples--;
             }
         }
 
-        // process unprocessed samples
-        unsigned int i = unprocessedstart;
-        float faderange = (-idata->fadesamplestart + idata->fadesampleend);
-        float fadeprogress = idata->fadesampleend;
-        while ((int)i <= ((int)idata->processedsamplesbytes - ((int)sizeof(float) * 2))) {
-            float leftchannel = *((float*)((char*)idata->processedsamplesbuf+i));
-            float rightchannel = *((float*)((float*)((char*)idata->processedsamplesbuf+i))+1);
-
-            if (idata->fadesamplestart < 0 || idata->fadesampleend > 0) {
-                // calculate fade volume
-                idata->vol = idata->fadevaluestart + (idata->fadevalueend - idata->fadevaluestart)*(1 - fadeprogress/faderange);
-
-                // increase fade progress
-                idata->fadesamplestart--;
-                idata->fadesampleend--;
-                fadeprogress = idata->fadesampleend;
-
-                if (idata->fadesampleend < 0) {
-                    // fade ended
-                    idata->vol = idata->fadevalueend;
-                    idata->fadesamplestart = 0;
-                    idata->fadesampleend = 0;
-
-                    if (idata->terminateafterfade) {
-                        idata->sourceeof = 1;
-                        i = idata->processedsamplesbytes;
-                    }
-                }
-            }
+        // apply volume
+        if (!idata->noamplify) {
+            leftchannel = amplify(leftchannel, idata->vol);
+            rightchannel = amplify(rightchannel, idata->vol);
+        } else {
+            leftchannel *= idata->vol;
+            rightchannel *= idata->vol;
+        }
 
-            // apply volume
-            if (!idata->noamplify) {
-                leftchannel = amplify(leftchannel, idata->vol);
-                rightchannel = amplify(rightchannel, idata->vol);
-            } else {
-                leftchannel *= idata->vol;
-                rightchannel *= idata->vol;
-            }
+        // calculate panning
+        if (idata->pan < 0) {
+            leftchannel *= (1+idata->pan);
+        }
+        if (idata->pan > 0) {
+            rightchannel *= (1-idata->pan);
+        }
 
-            // calculate panning
-            if (idata->pan < 0) {
-                leftchannel *= (1+idata->pan);
-            }
+        // amplify channels when closer to edges:
+        float panningamplifyfactor = abs(idata->pan);
+        float amplifyamount = 1.3;
+        if (!idata->noamplify) {
             if (idata->pan > 0) {
-                rightchannel *= (1-idata->pan);
+                leftchannel = amplify(leftchannel,
+                1 + panningamplifyfactor * (amplifyamount-1));
+            } else {
+                rightchannel = amplify(rightchannel,
+                1 + panningamplifyfactor * (amplifyamount-1));
             }
+        }
 
-            // amplify channels when closer to edges:
-            float panningamplifyfactor = abs(idata->pan);
-            float amplifyamount = 1.3;
-            if (!idata->noamplify) {
-                if (idata->pan > 0) {
-                    leftchannel = amplify(leftchannel,
-                    1 + panningamplifyfactor * (amplifyamount-1));
-                } else {
-                    rightchannel = amplify(rightchannel,
-                    1 + panningamplifyfactor * (amplifyamount-1));
-                }
+        // write floats back
+        samples[i * 2] = leftchannel;
+        samples[i * 2 + 1] = rightchannel;
+
+        i++;
+    }
+    return stereosamples;
+}
+
+static void audiosourcefadepanvol_FillBlock(struct audiosourcefadepanvol_internaldata* idata, unsigned int bytes) {
+    // pull a whole block of new samples from our source
+    // and process it in one go
+    char* buf = (char*)idata->processedsamplesbuf;
+    unsigned int wantbytes = bytes;
+    if (wantbytes % (sizeof(float) * 2) != 0) {
+        wantbytes += (sizeof(float) * 2) - (wantbytes % (sizeof(float) * 2));
+    }
+    if (wantbytes > sizeof(idata->processedsamplesbuf)) {
+        wantbytes = sizeof(idata->processedsamplesbuf);
+    }
+
+    // put back the incomplete sample from last time
+    unsigned int filledbytes = idata->partialsamplebytes;
+    memcpy(buf, idata->partialsample, idata->partialsamplebytes);
+    idata->partialsamplebytes = 0;
+
+    // read as much as we want (or until the source ends)
+    while (filledbytes < wantbytes && !idata->sourceeof) {
+        int i = idata->source->read(idata->source, buf + filledbytes, wantbytes - filledbytes);
+        if (i <= 0) {
+            if (i < 0) {
+                // read function returned error
+                idata->returnerroroneof = 1;
             }
+            idata->sourceeof = 1;
+            break;
+        }
+        filledbytes += i;
+    }
 
-            // write floats back
-            memcpy(idata->processedsamplesbuf+i, &leftchannel, sizeof(float));
-            memcpy(idata->processedsamplesbuf+i+sizeof(float), &rightchannel, sizeof(float));
+    // keep an incomplete trailing sample for the next block
+    unsigned int stereosamples = filledbytes / (sizeof(float) * 2);
+    if (!idata->sourceeof) {
+        idata->partialsamplebytes = filledbytes - stereosamples * sizeof(float) * 2;
+        memcpy(idata->partialsample, buf + stereosamples * sizeof(float) * 2, idata->partialsamplebytes);
+    }
 
-            i += sizeof(float)*2;
+    idata->processedsamplesoffset = 0;
+    idata->processedsamplesbytes = stereosamples * sizeof(float) * 2;
+    idata->processeduptobytes = 0;
+}
+
+static void audiosourcefadepanvol_ProcessUpTo(struct audiosourcefadepanvol_internaldata* idata, unsigned int bytes) {
+    // process all samples up to the given byte offset in our buffer
+    // (including the one containing it)
+    unsigned int available = idata->processedsamplesoffset + idata->processedsamplesbytes;
+    if (bytes % (sizeof(float) * 2) != 0) {
+        bytes += (sizeof(float) * 2) - (bytes % (sizeof(float) * 2));
+    }
+    if (bytes > available) {
+        bytes = available;
+    }
+    if (bytes <= idata->processeduptobytes) {
+        return;
+    }
+    unsigned int stereosamples = (bytes - idata->processeduptobytes) / (sizeof(float) * 2);
+    unsigned int valid = audiosourcefadepanvol_ProcessBlock(idata, (float*)((char*)idata->processedsamplesbuf + idata->processeduptobytes), stereosamples);
+    idata->processeduptobytes += valid * sizeof(float) * 2;
+    if (valid < stereosamples) {
+        // the fade terminated the sound, drop the rest
+        idata->processedsamplesbytes = idata->processeduptobytes - idata->processedsamplesoffset;
+    }
+}
+
+static int audiosourcefadepanvol_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
+    struct audiosourcefadepanvol_internaldata* idata = source->internaldata;
+    if (idata->eof) {
+        return -1;
+    }
+
+    unsigned int byteswritten = 0;
+    while (bytes > 0) {
+        // get a new block of processed samples if we ran out
+        if (idata->processedsamplesbytes == 0) {
+            if (idata->sourceeof) {
+                break;
+            }
+            audiosourcefadepanvol_FillBlock(idata, bytes);
+            continue;
         }
 
-        // return from our processed samples
+        // process and return as much of our samples as wanted
+        audiosourcefadepanvol_ProcessUpTo(idata, idata->processedsamplesoffset + bytes);
         unsigned int returnbytes = bytes;
         if (returnbytes > idata->processedsamplesbytes) {
             returnbytes = idata->processedsamplesbytes;
         }
         if (returnbytes == 0) {
-            if (byteswritten == 0) {
-                idata->eof = 1;
-                if (idata->returnerroroneof) {
-                    return -1;
-                }
-                return 0;
-            }else{
-                return byteswritten;
-            }
-        }else{
-            byteswritten += returnbytes;
-            memcpy(buffer, idata->processedsamplesbuf, returnbytes);
-            buffer += returnbytes;
-            bytes -= returnbytes;
+            continue;
         }
-        // move away processed & returned samples
-        if (returnbytes > 0) {
-            if (idata->processedsamplesbytes - returnbytes > 0) {
-                memmove(idata->processedsamplesbuf, idata->processedsamplesbuf + returnbytes, sizeof(idata->processedsamplesbuf) - returnbytes);
-            }
-            idata->processedsamplesbytes -= returnbytes;
+        memcpy(buffer, (char*)idata->processedsamplesbuf + idata->processedsamplesoffset, returnbytes);
+        byteswritten += returnbytes;
+        buffer += returnbytes;
+        bytes -= returnbytes;
+        idata->processedsamplesoffset += returnbytes;
+        idata->processedsamplesbytes -= returnbytes;
+    }
+
+    if (byteswritten == 0) {
+        idata->eof = 1;
+        if (idata->returnerroroneof) {
+            return -1;
         }
+        return 0;
     }
     return byteswritten;
 }
@@ -335,9 +403,26 @@ void audiosourcefadepanvol_SetPanVol(struct audiosource* source, float vol, floa
     idata->fadevalueend = vol;
 }
 
+void audiosourcefadepanvol_Preload(struct audiosource* source) {
+    struct audiosourcefadepanvol_internaldata* idata = source->internaldata;
+    if (idata->eof || idata->sourceeof || idata->processedsamplesbytes > 0) {
+        return;
+    }
+    audiosourcefadepanvol_FillBlock(idata, sizeof(idata->processedsamplesbuf));
+}
+
 void audiosourcefadepanvol_StartFade(struct audiosource* source, float seconds, float targetvol, int terminate) {
     struct audiosourcefadepanvol_internaldata* idata = source->internaldata;
     if (seconds <= 0) {
+        audiosourcefadepanvol_StartFadeFrames(source, 0, targetvol, terminate);
+        return;
+    }
+    audiosourcefadepanvol_StartFadeFrames(source, (unsigned int)((double)((double)idata->source->samplerate) * ((double)seconds)), targetvol, terminate);
+}
+
+void audiosourcefadepanvol_StartFadeFrames(struct audiosource* source, unsigned int frames, float targetvol, int terminate) {
+    struct audiosourcefadepanvol_internaldata* idata = source->internaldata;
+    if (frames == 0) {
         idata->fadevaluestart = 0;
         idata->fadevalueend = 0;
         idata->fadesamplestart = 0;
@@ -358,5 +443,5 @@ void audiosourcefadepanvol_StartFade(struct audiosource* source, float seconds,
     idata->fadevaluestart = idata->vol;
     idata->fadevalueend = targetvol;
     idata->fadesamplestart = 0;
-    idata->fadesampleend = (int)((double)((double)idata->source->samplerate) * ((double)seconds));
+    idata->fadesampleend = frames;
 }
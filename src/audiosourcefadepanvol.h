@@ -37,5 +37,13 @@ float volume, float pan, int noamplify);
 // Start a fade to a given volume level:
 void audiosourcefadepanvol_StartFade(struct audiosource* source, float seconds, float targetvol, int terminate);
 
-
+// Start a fade lasting the given amount of frames. The fade begins
+// exactly with the next frame read from the source:
+void audiosourcefadepanvol_StartFadeFrames(struct audiosource* source, unsigned int frames, float targetvol, int terminate);
+
+// Decode and process the first block of audio right away, so the first
+// read (usually from the audio thread) doesn't need to decode anything:
+void audiosourcefadepanvol_Preload(struct audiosource* source);
+// Volume, panning and fade may still be changed afterwards, since
+// samples are only processed when they are read.
 
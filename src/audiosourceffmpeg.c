@@ -41,6 +41,7 @@
 #include "library.h"
 #include "filelist.h"
 #include "file.h"
+#include "threading.h"
 
 #ifndef USE_FFMPEG_AUDIO
 
@@ -69,11 +70,6 @@ int audiosourceffmpeg_LoadFFmpeg() {
 
 #define AVIOBUFSIZE (AVCODEC_MAX_AUDIO_FRAME_SIZE*2)
 
-#define DECODEBUFUSESIZE (4096*2)
-#define DECODEBUFSIZE (DECODEBUFUSESIZE + FF_INPUT_BUFFER_PADDING_SIZE)
-#define DECODEBUFMEMMOVETHRESHOLD (4096)
-#define DECODEDBUFSIZE (4096*20)
-
 struct audiosourceffmpeg_internaldata {
     struct audiosource* source;
     int sourceeof;
@@ -82,19 +78,35 @@ struct audiosourceffmpeg_internaldata {
     int packetseof;
 
     unsigned char* aviobuf __attribute__ ((aligned(16)));
-    unsigned int bufbytes;
-    unsigned int bufoffset;
-    char* decodedbuf __attribute__ ((aligned(16)));
     char* tempbuf __attribute__ ((aligned(16)));
-    int decodedbufbytes;
     AVCodecContext* codeccontext;
     AVFormatContext* formatcontext;
     AVIOContext* iocontext;
     AVCodec* audiocodec;
     AVPacket packet;
+    int havepacket;
+    AVPacket decodepacket;  // the part of the packet not decoded yet
     AVFrame* decodedframe;
+
+    // decoded data of the last frame not returned yet. It is copied
+    // from the frame straight to the reader, without buffering it:
+    const char* pending;
+    unsigned int pendingbytes;
 }  __attribute__ ((aligned(16)));
 
+// The AVIO buffer, frame and decode buffer are expensive to allocate
+// (the AVIO buffer alone is several hundred KB), so they are kept
+// here when a sound is closed and reused by the next one:
+#define MAXPOOLEDDECODERS 8
+struct pooleddecoder {
+    unsigned char* aviobuf;
+    char* tempbuf;
+    AVFrame* decodedframe;
+};
+static struct pooleddecoder pooleddecoders[MAXPOOLEDDECODERS];
+static int pooleddecodercount = 0;
+static mutex* poollock = NULL;
+
 static int ffmpegopened = 0;
 static void* avformatptr;
 static void* avcodecptr;
@@ -128,6 +140,9 @@ static int (*ffmpeg_av_strerror)(int errnum, char* errbuf, size_t errbuf_size);
 static AVCodec* (*ffmpeg_avcodec_find_decoder)(enum CodecID id);
 static int (*ffmpeg_av_samples_get_buffer_size)(int*, int, int, enum AVSampleFormat, int);
 static void (*ffmpeg_av_log_set_level)(int level);
+static int (*ffmpeg_avcodec_close)(AVCodecContext*);
+static void (*ffmpeg_avformat_close_input)(AVFormatContext**);
+static void (*ffmpeg_avcodec_get_frame_defaults)(AVFrame*);
 
 static int loadorfailstate = 0;
 static void loadorfail(void** ptr, void* lib, const char* name) {
@@ -185,6 +200,9 @@ static int audiosourceffmpeg_LoadFFmpegFunctions(void) {
     loadorfail((void**)(&ffmpeg_avcodec_find_decoder), avcodecptr, "avcodec_find_decoder");
     loadorfail((void**)(&ffmpeg_avcodec_alloc_frame), avcodecptr, "avcodec_alloc_frame");
     loadorfail((void**)(&ffmpeg_av_log_set_level), avutilptr, "av_log_set_level");
+    loadorwarn((void**)(&ffmpeg_avcodec_close), avcodecptr, "avcodec_close");
+    loadorwarn((void**)(&ffmpeg_avformat_close_input), avformatptr, "avformat_close_input");
+    loadorwarn((void**)(&ffmpeg_avcodec_get_frame_defaults), avcodecptr, "avcodec_get_frame_defaults");
 
     if (loadorfailstate) {
         return 0;
@@ -341,66 +359,120 @@ int audiosourceffmpeg_LoadFFmpeg(void) {
 #ifdef FFMPEGDEBUG
     printinfo("[FFmpeg-debug] Library successfully loaded.");
 #endif
+    // (without the lock, decoder buffers simply aren't pooled)
+    poollock = mutex_Create();
     ffmpegopened = 1;
     return 1;
 }
 
-static void audiosourceffmpeg_Rewind(struct audiosource* source) {
-    struct audiosourceffmpeg_internaldata* idata = source->internaldata;
-    if (idata->returnerroroneof) {
+static void audiosourceffmpeg_TakePooledDecoder(struct audiosourceffmpeg_internaldata* idata) {
+    // reuse the buffers of a previously closed sound if we can
+    if (!poollock) {
         return;
     }
-    idata->eof = 0;
-    if (idata->source) {
-        idata->source->rewind(idata->source);
+    mutex_Lock(poollock);
+    if (pooleddecodercount > 0) {
+        pooleddecodercount--;
+        struct pooleddecoder* d = &pooleddecoders[pooleddecodercount];
+        idata->aviobuf = d->aviobuf;
+        idata->tempbuf = d->tempbuf;
+        idata->decodedframe = d->decodedframe;
     }
-    idata->sourceeof = 0;
-    idata->packetseof = 0;
-    if (idata->codeccontext) {
-        ffmpeg_av_free(idata->codeccontext);
-        idata->codeccontext = NULL;
+    mutex_Release(poollock);
+    if (idata->decodedframe) {
+        ffmpeg_avcodec_get_frame_defaults(idata->decodedframe);
     }
-    if (idata->formatcontext) {
-        ffmpeg_av_free(idata->formatcontext);
-        idata->formatcontext = NULL;
+}
+
+static void audiosourceffmpeg_ReleaseDecoder(struct audiosourceffmpeg_internaldata* idata) {
+    // put our buffers into the pool, or free them if it is full
+    if (poollock && (idata->aviobuf || idata->decodedframe) &&
+    (idata->decodedframe == NULL || ffmpeg_avcodec_get_frame_defaults)) {
+        mutex_Lock(poollock);
+        if (pooleddecodercount < MAXPOOLEDDECODERS) {
+            struct pooleddecoder* d = &pooleddecoders[pooleddecodercount];
+            d->aviobuf = idata->aviobuf;
+            d->tempbuf = idata->tempbuf;
+            d->decodedframe = idata->decodedframe;
+            pooleddecodercount++;
+            idata->aviobuf = NULL;
+            idata->tempbuf = NULL;
+            idata->decodedframe = NULL;
+        }
+        mutex_Release(poollock);
     }
-    if (idata->iocontext) {
-        ffmpeg_av_free(idata->iocontext);
-        idata->iocontext = NULL;
-        idata->aviobuf = NULL; // FFmpeg seems to implicitely free that one too
+    if (idata->aviobuf) {
+        ffmpeg_av_free(idata->aviobuf);
+        idata->aviobuf = NULL;
+    }
+    if (idata->tempbuf) {
+        ffmpeg_av_free(idata->tempbuf);
+        idata->tempbuf = NULL;
+    }
+    if (idata->decodedframe) {
+        ffmpeg_av_free(idata->decodedframe);
+        idata->decodedframe = NULL;
     }
 }
 
-static void audiosourceffmpeg_FreeFFmpegData(struct audiosource* source) {
-    if (!audiosourceffmpeg_LoadFFmpeg()) {
-        return;
+static void audiosourceffmpeg_CloseStream(struct audiosourceffmpeg_internaldata* idata) {
+    // close the demuxer and decoder, but keep our buffers
+    idata->pending = NULL;
+    idata->pendingbytes = 0;
+    if (idata->havepacket) {
+        ffmpeg_av_free_packet(&idata->packet);
+        idata->havepacket = 0;
     }
-    struct audiosourceffmpeg_internaldata* idata = source->internaldata;
+    memset(&idata->decodepacket, 0, sizeof(idata->decodepacket));
     if (idata->codeccontext) {
-        // ffmpeg_av_free(idata->codeccontext);  // handled by format contex
+        // the codec context itself belongs to the format context
+        if (ffmpeg_avcodec_close) {
+            ffmpeg_avcodec_close(idata->codeccontext);
+        }
         idata->codeccontext = NULL;
     }
     if (idata->formatcontext) {
-        ffmpeg_av_free(idata->formatcontext);
+        if (ffmpeg_avformat_close_input) {
+            // (this leaves our own IO context alone)
+            ffmpeg_avformat_close_input(&idata->formatcontext);
+        } else {
+            ffmpeg_av_free(idata->formatcontext);
+        }
         idata->formatcontext = NULL;
     }
     if (idata->iocontext) {
+        if (idata->iocontext->buffer != idata->aviobuf) {
+            // FFmpeg replaced our buffer with one of its own
+            // (and freed ours):
+            ffmpeg_av_free(idata->iocontext->buffer);
+            idata->aviobuf = NULL;
+        }
         ffmpeg_av_free(idata->iocontext);
         idata->iocontext = NULL;
     }
-    if (idata->decodedframe) {
-        ffmpeg_av_free(idata->decodedframe);
-        idata->decodedframe = NULL;
+}
+
+static void audiosourceffmpeg_Rewind(struct audiosource* source) {
+    struct audiosourceffmpeg_internaldata* idata = source->internaldata;
+    if (idata->returnerroroneof) {
+        return;
     }
-    if (idata->decodedbuf) {
-        ffmpeg_av_free(idata->decodedbuf);
-        idata->decodedbuf = NULL;
+    idata->eof = 0;
+    if (idata->source) {
+        idata->source->rewind(idata->source);
     }
-    if (idata->tempbuf) {
-        ffmpeg_av_free(idata->tempbuf);
-        idata->tempbuf = NULL;
+    idata->sourceeof = 0;
+    idata->packetseof = 0;
+    audiosourceffmpeg_CloseStream(idata);
+}
+
+static void audiosourceffmpeg_FreeFFmpegData(struct audiosource* source) {
+    if (!audiosourceffmpeg_LoadFFmpeg()) {
+        return;
     }
-    // it appears freeing idata->aviobuf is handled by freeing the iocontext
+    struct audiosourceffmpeg_internaldata* idata = source->internaldata;
+    audiosourceffmpeg_CloseStream(idata);
+    audiosourceffmpeg_ReleaseDecoder(idata);
 }
 
 static void audiosourceffmpeg_FatalError(struct audiosource* source) {
@@ -410,6 +482,117 @@ static void audiosourceffmpeg_FatalError(struct audiosource* source) {
     idata->returnerroroneof = 1;
 }
 
+static int audiosourceffmpeg_DecodeFrame(struct audiosource* source) {
+    // Decode the next frame and make its data pending to be returned.
+    // Returns 0 on a fatal error.
+    struct audiosourceffmpeg_internaldata* idata = source->internaldata;
+
+    // fetch a new packet if we decoded all of the last one:
+    if (idata->decodepacket.size <= 0) {
+        if (idata->havepacket) {
+            ffmpeg_av_free_packet(&idata->packet);
+            idata->havepacket = 0;
+        }
+        if (ffmpeg_av_read_frame(idata->formatcontext, &idata->packet) != 0) {
+            // EOF or error:
+            idata->packetseof = 1;
+            return 1;
+        }
+        idata->havepacket = 1;
+        idata->decodepacket = idata->packet;
+    }
+
+    // decode with FFmpeg:
+    int len,gotframe;
+    char* outputbuf __attribute__ ((aligned(16))) = NULL;
+    int bufsize = 0;
+    // old variant: decode_audio3:
+    if (!ffmpeg_avcodec_decode_audio4) {
+        if (!idata->tempbuf) {
+            idata->tempbuf = ffmpeg_av_malloc(
+            AVCODEC_MAX_AUDIO_FRAME_SIZE + 32);
+            if (!idata->tempbuf) {
+                audiosourceffmpeg_FatalError(source);
+                return 0;
+            }
+        }
+        outputbuf = idata->tempbuf;
+
+        bufsize = AVCODEC_MAX_AUDIO_FRAME_SIZE + 16;
+        gotframe = 0;
+        len = ffmpeg_avcodec_decode_audio3(
+            idata->codeccontext,
+            (int16_t*)outputbuf,
+            &bufsize,
+            &idata->decodepacket
+        );
+        if (len > 0) {
+            gotframe = 1;
+        }
+    } else {
+        // new variant: decode_audio4:
+        len = ffmpeg_avcodec_decode_audio4(
+            idata->codeccontext,
+            idata->decodedframe,
+            &gotframe,
+            &idata->decodepacket
+        );
+    }
+
+    if (len < 0) {
+        // A decode error occured:
+#ifdef FFMPEGDEBUG
+        char errbuf[512] = "Unknown";
+        if (ffmpeg_av_strerror) {
+            ffmpeg_av_strerror(len, errbuf, sizeof(errbuf)-1);
+        }
+        errbuf[sizeof(errbuf)-1] = 0;
+        printwarning("[FFmpeg-debug] avcodec_decode_audio3 error: %s",errbuf);
+#endif
+        ffmpeg_av_free_packet(&idata->packet);
+        idata->havepacket = 0;
+        memset(&idata->decodepacket, 0, sizeof(idata->decodepacket));
+        if (ffmpeg_av_read_frame(idata->formatcontext, &idata->packet) < 0) {
+            // buggy FFmpeg EOF
+#ifdef FFMPEGDEBUG
+            printwarning("[FFmpeg-debug] buggy FFmpeg EOF");
+#endif
+            idata->packetseof = 1;
+            return 1;
+        }
+        idata->havepacket = 1;
+        audiosourceffmpeg_FatalError(source);
+        return 0;
+    }
+    if (len == 0) {
+        idata->packetseof = 1;
+    }
+
+    // a packet may contain more than one frame, so continue with
+    // the rest of it next time:
+    idata->decodepacket.data += len;
+    idata->decodepacket.size -= len;
+
+    // remember the decoded data to be returned
+    if (gotframe) {
+        if (!ffmpeg_avcodec_decode_audio4) {
+            // old variant: decode_audio3:
+            idata->pendingbytes = bufsize;
+            idata->pending = outputbuf;
+        } else {
+            // new variant: decode_audio4:
+            idata->pendingbytes = ffmpeg_av_samples_get_buffer_size(
+            NULL,
+            idata->codeccontext->channels,
+            idata->decodedframe->nb_samples,
+            idata->codeccontext->sample_fmt,
+            1);
+            idata->pending = (char*)idata->decodedframe->data[0];
+        }
+    }
+    return 1;
+}
+
 static int audiosourceffmpeg_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
     struct audiosourceffmpeg_internaldata* idata = source->internaldata;
 
@@ -529,15 +712,6 @@ static int audiosourceffmpeg_Read(struct audiosource* source, char* buffer, unsi
             return -1;
         }
 
-        // Allocate buffer for finished, decoded data
-        if (!idata->decodedbuf) {
-            idata->decodedbuf = ffmpeg_av_malloc(DECODEDBUFSIZE);
-            if (!idata->decodedbuf) {
-                audiosourceffmpeg_FatalError(source);
-                return -1;
-            }
-        }
-
         // Remember format data
         source->channels = c->channels;
         source->samplerate = c->sample_rate;
@@ -571,148 +745,28 @@ static int audiosourceffmpeg_Read(struct audiosource* source, char* buffer, unsi
     // we need to return how many bytes we read, so remember it here:
     int writtenbytes = 0;
 
-    // we might have some decoded bytes left:
-    if (idata->decodedbufbytes > 0 && bytes > 0) {
-        // see how many we want to copy and how many we can actually copy:
-        int copybytes = bytes;
-
-        if (copybytes > idata->decodedbufbytes) {
-            copybytes = idata->decodedbufbytes;
-        }
-
-        // copy bytes to passed buffer:
-        memcpy(buffer, idata->decodedbuf, copybytes);
-        buffer += copybytes;
-
-        // trim copied bytes from our internal buffer of decoded data:
-        if (copybytes < idata->decodedbufbytes) {
-            memmove(idata->decodedbuf, idata->decodedbuf + copybytes, DECODEDBUFSIZE - copybytes);
+    while (bytes > 0) {
+        // return what is left of the last decoded frame:
+        if (idata->pendingbytes > 0) {
+            unsigned int copybytes = bytes;
+            if (copybytes > idata->pendingbytes) {
+                copybytes = idata->pendingbytes;
+            }
+            memcpy(buffer, idata->pending, copybytes);
+            buffer += copybytes;
+            bytes -= copybytes;
+            writtenbytes += copybytes;
+            idata->pending += copybytes;
+            idata->pendingbytes -= copybytes;
+            continue;
         }
-
-        idata->decodedbufbytes -= copybytes;
-        bytes -= copybytes;
-        writtenbytes += copybytes;
-    }
-
-    while (bytes > 0 && !idata->packetseof) {
-        int packetresult = -1;
-        if (!idata->packetseof) { // fetch new packet
-            packetresult = ffmpeg_av_read_frame(idata->formatcontext, &idata->packet);
+        if (idata->packetseof) {
+            break;
         }
-        if (packetresult == 0) {
-            // decode with FFmpeg:
-            int len,gotframe;
-            char* outputbuf __attribute__ ((aligned(16)));
-            int bufsize = 0;
-            // old variant: decode_audio3:
-            if (!ffmpeg_avcodec_decode_audio4) {
-                if (!idata->tempbuf) {
-                    idata->tempbuf = ffmpeg_av_malloc(
-                    AVCODEC_MAX_AUDIO_FRAME_SIZE + 32);
-                    outputbuf = idata->tempbuf;
-                }
 
-                bufsize = AVCODEC_MAX_AUDIO_FRAME_SIZE + 16;
-                gotframe = 0;
-                len = ffmpeg_avcodec_decode_audio3(
-                    idata->codeccontext,
-                    (int16_t*)outputbuf,
-                    &bufsize,
-                    &idata->packet
-                );
-                if (len > 0) {
-                    gotframe = 1;
-                }
-            } else {
-                // new variant: decode_audio4:
-                len = ffmpeg_avcodec_decode_audio4(
-                    idata->codeccontext,
-                    idata->decodedframe,
-                    &gotframe,
-                    &idata->packet
-                );
-            }
-
-            if (len < 0) {
-                // A decode error occured:
-#ifdef FFMPEGDEBUG
-                char errbuf[512] = "Unknown";
-                if (ffmpeg_av_strerror) {
-                    ffmpeg_av_strerror(len, errbuf, sizeof(errbuf)-1);
-                }
-                errbuf[sizeof(errbuf)-1] = 0;
-                printwarning("[FFmpeg-debug] avcodec_decode_audio3 error: %s",errbuf);
-#endif
-                if (ffmpeg_av_read_frame(idata->formatcontext, &idata->packet) < 0) {
-                    // buggy FFmpeg EOF
-#ifdef FFMPEGDEBUG
-                    printwarning("[FFmpeg-debug] buggy FFmpeg EOF");
-#endif
-                    idata->packetseof = 1;
-                    return writtenbytes;
-                }
-                audiosourceffmpeg_FatalError(source);
-                return -1;
-            }else{
-                if (len == 0) {
-                    idata->packetseof = 1;
-                }
-            }
-
-            // return data if we have some
-            if (gotframe) {
-                int framesize;  // amount of bytes
-                const char* p;  // pointer to byte data
-                if (!ffmpeg_avcodec_decode_audio4) {
-                    // old variant: decode_audio3:
-                    framesize = bufsize;
-                    p = outputbuf;
-                } else {
-                    // new variant: decode_audio4:
-                    framesize = ffmpeg_av_samples_get_buffer_size(
-                    NULL,
-                    idata->codeccontext->channels,
-                    idata->decodedframe->nb_samples,
-                    idata->codeccontext->sample_fmt,
-                    1);
-                    p = (char*)idata->decodedframe->data[0];
-                }
-
-                // first, export as much as we can
-                if (bytes > 0) {
-                    // ideally, we would copy the whole frame:
-                    unsigned int copybytes = framesize;
-
-                    // practically, we don't want more than specified in 'bytes':
-                    if (copybytes > bytes) {
-                        copybytes = bytes;
-                    }
-
-                    // copy the bytes, move the buffers accordingly:
-                    memcpy(buffer, p, copybytes);
-                    buffer += copybytes;
-                    bytes -= copybytes;
-                    framesize -= copybytes;
-                    p += copybytes;
-                    writtenbytes += copybytes;
-                }
-
-                // maximal preserval size:
-                if (framesize > DECODEDBUFSIZE) {
-                    // we will simply crop the frame.
-                    // evil but the show must go on
-                    framesize = DECODEDBUFSIZE;
-                }
-
-                // if we have any bytes left, preserve them now:
-                if (framesize > 0) {
-                    memcpy(idata->decodedbuf + idata->decodedbufbytes, p, framesize);
-                    idata->decodedbufbytes += framesize;
-                }
-            }
-        }else{
-            // EOF or error:
-            idata->packetseof = 1;
+        // decode the next frame:
+        if (!audiosourceffmpeg_DecodeFrame(source)) {
+            return -1;
         }
     }
     return writtenbytes;
@@ -728,9 +782,6 @@ static void audiosourceffmpeg_Close(struct audiosource* source) {
         // close FFmpeg stuff
         audiosourceffmpeg_FreeFFmpegData(source);
         // free all structs & strings
-        if (idata) {
-            free(idata);
-        }
         free(idata);
     }
     free(source);
@@ -780,11 +831,17 @@ struct audiosource* audiosourceffmpeg_Create(struct audiosource* source) {
     idata->source = source;
     if (audiosourceffmpeg_LoadFFmpeg()) {
         ffmpeg_av_init_packet(&idata->packet);
-        idata->decodedframe = ffmpeg_avcodec_alloc_frame();
+        audiosourceffmpeg_TakePooledDecoder(idata);
+        if (!idata->decodedframe) {
+            idata->decodedframe = ffmpeg_avcodec_alloc_frame();
+        }
     }
 
     // without packet data we cannot continue:
     if (!idata->decodedframe) {
+        if (ffmpegopened == 1) {
+            audiosourceffmpeg_ReleaseDecoder(idata);
+        }
         free(idata);
         free(a);
         if (source) {
@@ -33,22 +33,74 @@
 #include "SDL.h"
 #endif
 
+#if defined(UNIX) && !defined(SDLRW)
+// use memory-mapped files where possible:
+#define USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 struct audiosourcefile_internaldata {
 #ifdef SDLRW
     SDL_RWops* file;
 #else
     FILE* file;
 #endif
+#ifdef USE_MMAP
+    const char* mapping;  // NULL if the file isn't memory-mapped
+#endif
+    size_t length;  // file size, valid once the file was opened
+    int lengthknown;  // 1 once the file size was obtained
+    size_t pos;
     int eof;
     char* path;
 };
 
-static void audiosourcefile_Rewind(struct audiosource* source) {
-    struct audiosourcefile_internaldata* idata = source->internaldata;
-    idata->eof = 0;
+static int audiosourcefile_Open(struct audiosourcefile_internaldata* idata) {
+    // Open the file if we haven't yet (or it was closed for a rewind).
+    // Returns 1 on success, 0 on error.
+#ifdef USE_MMAP
+    if (idata->mapping) {
+        return 1;
+    }
+#endif
+    if (idata->file) {
+        return 1;
+    }
+#ifdef SDLRW
+    idata->file = SDL_RWFromFile(idata->path, "rb");
+#else
+    idata->file = fopen(idata->path,"rb");
+#endif
+    if (!idata->file) {
+        idata->file = NULL;
+        return 0;
+    }
+
+    // obtain file size:
+#ifdef SDLRW
+    idata->file->seek(idata->file, 0, RW_SEEK_END);
+    long size = idata->file->seek(idata->file, 0, RW_SEEK_CUR);
+    idata->file->seek(idata->file, 0, RW_SEEK_SET);
+#else
+    fseek(idata->file, 0L, SEEK_END);
+    long size = ftell(idata->file);
+    fseek(idata->file, 0L, SEEK_SET);
+#endif
+    if (size < 0) {
+        size = 0;
+    }
+    idata->length = size;
+    idata->lengthknown = 1;
+    idata->pos = 0;
+    return 1;
+}
+
+static void audiosourcefile_CloseFile(struct audiosourcefile_internaldata* idata) {
     if (idata->file) {
 #ifdef SDLRW
-        // Close the file. it will be reopened on next read
         idata->file->close(idata->file);
 #else
         fclose(idata->file);
@@ -57,21 +109,48 @@ static void audiosourcefile_Rewind(struct audiosource* source) {
     }
 }
 
+static void audiosourcefile_Rewind(struct audiosource* source) {
+    struct audiosourcefile_internaldata* idata = source->internaldata;
+    idata->eof = 0;
+    idata->pos = 0;
+#ifdef USE_MMAP
+    if (idata->mapping) {
+        return;
+    }
+#endif
+    // Close the file. it will be reopened on next read
+    audiosourcefile_CloseFile(idata);
+}
+
 
 static int audiosourcefile_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
     struct audiosourcefile_internaldata* idata = source->internaldata;
 
-    if (idata->file == NULL) {
+#ifdef USE_MMAP
+    if (idata->mapping) {
+        // just copy from the mapped file
         if (idata->eof) {
             return -1;
         }
-#ifdef SDLRW
-        idata->file = SDL_RWFromFile(idata->path, "rb");
-#else
-        idata->file = fopen(idata->path,"rb");
+        size_t left = idata->length - idata->pos;
+        if (bytes > left) {
+            bytes = left;
+        }
+        if (bytes == 0) {
+            idata->eof = 1;
+            return 0;
+        }
+        memcpy(buffer, idata->mapping + idata->pos, bytes);
+        idata->pos += bytes;
+        return bytes;
+    }
 #endif
-        if (!idata->file) {
-            idata->file = NULL;
+
+    if (idata->file == NULL) {
+        if (idata->eof) {
+            return -1;
+        }
+        if (!audiosourcefile_Open(idata)) {
             return -1;
         }
     }
@@ -82,14 +161,10 @@ static int audiosourcefile_Read(struct audiosource* source, char* buffer, unsign
     int bytesread = fread(buffer, 1, bytes, idata->file);
 #endif
     if (bytesread > 0) {
+        idata->pos += bytesread;
         return bytesread;
     }else{
-#ifdef SDLRW
-        idata->file->close(idata->file);
-#else
-        fclose(idata->file);
-#endif
-        idata->file = NULL;
+        audiosourcefile_CloseFile(idata);
         idata->eof = 1;
         if (bytesread < 0) {
             return -1;
@@ -102,17 +177,28 @@ static int audiosourcefile_Read(struct audiosource* source, char* buffer, unsign
 static int audiosourcefile_Seek(struct audiosource* source, size_t pos) {
     struct audiosourcefile_internaldata* idata = source->internaldata;
 
+    // we need the file opened to seek in it:
+    if (!audiosourcefile_Open(idata)) {
+        return 0;
+    }
+
     // don't allow seeking beyond end of file:
-    size_t length = source->length(source);
-    if (pos > length) {
-        pos = length;
+    if (pos > idata->length) {
+        pos = idata->length;
     }
 
     // seek:
-    fseek(idata->file, pos, SEEK_SET);
+    if (idata->file) {
+#ifdef SDLRW
+        idata->file->seek(idata->file, pos, RW_SEEK_SET);
+#else
+        fseek(idata->file, pos, SEEK_SET);
+#endif
+    }
+    idata->pos = pos;
 
     // update our own eof marker:
-    if (pos < length) {
+    if (pos < idata->length) {
         idata->eof = 0;
     } else {
         idata->eof = 1;
@@ -122,40 +208,31 @@ static int audiosourcefile_Seek(struct audiosource* source, size_t pos) {
 
 static size_t audiosourcefile_Length(struct audiosource* source) {
     struct audiosourcefile_internaldata* idata = source->internaldata;
-
-    // remember current pos:
-    long pos = ftell(idata->file);
-
-    // seek to end of file to get length:
-    fseek(idata->file, 0L, SEEK_END);
-    size_t size = ftell(idata->file);
-
-    // seek back to current pos:
-    fseek(idata->file, pos, SEEK_SET);
-    return size;
+    // the file is closed at the end or after a rewind, but reopening it
+    // would reset the read position. the size is still known from the
+    // first time it was opened:
+    if (!idata->lengthknown && !audiosourcefile_Open(idata)) {
+        return 0;
+    }
+    return idata->length;
 }
 
 static size_t audiosourcefile_Position(struct audiosource* source) {
     struct audiosourcefile_internaldata* idata = source->internaldata;
     if (idata->eof) {
-        return source->length(source);
+        return idata->length;
     }
-    long pos = ftell(idata->file);
-    return pos;
+    return idata->pos;
 }
 
 static void audiosourcefile_Close(struct audiosource* source) {
     struct audiosourcefile_internaldata* idata = source->internaldata;
     if (idata) {
         // close file we might have opened
-#ifdef SDLRW
-        if (idata->file) {
-            idata->file->close(idata->file);
-        }
-#else
-        FILE* r = idata->file;
-        if (r) {
-            fclose(r);
+        audiosourcefile_CloseFile(idata);
+#ifdef USE_MMAP
+        if (idata->mapping) {
+            munmap((void*)idata->mapping, idata->length);
         }
 #endif
         // free all structs & strings
@@ -167,6 +244,44 @@ static void audiosourcefile_Close(struct audiosource* source) {
     free(source);
 }
 
+#ifdef USE_MMAP
+static void audiosourcefile_Map(struct audiosourcefile_internaldata* idata) {
+    // Try to memory-map the file. If this doesn't work out,
+    // we will simply use stdio instead.
+    int fd = open(idata->path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+    info.st_size <= 0) {
+        close(fd);
+        return;
+    }
+    void* mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+    // we mostly read front to back:
+    madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    idata->mapping = mapping;
+    idata->length = info.st_size;
+    idata->lengthknown = 1;
+    idata->pos = 0;
+}
+#endif
+
+int audiosourcefile_IsMemoryMapped(struct audiosource* source) {
+#ifdef USE_MMAP
+    struct audiosourcefile_internaldata* idata = source->internaldata;
+    if (idata->mapping) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
 struct audiosource* audiosourcefile_Create(const char* path) {
     struct audiosource* a = malloc(sizeof(*a));
     if (!a) {
@@ -188,6 +303,9 @@ struct audiosource* audiosourcefile_Create(const char* path) {
         free(a);
         return NULL;
     }
+#ifdef USE_MMAP
+    audiosourcefile_Map(idata);
+#endif
 
     a->read = &audiosourcefile_Read;
     a->close = &audiosourcefile_Close;
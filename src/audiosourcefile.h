@@ -26,4 +26,11 @@ struct audiosource* audiosourcefile_Create(const char* path);
 // Please note this doesn't do any decoding or processing!
 // It just returns the binary data in that file as it is.
 // Pass into audiosourceogg or others to make them decode it.
+// Where possible (Unix), the file is memory-mapped. Otherwise, it is
+// read using stdio (or SDL_RWops on Android).
+
+int audiosourcefile_IsMemoryMapped(struct audiosource* source);
+// Returns 1 if the file source reads from a memory-mapped file
+// (which makes an additional cache in front of it unnecessary),
+// 0 if not.
 
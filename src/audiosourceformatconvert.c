@@ -26,12 +26,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
 
 #include "audiosource.h"
 #include "audiosourceformatconvert.h"
-#include "mathhelpers.h"
+#include "audioconvertkernel.h"
 
 #define CONVERTBUFSIZE 32
+// source bytes converted at once when the target format is smaller
+// (larger or same size targets are converted in place in the read buffer):
+#define CONVERTBLOCKSIZE 4096
 
 struct audiosourceformatconvert_internaldata {
     struct audiosource* source; // internal audio source for format conversion
@@ -39,8 +43,12 @@ struct audiosourceformatconvert_internaldata {
     int erroroneof; // error when eof is reached
     int eof;
     int targetformat;
+    unsigned int sourcesamplesize;
+    unsigned int targetsamplesize;
+    audioconvertkernel_func convert;
     char convertbuf[CONVERTBUFSIZE];
     int convertbufbytes;
+    char block[CONVERTBLOCKSIZE];
 };
 
 static void audiosourceformatconvert_Close(struct audiosource* source) {
@@ -68,6 +76,29 @@ static void audiosourceformatconvert_Rewind(struct audiosource* source) {
 }
 
 
+static int audiosourceformatconvert_ReadSource(
+struct audiosourceformatconvert_internaldata* idata,
+char* buffer, unsigned int bytes) {
+    // Read until we got all requested bytes or the source ends,
+    // so we only ever need to deal with partial samples at the end:
+    unsigned int got = 0;
+    while (got < bytes && !idata->sourceeof) {
+        int result = idata->source->read(idata->source, buffer + got,
+        bytes - got);
+        if (result < 0) {
+            idata->erroroneof = 1;
+            idata->eof = 1;
+            return -1;
+        }
+        if (result == 0) {
+            idata->sourceeof = 1;
+            break;
+        }
+        got += result;
+    }
+    return got;
+}
+
 static int audiosourceformatconvert_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
     struct audiosourceformatconvert_internaldata* idata = (struct audiosourceformatconvert_internaldata*)source->internaldata;
 
@@ -99,181 +130,61 @@ static int audiosourceformatconvert_Read(struct audiosource* source, char* buffe
         }
     }
 
-    // fetch new bytes and return them
-    while (bytes > 0) {
-        if (idata->sourceeof) {
-            break;
-        }
-
-        // check how many bytes we want:
-        int wantbytes = 0;
-        if (idata->source->format == AUDIOSOURCEFORMAT_S16LE) {
-            wantbytes = 2;
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_F32LE) {
-            wantbytes = 4;
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_U8) {
-            wantbytes = 1;
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_S32LE) {
-            wantbytes = 4;
+    unsigned int sourcesize = idata->sourcesamplesize;
+    unsigned int targetsize = idata->targetsamplesize;
+
+    // convert as many whole samples as requested straight into the buffer:
+    unsigned int samples = bytes / targetsize;
+    if (samples > 0 && targetsize >= sourcesize) {
+        // read the source samples into the end of the target area and
+        // convert them in place front to back:
+        char* sourcedata = buffer + samples * (targetsize - sourcesize);
+        int result = audiosourceformatconvert_ReadSource(idata, sourcedata,
+        samples * sourcesize);
+        if (result < 0) {
+            return -1;
         }
-
-        char bytebuf[8];
-        // read the bytes we want:
-        int result = idata->source->read(idata->source, bytebuf, wantbytes);
-        if (result < wantbytes) {
+        samples = result / sourcesize;
+        idata->convert(buffer, sourcedata, samples);
+        writtenbytes += samples * targetsize;
+        buffer += samples * targetsize;
+        bytes -= samples * targetsize;
+    }else{
+        // the source data doesn't fit, so go through our block buffer:
+        while (samples > 0 && !idata->sourceeof) {
+            unsigned int amount = samples;
+            if (amount > CONVERTBLOCKSIZE / sourcesize) {
+                amount = CONVERTBLOCKSIZE / sourcesize;
+            }
+            int result = audiosourceformatconvert_ReadSource(idata,
+            idata->block, amount * sourcesize);
             if (result < 0) {
-                idata->erroroneof = 1;
-                idata->eof = 1;
                 return -1;
-            }else{
-                idata->sourceeof = 1;
-                break;
-            }
-        }
-
-        // convert:
-        if (idata->source->format == AUDIOSOURCEFORMAT_S16LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-#define S16TOF32TYPE double
-                S16TOF32TYPE intmax_big = pow(2, 16)/2;
-                // convert s16le -> f32le
-                int16_t old = *((int16_t*)bytebuf);
-                S16TOF32TYPE convert = old;
-                convert /= intmax_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_F32LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                double intmax_small = pow(2, 16)/2;
-                // convert f32le -> s16le
-                float old = *((float*)bytebuf);
-                double convert = old;
-                convert *= intmax_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_U8) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                double uint8max_big = 256;
-                double int16max_small = 32767;
-                // convert u8 -> s16le
-                unsigned char old = *((unsigned char*)bytebuf);
-                double convert = old;
-                convert /= uint8max_big;
-                convert *= int16max_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-                double uint8max_big = pow(2, 8);
-                // convert u8 -> s16le
-                unsigned char old = *((unsigned char*)bytebuf);
-                double convert = old;
-                convert /= uint8max_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_S24LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                // FIXME: depends on large endian cpu architecture
-                double int24max_big = pow(2, 24)/2;
-                double int16max_small = 32767;
-                // convert s24le -> s16le
-                int32_t old;
-                memset((((char*)&old)+3), 0, 1);  // null last byte
-                memcpy(&old, (char*)bytebuf, 3);  // copy first 3 bytes (=24 bit)
-                double convert = old;
-                convert /= int24max_big;
-                convert *= int16max_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-                // FIXME: depends on large endian cpu architecture
-                double int24max_big = pow(2, 24)/2;
-                // convert s24le -> s16le
-                int32_t old;
-                memset((((char*)&old)+3), 0, 1);  // null last byte (most significant)
-                memcpy(&old, (char*)bytebuf, 3);  // copy first 3 bytes (=24 bit)
-                double convert = old;
-                convert /= int24max_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-        }
-        if (idata->source->format == AUDIOSOURCEFORMAT_S32LE) {
-            if (idata->targetformat == AUDIOSOURCEFORMAT_S16LE) {
-                double int32max_big = pow(2, 32)/2;
-                double int16max_small = 32767;
-                // convert s32le -> s16le
-                int32_t old = *((int32_t*)bytebuf);
-                double convert = old;
-                convert /= int32max_big;
-                convert *= int16max_small;
-                int16_t new = (int16_t)fastdoubletoint32(convert);
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
-            }
-            if (idata->targetformat == AUDIOSOURCEFORMAT_F32LE) {
-                double int32max_big = pow(2, 32)/2;
-                // convert s32le -> s16le
-                int32_t old = *((int32_t*)bytebuf);
-                double convert = old;
-                convert /= int32max_big;
-                float new = convert;
-
-                // copy the result into our buffer
-                memcpy(idata->convertbuf, &new, sizeof(new));
-                idata->convertbufbytes += sizeof(new);
             }
+            amount = result / sourcesize;
+            idata->convert(buffer, idata->block, amount);
+            writtenbytes += amount * targetsize;
+            buffer += amount * targetsize;
+            bytes -= amount * targetsize;
+            samples -= amount;
         }
+    }
 
-        // return converted bytes;
-        unsigned int amount = idata->convertbufbytes;
-        if (amount > bytes) {
-            amount = bytes;
+    // if a partial sample was requested, convert one more sample and
+    // keep the bytes of it which didn't fit for the next read:
+    if (bytes > 0 && bytes < targetsize && !idata->sourceeof) {
+        int result = audiosourceformatconvert_ReadSource(idata,
+        idata->block, sourcesize);
+        if (result < 0) {
+            return -1;
         }
-        memcpy(buffer, idata->convertbuf, amount);
-        writtenbytes += amount;
-        buffer += amount;
-        bytes -= amount;
-        idata->convertbufbytes -= amount;
-        // we served all requested bytes:
-        if (bytes == 0) {
-            // are some bytes left in buffer?
-            if (idata->convertbufbytes > 0) {
-                // move them up to the beginning
-                memmove(idata->convertbuf, idata->convertbuf + amount, idata->convertbufbytes);
-            }
-            // all requested bytes served:
-            break;
+        if ((unsigned int)result == sourcesize) {
+            idata->convert(idata->convertbuf, idata->block, 1);
+            memcpy(buffer, idata->convertbuf, bytes);
+            writtenbytes += bytes;
+            idata->convertbufbytes = targetsize - bytes;
+            memmove(idata->convertbuf, idata->convertbuf + bytes,
+            idata->convertbufbytes);
         }
     }
 
@@ -340,11 +251,10 @@ struct audiosource* audiosourceformatconvert_Create(struct audiosource* source,
         return source;
     }
 
-    // whitelist of supported formats:
-    if (
-    newformat != AUDIOSOURCEFORMAT_S16LE &&
-    newformat != AUDIOSOURCEFORMAT_F32LE &&
-    1) {
+    // only formats we have a conversion kernel for are supported:
+    audioconvertkernel_func convert = audioconvertkernel_Get(source->format,
+    newformat);
+    if (!convert) {
         source->close(source);
         return NULL;
     }
@@ -370,6 +280,9 @@ struct audiosource* audiosourceformatconvert_Create(struct audiosource* source,
     // Remember some internal info:
     idata->source = source;
     idata->targetformat = newformat;
+    idata->convert = convert;
+    idata->sourcesamplesize = audioconvertkernel_SampleSize(source->format);
+    idata->targetsamplesize = audioconvertkernel_SampleSize(newformat);
     a->format = newformat;
     a->channels = source->channels;
     a->samplerate = source->samplerate;
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "os.h"
 #include "audiosource.h"
@@ -36,6 +37,14 @@ struct audiosourceloop_internaldata {
     int returnerroroneof;
 
     int looping;
+
+    // loop points in bytes (loop end 0: loop at the end of the source):
+    unsigned int framebytes;
+    uint64_t loopstartbytes;
+    uint64_t loopendbytes;
+
+    // our position in bytes, to know when we reach the loop end:
+    uint64_t posbytes;
 };
 
 void audiosourceloop_SetLooping(struct audiosource* source, int looping) {
@@ -43,12 +52,52 @@ void audiosourceloop_SetLooping(struct audiosource* source, int looping) {
     idata->looping = looping;
 }
 
+void audiosourceloop_SetLoopPoints(struct audiosource* source, size_t loopstart, size_t looplength) {
+    struct audiosourceloop_internaldata* idata = source->internaldata;
+    idata->loopstartbytes = (uint64_t)loopstart * idata->framebytes;
+    idata->loopendbytes = 0;
+    if (looplength > 0) {
+        idata->loopendbytes = idata->loopstartbytes +
+        (uint64_t)looplength * idata->framebytes;
+    }
+}
+
+static int audiosourceloop_JumpToLoopStart(struct audiosourceloop_internaldata* idata) {
+    idata->sourceeof = 0;
+    size_t loopstart = idata->loopstartbytes / idata->framebytes;
+
+    // seek if we can, which is much cheaper than a rewind (no reopening
+    // of files, no resetting of decoders):
+    if (idata->source->seekable && idata->source->seek(idata->source, loopstart)) {
+        idata->posbytes = idata->loopstartbytes;
+        return 1;
+    }
+
+    // rewind and skip up to the loop start:
+    idata->source->rewind(idata->source);
+    idata->posbytes = 0;
+    char skipbuf[4096];
+    while (idata->posbytes < idata->loopstartbytes) {
+        unsigned int skip = sizeof(skipbuf);
+        if (skip > idata->loopstartbytes - idata->posbytes) {
+            skip = idata->loopstartbytes - idata->posbytes;
+        }
+        int i = idata->source->read(idata->source, skipbuf, skip);
+        if (i <= 0) {
+            return 0;
+        }
+        idata->posbytes += i;
+    }
+    return 1;
+}
+
 static void audiosourceloop_Rewind(struct audiosource* source) {
     struct audiosourceloop_internaldata* idata = source->internaldata;
     // if we aren't looping, we offer a rewind:
     if (!idata->looping) {
         idata->source->rewind(idata->source);
         idata->sourceeof = 0;
+        idata->posbytes = 0;
     }
     return;
 }
@@ -62,19 +111,35 @@ static int audiosourceloop_Read(struct audiosource* source, char* buffer, unsign
     int rewinded = 0; // avoid endless rewind loops for empty sources
     unsigned int byteswritten = 0;
     while (bytes > 0) {
+        // don't read past the loop end:
+        unsigned int readbytes = bytes;
+        if (idata->looping && idata->loopendbytes > 0 && !idata->sourceeof) {
+            if (idata->posbytes >= idata->loopendbytes) {
+                if (!audiosourceloop_JumpToLoopStart(idata)) {
+                    idata->sourceeof = 1;
+                }
+                continue;
+            }
+            if (readbytes > idata->loopendbytes - idata->posbytes) {
+                readbytes = idata->loopendbytes - idata->posbytes;
+            }
+        }
+
         int i = 0;
         if (!idata->sourceeof) {
-            i = idata->source->read(idata->source, buffer, bytes);
+            i = idata->source->read(idata->source, buffer, readbytes);
             if (i == 0 && idata->looping == 1 && !rewinded) {
-                // we reached EOF. -> rewind
+                // we reached EOF. -> go back to the loop start
                 rewinded = 1;
-                idata->sourceeof = 0;
-                idata->source->rewind(idata->source);
+                if (!audiosourceloop_JumpToLoopStart(idata)) {
+                    idata->sourceeof = 1;
+                }
                 continue;
             }
         }
         if (i > 0) {
             // we got bytes from our audio source. return them:
+            idata->posbytes += i;
             byteswritten += i;
             buffer += i;
             bytes -= i;
@@ -134,6 +199,8 @@ static int audiosourceloop_Seek(struct audiosource* source, size_t pos) {
     if (idata->source->seekable) {
         if (idata->source->seek(idata->source, pos)) {
             idata->eof = 0;
+            idata->sourceeof = 0;
+            idata->posbytes = (uint64_t)pos * idata->framebytes;
             return 1;
         }
     }
@@ -187,6 +254,16 @@ struct audiosource* audiosourceloop_Create(struct audiosource* source) {
     idata->source = source;
     a->samplerate = source->samplerate;
     a->channels = source->channels;
+    a->format = source->format;
+
+    // we count our position in frames for the loop points:
+    idata->framebytes = sizeof(float) * 2;
+    if (source->format == AUDIOSOURCEFORMAT_S16LE) {
+        idata->framebytes = sizeof(int16_t) * 2;
+    }
+    if (source->seekable && source->position) {
+        idata->posbytes = (uint64_t)source->position(source) * idata->framebytes;
+    }
 
     // function pointers
     a->read = &audiosourceloop_Read;
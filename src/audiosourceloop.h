@@ -22,4 +22,10 @@
 */
 
 void audiosourceloop_SetLooping(struct audiosource* source, int looping);
+
+// Loop from the given loop start frame for the given amount of frames
+// (0: to the end) instead of the whole source, e.g. for music with an
+// intro. Loops seek back if the source is seekable:
+void audiosourceloop_SetLoopPoints(struct audiosource* source, size_t loopstart, size_t looplength);
+
 struct audiosource* audiosourceloop_Create(struct audiosource* source);
@@ -0,0 +1,148 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "os.h"
+#include "audiosource.h"
+#include "audiosourcememory.h"
+
+struct audiosourcememory_internaldata {
+    const char* data;
+    unsigned int bytes;
+    unsigned int pos;
+    unsigned int samplebytes;  // bytes of one sample for all channels
+
+    void (*release)(void* userdata);
+    void* userdata;
+};
+
+static void audiosourcememory_Rewind(struct audiosource* source) {
+    struct audiosourcememory_internaldata* idata = source->internaldata;
+    idata->pos = 0;
+}
+
+static int audiosourcememory_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
+    struct audiosourcememory_internaldata* idata = source->internaldata;
+    if (bytes > idata->bytes - idata->pos) {
+        bytes = idata->bytes - idata->pos;
+    }
+    memcpy(buffer, idata->data + idata->pos, bytes);
+    idata->pos += bytes;
+    return bytes;
+}
+
+static int audiosourcememory_Seek(struct audiosource* source, size_t pos) {
+    struct audiosourcememory_internaldata* idata = source->internaldata;
+    if (pos > idata->bytes / idata->samplebytes) {
+        pos = idata->bytes / idata->samplebytes;
+    }
+    idata->pos = pos * idata->samplebytes;
+    return 1;
+}
+
+static size_t audiosourcememory_Position(struct audiosource* source) {
+    struct audiosourcememory_internaldata* idata = source->internaldata;
+    return idata->pos / idata->samplebytes;
+}
+
+static size_t audiosourcememory_Length(struct audiosource* source) {
+    struct audiosourcememory_internaldata* idata = source->internaldata;
+    return idata->bytes / idata->samplebytes;
+}
+
+static void audiosourcememory_Close(struct audiosource* source) {
+    struct audiosourcememory_internaldata* idata = source->internaldata;
+    if (idata) {
+        // tell the owner of the data we are done with it
+        if (idata->release) {
+            idata->release(idata->userdata);
+        }
+        free(idata);
+    }
+    free(source);
+}
+
+struct audiosource* audiosourcememory_Create(const char* data,
+unsigned int bytes, unsigned int samplerate, unsigned int channels,
+unsigned int format, void (*release)(void* userdata), void* userdata) {
+    unsigned int samplebytes = 0;
+    switch (format) {
+    case AUDIOSOURCEFORMAT_U8:
+        samplebytes = 1;
+        break;
+    case AUDIOSOURCEFORMAT_S16LE:
+        samplebytes = 2;
+        break;
+    case AUDIOSOURCEFORMAT_S24LE:
+        samplebytes = 3;
+        break;
+    case AUDIOSOURCEFORMAT_F32LE:
+    case AUDIOSOURCEFORMAT_S32LE:
+        samplebytes = 4;
+        break;
+    default:
+        return NULL;
+    }
+    if (channels <= 0) {
+        return NULL;
+    }
+
+    // allocate visible data struct
+    struct audiosource* a = malloc(sizeof(*a));
+    if (!a) {
+        return NULL;
+    }
+
+    // allocate internal data struct
+    memset(a,0,sizeof(*a));
+    a->internaldata = malloc(sizeof(struct audiosourcememory_internaldata));
+    if (!a->internaldata) {
+        free(a);
+        return NULL;
+    }
+
+    // remember various things
+    struct audiosourcememory_internaldata* idata = a->internaldata;
+    memset(idata, 0, sizeof(*idata));
+    idata->data = data;
+    idata->samplebytes = samplebytes * channels;
+    idata->bytes = bytes - (bytes % idata->samplebytes);
+    idata->release = release;
+    idata->userdata = userdata;
+    a->samplerate = samplerate;
+    a->channels = channels;
+    a->format = format;
+
+    // function pointers
+    a->read = &audiosourcememory_Read;
+    a->close = &audiosourcememory_Close;
+    a->rewind = &audiosourcememory_Rewind;
+    a->position = &audiosourcememory_Position;
+    a->length = &audiosourcememory_Length;
+    a->seek = &audiosourcememory_Seek;
+    a->seekable = 1;
+
+    return a;
+}
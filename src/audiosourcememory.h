@@ -0,0 +1,32 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+struct audiosource* audiosourcememory_Create(const char* data,
+unsigned int bytes, unsigned int samplerate, unsigned int channels,
+unsigned int format, void (*release)(void* userdata), void* userdata);
+// Create an audio source which plays back already decoded samples
+// from memory. The data is NOT copied, so it needs to stay valid until
+// the audio source is closed. When it is closed, release is called
+// with the given userdata (unless release is NULL) to signal that the
+// data is no longer in use.
+// Returns NULL if out of memory (release is not called in that case).
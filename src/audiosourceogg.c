@@ -31,6 +31,11 @@
 
 #include "audiosource.h"
 #include "audiosourceogg.h"
+#include "oggpageindex.h"
+
+// Index based seeking decodes at most this many seconds to reach the
+// target, otherwise regular bisection seeking is used:
+#define MAXSEEKDECODESECONDS 2
 
 struct audiosourceogg_internaldata {
     // our source of to-be-decoded data:
@@ -55,11 +60,29 @@ struct audiosourceogg_internaldata {
     OggVorbis_File vorbisfile;
     int vbitstream; // required by libvorbisfile internally
     int vorbiseof;
+
+    // page index for fast seeking (NULL if not used):
+    struct oggpageindex* pageindex;
 };
 
+static void audiosourceogg_ResetDecoded(
+struct audiosourceogg_internaldata* idata) {
+    // forget about decoded data after the decoder position changed
+    idata->decodedbytes = 0;
+    idata->vorbiseof = 0;
+    idata->eof = 0;
+}
+
 static void audiosourceogg_Rewind(struct audiosource* source) {
     struct audiosourceogg_internaldata* idata = source->internaldata;
     if (!idata->eof || !idata->returnerroroneof) {
+        // seek back if we can, which is much cheaper than reopening:
+        if (source->seekable && idata->vorbisopened &&
+        ov_pcm_seek(&idata->vorbisfile, 0) == 0) {
+            audiosourceogg_ResetDecoded(idata);
+            return;
+        }
+
         // close vorbis decoder:
         if (idata->vorbisopened) {
             ov_clear(&idata->vorbisfile);
@@ -149,6 +172,41 @@ static size_t vorbismemoryreader(void *ptr, size_t size, size_t nmemb, void *dat
     return writtenchunks;
 }
 
+// position reporter for libvorbisfile:
+static long vorbismemorytell(void *datasource) {
+    struct audiosourceogg_internaldata* idata = datasource;
+
+    // what we fetched but didn't hand out yet doesn't count:
+    return (long)(idata->filesource->position(idata->filesource) -
+    idata->fetchedbytes);
+}
+
+// seeking for libvorbisfile:
+static int vorbismemoryseek(void *datasource, ogg_int64_t offset, int whence) {
+    struct audiosourceogg_internaldata* idata = datasource;
+    struct audiosource* filesource = idata->filesource;
+
+    ogg_int64_t pos = offset;
+    if (whence == SEEK_CUR) {
+        pos += vorbismemorytell(datasource);
+    }else if (whence == SEEK_END) {
+        size_t length = filesource->length(filesource);
+        if (length == 0) {
+            return -1;
+        }
+        pos += length;
+    }
+    if (pos < 0 || !filesource->seek(filesource, (size_t)pos)) {
+        return -1;
+    }
+
+    // drop the fetched data of the old position:
+    idata->fetchedbytes = 0;
+    idata->fetchedbufreadoffset = 0;
+    idata->filesourceeof = 0;
+    return 0;
+}
+
 static int audiosourceogg_InitOgg(struct audiosource* source) {
     struct audiosourceogg_internaldata* idata = source->internaldata;
     if (idata->vorbisopened) {
@@ -158,6 +216,11 @@ static int audiosourceogg_InitOgg(struct audiosource* source) {
     ov_callbacks callbacks;
     memset(&callbacks, 0, sizeof(callbacks));
     callbacks.read_func = &vorbismemoryreader;
+    if (idata->filesource->seekable) {
+        // allows libvorbisfile to find out the length and to seek:
+        callbacks.seek_func = &vorbismemoryseek;
+        callbacks.tell_func = &vorbismemorytell;
+    }
 
     int v = ov_open_callbacks(idata, &idata->vorbisfile, NULL, 0, callbacks);
     if (v != 0) {
@@ -306,9 +369,144 @@ static int audiosourceogg_Read(struct audiosource* source, char* buffer, unsigne
     return byteswritten;
 }
 
+static int audiosourceogg_IndexedSeek(struct audiosource* source, size_t pos) {
+    struct audiosourceogg_internaldata* idata = source->internaldata;
+
+    // jump to a page before the target position. The exact position
+    // of the page's first sample is only known after jumping, so step
+    // back another page if we ended up too far:
+    int64_t granule = pos;
+    ogg_int64_t current = -1;
+    int tries = 0;
+    while (tries < 4) {
+        int64_t offset;
+        if (!oggpageindex_Lookup(idata->pageindex, granule, &offset,
+        &granule)) {
+            return 0;
+        }
+        if (ov_raw_seek(&idata->vorbisfile, offset) != 0) {
+            return 0;
+        }
+        current = ov_pcm_tell(&idata->vorbisfile);
+        if (current >= 0 && current <= (ogg_int64_t)pos) {
+            break;
+        }
+        tries++;
+    }
+    if (current < 0 || current > (ogg_int64_t)pos ||
+    (ogg_int64_t)pos - current > (ogg_int64_t)source->samplerate *
+    MAXSEEKDECODESECONDS) {
+        return 0;
+    }
+
+    // decode up to the exact position:
+    while (current < (ogg_int64_t)pos) {
+        float **pcm;
+        int want = 4096;
+        if ((ogg_int64_t)want > (ogg_int64_t)pos - current) {
+            want = (int)((ogg_int64_t)pos - current);
+        }
+        long ret = ov_read_float(&idata->vorbisfile, &pcm, want,
+        &idata->vbitstream);
+        if (ret == OV_HOLE) {
+            continue;
+        }
+        if (ret <= 0) {
+            return 0;
+        }
+        current += ret;
+    }
+    return 1;
+}
+
+static int audiosourceogg_Seek(struct audiosource* source, size_t pos) {
+    struct audiosourceogg_internaldata* idata = source->internaldata;
+    if (!source->seekable || !idata->vorbisopened ||
+    (idata->eof && idata->returnerroroneof)) {
+        return 0;
+    }
+
+    // use the page index if we have one, otherwise (or if that fails)
+    // libvorbisfile bisects through the file:
+    if (!idata->pageindex || !audiosourceogg_IndexedSeek(source, pos)) {
+        if (ov_pcm_seek(&idata->vorbisfile, pos) != 0) {
+            return 0;
+        }
+    }
+    audiosourceogg_ResetDecoded(idata);
+    return 1;
+}
+
+static size_t audiosourceogg_Position(struct audiosource* source) {
+    struct audiosourceogg_internaldata* idata = source->internaldata;
+    if (!idata->vorbisopened) {
+        return 0;
+    }
+    ogg_int64_t pos = ov_pcm_tell(&idata->vorbisfile);
+    if (pos < 0) {
+        return 0;
+    }
+
+    // we are behind the decoder by what is still buffered:
+    ogg_int64_t buffered = idata->decodedbytes /
+    (source->channels * sizeof(float));
+    if (buffered > pos) {
+        return 0;
+    }
+    return (size_t)(pos - buffered);
+}
+
+static size_t audiosourceogg_Length(struct audiosource* source) {
+    struct audiosourceogg_internaldata* idata = source->internaldata;
+    if (!source->seekable || !idata->vorbisopened) {
+        return 0;
+    }
+    ogg_int64_t length = ov_pcm_total(&idata->vorbisfile, -1);
+    if (length < 0) {
+        return 0;
+    }
+    return (size_t)length;
+}
+
+void audiosourceogg_UsePageIndex(struct audiosource* source, const char* path) {
+    struct audiosourceogg_internaldata* idata = source->internaldata;
+    if (!source->seekable || idata->pageindex) {
+        return;
+    }
+    idata->pageindex = oggpageindex_Get(path);
+}
+
+int audiosourceogg_GetLoopPoints(struct audiosource* source, size_t* loopstart, size_t* looplength) {
+    struct audiosourceogg_internaldata* idata = source->internaldata;
+    if (!idata->vorbisopened) {
+        return 0;
+    }
+    vorbis_comment* vc = ov_comment(&idata->vorbisfile, -1);
+    if (!vc) {
+        return 0;
+    }
+    // (tag names are compared case-insensitively)
+    const char* start = vorbis_comment_query(vc, "LOOPSTART", 0);
+    if (!start) {
+        return 0;
+    }
+    *loopstart = strtoul(start, NULL, 10);
+    *looplength = 0;
+    const char* length = vorbis_comment_query(vc, "LOOPLENGTH", 0);
+    if (length) {
+        *looplength = strtoul(length, NULL, 10);
+    }
+    return 1;
+}
+
 static void audiosourceogg_Close(struct audiosource* source) {
     struct audiosourceogg_internaldata* idata = source->internaldata;
     if (idata) {
+        // give up our page index
+        if (idata->pageindex) {
+            oggpageindex_Release(idata->pageindex);
+        }
+
         // close ogg file if we have it open
         if (idata->vorbisopened) {
             ov_clear(&idata->vorbisfile);
@@ -357,6 +555,9 @@ struct audiosource* audiosourceogg_Create(struct audiosource* filesource) {
     a->read = &audiosourceogg_Read;
     a->close = &audiosourceogg_Close;
     a->rewind = &audiosourceogg_Rewind;
+    a->seek = &audiosourceogg_Seek;
+    a->position = &audiosourceogg_Position;
+    a->length = &audiosourceogg_Length;
 
     // ensure proper initialisation of sample rate + channels variables
     audiosourceogg_Read(a, NULL, 0);
@@ -366,6 +567,9 @@ struct audiosource* audiosourceogg_Create(struct audiosource* filesource) {
         return NULL;
     }
 
+    // we can seek if libvorbisfile can seek in the file:
+    a->seekable = (ov_seekable(&idata->vorbisfile) != 0);
+
     return a;
 }
 
@@ -25,4 +25,15 @@ struct audiosource* audiosourceogg_Create(struct audiosource* filesource);
 // Take an audio source that returns encoded binary data (usually
 // audiosourcefile) and attempt to decode the data as ogg.
 // If the file isn't valid ogg, the creation function will simply return NULL.
-
+// Seeking, position and length are supported if the file source
+// is seekable.
+
+int audiosourceogg_GetLoopPoints(struct audiosource* source, size_t* loopstart, size_t* looplength);
+// Get the loop points from the LOOPSTART and LOOPLENGTH comments of
+// the file (in frames of the file's sample rate, length 0 if only the
+// loop start is given). Returns 0 if the file has no loop points.
+
+void audiosourceogg_UsePageIndex(struct audiosource* source, const char* path);
+// Use a page index of the given file (the one the ogg source decodes)
+// for faster seeking. The index is built in the background, seeking
+// falls back to bisecting through the file until it is complete.
@@ -27,23 +27,163 @@
 #include "os.h"
 #include "audiosource.h"
 #include "audiosourceprereadcache.h"
+#include "audioworkerpool.h"
+#include "threading.h"
 
+#ifdef NOTHREADEDSDLRW
+// reading files needs to happen on the main/audio thread:
+#define NOBACKGROUNDREAD
+#endif
+
+// how much we read from the source at once:
+#define PREREADCHUNKSIZE (1024 * 16)
+
+// The cache is a ring buffer with free-running read and write positions.
+// The write side is either the audio thread itself (synchronous mode)
+// or a worker thread from the shared audio worker pool which keeps the
+// ring filled (background mode). In background mode, sourcelock
+// protects all access to the source.
 struct audiosourceprereadcache_internaldata {
     struct audiosource* source;
-    unsigned int prereadcachesize;
-    char* prereadcache;
-    unsigned int prereadcachebytes;
+    char* ring;
+    unsigned int ringsize;  // power of two
+    unsigned int readpos;  // only advanced by the reading (audio) thread
+    unsigned int writepos;  // only advanced by the filling side
+    int sourceeof;  // set by the filling side
+    int sourceerror;  // set by the filling side
     int eof;
-    int sourceeof;
-    char* path;
+
+    // background read-ahead:
+    int backgroundread;
+    mutex* sourcelock;
+    struct audioworkerjob refilljob;
+    int wakeuppending;  // refilljob is queued
+    int closing;
+    unsigned int underruns;  // reads which found the ring empty
+    int refcount;  // held by the audio source and a queued refilljob
 };
 
+// see audiosourceprereadcache_SetWaitForSource:
+static int waitforsource = 0;
+
+static unsigned int audiosourceprereadcache_Available(
+struct audiosourceprereadcache_internaldata* idata) {
+    return __atomic_load_n(&idata->writepos, __ATOMIC_ACQUIRE) -
+    idata->readpos;
+}
+
+static void audiosourceprereadcache_Fill(
+struct audiosourceprereadcache_internaldata* idata, unsigned int target) {
+    // Read from the source until at least target bytes are cached
+    // (or the ring is full, or the source has ended).
+    // Needs sourcelock in background mode.
+    while (!__atomic_load_n(&idata->sourceeof, __ATOMIC_RELAXED)) {
+        unsigned int readpos = __atomic_load_n(&idata->readpos,
+        __ATOMIC_ACQUIRE);
+        unsigned int cached = idata->writepos - readpos;
+        if (cached >= target || cached >= idata->ringsize) {
+            return;
+        }
+
+        // read into the contiguous free part of the ring:
+        unsigned int offset = idata->writepos & (idata->ringsize - 1);
+        unsigned int amount = idata->ringsize - cached;
+        if (amount > idata->ringsize - offset) {
+            amount = idata->ringsize - offset;
+        }
+        if (amount > PREREADCHUNKSIZE) {
+            amount = PREREADCHUNKSIZE;
+        }
+        int i = idata->source->read(idata->source, idata->ring + offset,
+        amount);
+        if (i > 0) {
+            __atomic_store_n(&idata->writepos, idata->writepos + i,
+            __ATOMIC_RELEASE);
+        }else{
+            if (i < 0) {
+                __atomic_store_n(&idata->sourceerror, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&idata->sourceeof, 1, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+static void audiosourceprereadcache_FreeData(
+struct audiosourceprereadcache_internaldata* idata) {
+    if (idata->source) {
+        idata->source->close(idata->source);
+    }
+    if (idata->sourcelock) {
+        mutex_Destroy(idata->sourcelock);
+    }
+    free(idata->ring);
+    free(idata);
+}
+
+static void audiosourceprereadcache_Release(
+struct audiosourceprereadcache_internaldata* idata) {
+    // drop a reference, the last one frees everything
+    if (__atomic_sub_fetch(&idata->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        audiosourceprereadcache_FreeData(idata);
+    }
+}
+
+static void audiosourceprereadcache_Refill(void* userdata) {
+    // refill job run by the audio worker pool
+    struct audiosourceprereadcache_internaldata* idata = userdata;
+    __atomic_store_n(&idata->wakeuppending, 0, __ATOMIC_RELEASE);
+    if (!__atomic_load_n(&idata->closing, __ATOMIC_ACQUIRE)) {
+        mutex_Lock(idata->sourcelock);
+        audiosourceprereadcache_Fill(idata, idata->ringsize);
+        mutex_Release(idata->sourcelock);
+    }
+    audiosourceprereadcache_Release(idata);
+}
+
+static void audiosourceprereadcache_WakeWorker(
+struct audiosourceprereadcache_internaldata* idata) {
+    // queue a refill, only once until a worker picked it up:
+    if (__atomic_exchange_n(&idata->wakeuppending, 1, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    __atomic_add_fetch(&idata->refcount, 1, __ATOMIC_ACQ_REL);
+    audioworkerpool_Queue(&idata->refilljob);
+}
+
+static unsigned int audiosourceprereadcache_SampleSize(
+struct audiosource* source) {
+    // encoded data is counted in bytes, decoded audio in frames
+    if (source->samplerate == 0 || source->channels == 0) {
+        return 1;
+    }
+    switch (source->format) {
+    case AUDIOSOURCEFORMAT_S16LE:
+        return 2 * source->channels;
+    case AUDIOSOURCEFORMAT_S24LE:
+        return 3 * source->channels;
+    case AUDIOSOURCEFORMAT_F32LE:
+    case AUDIOSOURCEFORMAT_S32LE:
+        return 4 * source->channels;
+    default:
+        return source->channels;
+    }
+}
+
 static void audiosourceprereadcache_Rewind(struct audiosource* source) {
     struct audiosourceprereadcache_internaldata* idata = source->internaldata;
+    if (idata->backgroundread) {
+        // this waits for a source read of the worker to complete:
+        mutex_Lock(idata->sourcelock);
+    }
     idata->eof = 0;
     idata->source->rewind(idata->source);
-    idata->sourceeof = 0;
-    idata->prereadcachebytes = 0;
+    __atomic_store_n(&idata->readpos, idata->writepos, __ATOMIC_RELEASE);
+    __atomic_store_n(&idata->sourceerror, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&idata->sourceeof, 0, __ATOMIC_RELEASE);
+    if (idata->backgroundread) {
+        mutex_Release(idata->sourcelock);
+        audiosourceprereadcache_WakeWorker(idata);
+    }
 }
 
 static int audiosourceprereadcache_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
@@ -51,83 +191,180 @@ static int audiosourceprereadcache_Read(struct audiosource* source, char* buffer
     if (idata->eof) {
         return -1;
     }
-    if (idata->prereadcachesize == 0) {
-        // cache was not initialised yet - initialise with standard size
-        idata->prereadcachesize = (1024 * 10);
-        idata->prereadcache = malloc(idata->prereadcachesize);
-        if (!idata->prereadcache) {
+
+    unsigned int available = audiosourceprereadcache_Available(idata);
+    if (available < bytes &&
+    !__atomic_load_n(&idata->sourceeof, __ATOMIC_ACQUIRE)) {
+        if (idata->backgroundread && source->samplerate > 0 &&
+        source->channels > 0 &&
+        !__atomic_load_n(&waitforsource, __ATOMIC_RELAXED)) {
+            // Decoded audio read by the audio thread: never touch the
+            // source here (the worker might be in the middle of a slow
+            // decode). Return what we have, or silence if the worker
+            // didn't keep up:
+            if (available == 0) {
+                __atomic_add_fetch(&idata->underruns, 1, __ATOMIC_RELAXED);
+                audiosourceprereadcache_WakeWorker(idata);
+                unsigned int samplesize =
+                audiosourceprereadcache_SampleSize(source);
+                bytes -= bytes % samplesize;  // keep the stream aligned
+                if (bytes == 0) {
+                    bytes = samplesize;
+                }
+                memset(buffer, (source->format == AUDIOSOURCEFORMAT_U8) ?
+                128 : 0, bytes);
+                return bytes;
+            }
+        }else{
+            // Read from the source ourselves. In background mode, this is
+            // a cache in front of undecoded data, read by a decoder which
+            // runs on a worker itself (or the main thread), so waiting
+            // for the source is fine there. (Or we are rendering offline,
+            // where waiting is fine as well.)
+            if (idata->backgroundread) {
+                mutex_Lock(idata->sourcelock);
+            }
+            audiosourceprereadcache_Fill(idata, bytes);
+            if (idata->backgroundread) {
+                mutex_Release(idata->sourcelock);
+            }
+            available = audiosourceprereadcache_Available(idata);
+        }
+    }
+
+    if (available == 0) {
+        // End of Stream
+        idata->eof = 1;
+        if (__atomic_load_n(&idata->sourceerror, __ATOMIC_RELAXED)) {
             return -1;
         }
+        return 0;
     }
-    if (!idata->prereadcache) {
-        return -1;
+
+    // copy out of the ring (in up to two parts):
+    if (bytes > available) {
+        bytes = available;
     }
+    unsigned int offset = idata->readpos & (idata->ringsize - 1);
+    unsigned int part = idata->ringsize - offset;
+    if (part > bytes) {
+        part = bytes;
+    }
+    memcpy(buffer, idata->ring + offset, part);
+    if (part < bytes) {
+        memcpy(buffer + part, idata->ring, bytes - part);
+    }
+    __atomic_store_n(&idata->readpos, idata->readpos + bytes,
+    __ATOMIC_RELEASE);
 
-    unsigned int writtenbytes = 0;
-    while (bytes > 0) {
-        // first, refill our cache if it cannot satisfy the demands
-        if (bytes > idata->prereadcachebytes/2 && (idata->prereadcachebytes < idata->prereadcachesize/4
-            || bytes > idata->prereadcachebytes) && !idata->sourceeof) {
-            int i;
-            i = idata->source->read(idata->source, idata->prereadcache + idata->prereadcachebytes, idata->prereadcachesize - idata->prereadcachebytes);
-            if (i > 0) {
-                idata->prereadcachebytes += i;
-            }else{
-                idata->sourceeof = 1;
-                if (i < 0) {
-                    idata->eof = 1;
-                    return -1;
-                }
-            }
-        }
+    // have the worker top up the ring when it's below half:
+    if (idata->backgroundread && available - bytes < idata->ringsize / 2 &&
+    !__atomic_load_n(&idata->sourceeof, __ATOMIC_ACQUIRE)) {
+        audiosourceprereadcache_WakeWorker(idata);
+    }
+    return bytes;
+}
 
-        if (bytes > 0) {
-            if (idata->prereadcachebytes > 0) {
-                // we have some cached bytes - return them
-                unsigned int readbytes = idata->prereadcachebytes;
-                if (readbytes > bytes) {
-                    readbytes = bytes;
-                }
-                memcpy(buffer, idata->prereadcache, readbytes);
-                buffer += readbytes;
-                bytes -= readbytes;
-                writtenbytes += readbytes;
-
-                // trim data in cache buffer
-                if (readbytes < idata->prereadcachebytes) {
-                    memmove(idata->prereadcache, idata->prereadcache + readbytes, idata->prereadcachebytes - readbytes);
-                }
-                idata->prereadcachebytes -= readbytes;
-            }else{
-                // we were not able to get new cached bytes -> End of Stream
-                if (writtenbytes == 0) {
-                    idata->eof = 1;
-                }
-                return writtenbytes;
-            }
+static int audiosourceprereadcache_Seek(struct audiosource* source, size_t pos) {
+    struct audiosourceprereadcache_internaldata* idata = source->internaldata;
+    if (idata->backgroundread) {
+        // this waits for a source read of the worker to complete:
+        mutex_Lock(idata->sourcelock);
+    }
+    int result = idata->source->seek(idata->source, pos);
+    if (result) {
+        // drop everything cached from the old position:
+        idata->eof = 0;
+        __atomic_store_n(&idata->readpos, idata->writepos, __ATOMIC_RELEASE);
+        __atomic_store_n(&idata->sourceerror, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&idata->sourceeof, 0, __ATOMIC_RELEASE);
+    }
+    if (idata->backgroundread) {
+        mutex_Release(idata->sourcelock);
+        if (result) {
+            audiosourceprereadcache_WakeWorker(idata);
         }
     }
-    return writtenbytes;
+    return result;
 }
 
-static void audiosourceprereadcache_Close(struct audiosource* source) {
+static size_t audiosourceprereadcache_Position(struct audiosource* source) {
     struct audiosourceprereadcache_internaldata* idata = source->internaldata;
-    if (idata->source) {
-        idata->source->close(idata->source);
+    if (idata->backgroundread) {
+        mutex_Lock(idata->sourcelock);
     }
-    if (idata->prereadcache) {
-        free(idata->prereadcache);
+    // the source is ahead of us by what is still cached:
+    size_t pos = idata->source->position(idata->source);
+    size_t cached = audiosourceprereadcache_Available(idata) /
+    audiosourceprereadcache_SampleSize(source);
+    if (idata->backgroundread) {
+        mutex_Release(idata->sourcelock);
+    }
+    if (cached > pos) {
+        return 0;
+    }
+    return pos - cached;
+}
+
+static size_t audiosourceprereadcache_Length(struct audiosource* source) {
+    struct audiosourceprereadcache_internaldata* idata = source->internaldata;
+    if (idata->backgroundread) {
+        mutex_Lock(idata->sourcelock);
+    }
+    size_t length = idata->source->length(idata->source);
+    if (idata->backgroundread) {
+        mutex_Release(idata->sourcelock);
+    }
+    return length;
+}
+
+static void audiosourceprereadcache_Close(struct audiosource* source) {
+    struct audiosourceprereadcache_internaldata* idata = source->internaldata;
+    if (idata->backgroundread) {
+        // if a worker is still busy with us, it will free everything
+        // when done, so we don't need to wait for a slow read:
+        __atomic_store_n(&idata->closing, 1, __ATOMIC_RELEASE);
+        audiosourceprereadcache_Release(idata);
+    }else{
+        audiosourceprereadcache_FreeData(idata);
     }
-    free(idata);
     free(source);
 }
 
+int audiosourceprereadcache_GetFillLevel(struct audiosource* source) {
+    struct audiosourceprereadcache_internaldata* idata = source->internaldata;
+    if (__atomic_load_n(&idata->sourceeof, __ATOMIC_ACQUIRE)) {
+        // nothing left to wait for
+        return 100;
+    }
+    return (int)(((unsigned long long)
+    audiosourceprereadcache_Available(idata) * 100) / idata->ringsize);
+}
+
+unsigned int audiosourceprereadcache_GetUnderrunCount(struct audiosource* source) {
+    struct audiosourceprereadcache_internaldata* idata = source->internaldata;
+    return __atomic_load_n(&idata->underruns, __ATOMIC_RELAXED);
+}
+
+void audiosourceprereadcache_SetWaitForSource(int wait) {
+    __atomic_store_n(&waitforsource, wait, __ATOMIC_RELAXED);
+}
+
 struct audiosource* audiosourceprereadcache_Create(struct audiosource* source) {
+    return audiosourceprereadcache_CreateSized(source,
+    PREREADCACHEDEFAULTSIZE, 0);
+}
+
+struct audiosource* audiosourceprereadcache_CreateSized(struct audiosource* source, unsigned int cachesize, int backgroundread) {
     if (!source) {
         return NULL;
     }
+#ifdef NOBACKGROUNDREAD
+    backgroundread = 0;
+#endif
     struct audiosource* a = malloc(sizeof(*a));
     if (!a) {
+        source->close(source);
         return NULL;
     }
 
@@ -135,6 +372,7 @@ struct audiosource* audiosourceprereadcache_Create(struct audiosource* source) {
     a->internaldata = malloc(sizeof(struct audiosourceprereadcache_internaldata));
     if (!a->internaldata) {
         free(a);
+        source->close(source);
         return NULL;
     }
 
@@ -142,9 +380,55 @@ struct audiosource* audiosourceprereadcache_Create(struct audiosource* source) {
     memset(idata, 0, sizeof(*idata));
     idata->source = source;
 
+    // the cached data is in the same format as the source:
+    a->samplerate = source->samplerate;
+    a->channels = source->channels;
+    a->format = source->format;
+
+    // allocate ring buffer:
+    idata->ringsize = 1024;
+    while (idata->ringsize < cachesize && idata->ringsize < (1u << 30)) {
+        idata->ringsize *= 2;
+    }
+    idata->ring = malloc(idata->ringsize);
+    if (!idata->ring) {
+        audiosourceprereadcache_FreeData(idata);
+        free(a);
+        return NULL;
+    }
+
+    // use worker pool if wanted. if no worker threads could be started,
+    // read synchronously instead:
+    if (backgroundread && !audioworkerpool_Start()) {
+        backgroundread = 0;
+    }
+    if (backgroundread) {
+        idata->sourcelock = mutex_Create();
+        if (!idata->sourcelock) {
+            audiosourceprereadcache_FreeData(idata);
+            free(a);
+            return NULL;
+        }
+        idata->backgroundread = 1;
+        idata->refcount = 1;
+        idata->refilljob.func = &audiosourceprereadcache_Refill;
+        idata->refilljob.userdata = idata;
+
+        // have the first chunk ready before the audio thread gets to
+        // read (it won't wait for the worker), then start filling:
+        audiosourceprereadcache_Fill(idata, PREREADCHUNKSIZE);
+        audiosourceprereadcache_WakeWorker(idata);
+    }
+
     a->read = &audiosourceprereadcache_Read;
     a->close = &audiosourceprereadcache_Close;
     a->rewind = &audiosourceprereadcache_Rewind;
+    if (source->seekable) {
+        a->seek = &audiosourceprereadcache_Seek;
+        a->position = &audiosourceprereadcache_Position;
+        a->length = &audiosourceprereadcache_Length;
+        a->seekable = 1;
+    }
 
     return a;
 }
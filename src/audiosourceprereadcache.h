@@ -21,4 +21,31 @@
 
 */
 
+#define PREREADCACHEDEFAULTSIZE (1024 * 16)
+
+// Cache reads from the given source in a ring buffer of the default size,
+// filled synchronously when reading:
 struct audiosource* audiosourceprereadcache_Create(struct audiosource* source);
+
+// Cache with a ring buffer of (at least) cachesize bytes.
+// If backgroundread is 1, a pool of worker threads keeps the cache
+// filled so reading usually just copies out of memory. Put this in front
+// of a file to read ahead from slow storage, or in front of a decoder
+// to decode ahead outside of the audio thread.
+// A background cache of decoded audio never reads its source when it
+// runs empty, it returns silence instead (see GetUnderrunCount), unless
+// waiting was enabled with SetWaitForSource:
+struct audiosource* audiosourceprereadcache_CreateSized(struct audiosource* source, unsigned int cachesize, int backgroundread);
+
+// Get how full the cache is in percent (100 if the source has ended):
+int audiosourceprereadcache_GetFillLevel(struct audiosource* source);
+
+// Get how often a background cache of decoded audio ran empty and had
+// to return silence:
+unsigned int audiosourceprereadcache_GetUnderrunCount(struct audiosource* source);
+
+// Make background caches of decoded audio wait for their source when
+// they run empty instead of returning silence (1), or not (0, default).
+// For offline rendering, which doesn't need to keep up with real time
+// but should give the same result each time:
+void audiosourceprereadcache_SetWaitForSource(int wait);
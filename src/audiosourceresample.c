@@ -68,6 +68,10 @@ struct audiosource* audiosourceresample_Create(struct audiosource* source, unsig
     if (!source || source->samplerate <= 0) {
         return NULL;
     }
+    if (source->samplerate == targetrate) {
+        // nothing to do
+        return source;
+    }
     struct audiosource* as = malloc(sizeof(*as));
     if (!as) {
         return NULL;
@@ -90,6 +94,9 @@ struct audiosource* audiosourceresample_Create(struct audiosource* source, unsig
 
 #include <speex/speex_resampler.h>
 
+// We resample blocks of this length (in milliseconds of source audio):
+#define RESAMPLEBLOCKMS 10
+
 struct audiosourceresample_internaldata {
     struct audiosource* source;
     unsigned int targetrate;
@@ -99,10 +106,18 @@ struct audiosourceresample_internaldata {
 
     SpeexResamplerState* st;
 
-    char unprocessedbuf[512];
+    // source audio block. unprocessedoffset is the first byte not
+    // yet fed to the resampler, unprocessedbytes the fill level:
+    char* unprocessedbuf;
+    unsigned int unprocessedsize;
+    unsigned int unprocessedoffset;
     unsigned int unprocessedbytes;
 
-    char processedbuf[2048];
+    // resampled audio. processedoffset is the first byte not yet
+    // returned, processedbytes the fill level:
+    char* processedbuf;
+    unsigned int processedsize;
+    unsigned int processedoffset;
     unsigned int processedbytes;
 };
 
@@ -120,11 +135,24 @@ static void audiosourceresample_Close(struct audiosource* source) {
         }
 
         // free all structs
+        free(idata->unprocessedbuf);
+        free(idata->processedbuf);
         free(idata);
     }
     free(source);
 }
 
+static void audiosourceresample_ResetBuffers(struct audiosourceresample_internaldata* idata) {
+    // forget all buffered audio and resampler history:
+    idata->unprocessedoffset = 0;
+    idata->unprocessedbytes = 0;
+    idata->processedoffset = 0;
+    idata->processedbytes = 0;
+    if (idata->st) {
+        speex_resampler_reset_mem(idata->st);
+    }
+}
+
 static void audiosourceresample_Rewind(struct audiosource* source) {
     struct audiosourceresample_internaldata* idata = source->internaldata;
     if (!idata->eof || !idata->returnerroroneof) {
@@ -132,14 +160,41 @@ static void audiosourceresample_Rewind(struct audiosource* source) {
         idata->sourceeof = 0;
         idata->eof = 0;
         idata->returnerroroneof = 0;
-        idata->processedbytes = 0;
-        if (idata->st) {
-            speex_resampler_destroy(idata->st);
-            idata->st = NULL;
-        }
+        audiosourceresample_ResetBuffers(idata);
     }
 }
 
+static int audiosourceresample_FetchSource(struct audiosource* source) {
+    // Refill the source block. Returns 1 on success (or if EOF was hit),
+    // 0 on error.
+    struct audiosourceresample_internaldata* idata = source->internaldata;
+
+    // keep a possibly remaining partial frame:
+    unsigned int remaining = idata->unprocessedbytes -
+    idata->unprocessedoffset;
+    if (remaining > 0 && idata->unprocessedoffset > 0) {
+        memmove(idata->unprocessedbuf,
+        idata->unprocessedbuf + idata->unprocessedoffset, remaining);
+    }
+    idata->unprocessedoffset = 0;
+    idata->unprocessedbytes = remaining;
+
+    // read until the block is full or the source ends:
+    while (idata->unprocessedbytes < idata->unprocessedsize) {
+        int result = idata->source->read(idata->source,
+        idata->unprocessedbuf + idata->unprocessedbytes,
+        idata->unprocessedsize - idata->unprocessedbytes);
+        if (result < 0) {
+            return 0;
+        }
+        if (result == 0) {
+            idata->sourceeof = 1;
+            break;
+        }
+        idata->unprocessedbytes += result;
+    }
+    return 1;
+}
 
 static int audiosourceresample_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
     struct audiosourceresample_internaldata* idata = source->internaldata;
@@ -161,101 +216,58 @@ static int audiosourceresample_Read(struct audiosource* source, char* buffer, un
         }
     }
 
+    unsigned int framesize = sizeof(float) * source->channels;
     unsigned int writtenbytes = 0;
-
-    // If we have unreturned processed bytes left, return them
-    unsigned int returnprocessed = idata->processedbytes;
-    if (returnprocessed > bytes) {
-        returnprocessed = bytes;
-    }
-    if (returnprocessed > 0) {
-        memcpy(buffer, idata->processedbuf, returnprocessed);
-        if (returnprocessed < idata->processedbytes) {
-            // move up remaining bytes in the buffer
-            memmove(idata->processedbuf, idata->processedbuf + returnprocessed, sizeof(idata->processedbuf) - returnprocessed);
-        }
-        idata->processedbytes -= returnprocessed;
-        buffer += returnprocessed;
-        bytes -= returnprocessed;
-        writtenbytes += returnprocessed;
-    }
-
-    // Fetch new resampled content:
     while (bytes > 0) {
-        unsigned int wantbytes = idata->source->samplerate / 1000;
-        unsigned int outbytes = (source->samplerate / 1000) * 2; // doubled to avoid possible speex float bug on output limitation
+        // If we have unreturned processed bytes left, return them
+        if (idata->processedoffset < idata->processedbytes) {
+            unsigned int returnamount = idata->processedbytes -
+            idata->processedoffset;
+            if (returnamount > bytes) {
+                returnamount = bytes;
+            }
+            memcpy(buffer, idata->processedbuf + idata->processedoffset,
+            returnamount);
+            idata->processedoffset += returnamount;
+            buffer += returnamount;
+            bytes -= returnamount;
+            writtenbytes += returnamount;
+            continue;
+        }
+        idata->processedoffset = 0;
+        idata->processedbytes = 0;
 
         // fetch new source data if required
-        if (idata->unprocessedbytes < wantbytes) {
-            int result = idata->source->read(idata->source, idata->unprocessedbuf + idata->unprocessedbytes, wantbytes - idata->unprocessedbytes);
-            if (result < 0) {
+        if (idata->unprocessedbytes - idata->unprocessedoffset <
+        framesize) {
+            if (idata->sourceeof) {
+                break;
+            }
+            if (!audiosourceresample_FetchSource(source)) {
                 idata->returnerroroneof = 1;
                 idata->eof = 1;
                 return -1;
-            }else{
-                if (result == 0) {
-                    idata->sourceeof = 1;
-                    break;
-                }
-                idata->unprocessedbytes += result;
-                if (idata->unprocessedbytes < wantbytes) {
-                    // too short, read again:
-                    continue;
-                }
+            }
+            if (idata->unprocessedbytes < framesize) {
+                // nothing left
+                break;
             }
         }
 
         // resample the data we have now:
-        unsigned int in = idata->unprocessedbytes;
-        unsigned int out = outbytes - idata->processedbytes;
-
-        // We want to have this in nice full channel samples:
-        while (in > 0 && in % (sizeof(float) * source->channels) != 0) {
-            in--;
-        }
-        while (out > 0 && out % (sizeof(float) * source->channels) != 0) {
-            out--;
-        }
-        // printf("in, out: %u, %u\n",in,out);
-        unsigned int insamples = in/(sizeof(float)*source->channels);
-        unsigned int outsamples = out/(sizeof(float)*source->channels);
-        // printf("in samples, out samples: %u, %u\n", insamples,outsamples);
-
-        memset(idata->processedbuf + idata->processedbytes, 0, out);
-        int error = speex_resampler_process_interleaved_float(idata->st, (const float*)idata->unprocessedbuf, &insamples, (float*)idata->processedbuf + idata->processedbytes, &outsamples);
-        if (error == 0) {
-            out = outsamples * sizeof(float) * source->channels;
-            in = insamples * sizeof(float) * source->channels;
-            // printf("result: in, out: %u(%u), %u(%u)\n", in, insamples, out, outsamples);
-            // resampling was successful:
-            idata->processedbytes += out;
-            idata->unprocessedbytes -= in;
-            if (idata->unprocessedbytes > 0) {
-                // move remaining unprocessed bytes up to beginning of buffer
-                memmove(idata->unprocessedbuf, idata->unprocessedbuf + in, sizeof(idata->unprocessedbuf) - in);
-            }
-
-            // return bytes:
-            unsigned int returnamount = bytes;
-            if (returnamount > idata->processedbytes) {
-                returnamount = idata->processedbytes;
-            }
-            if (returnamount > 0) {
-                memcpy(buffer, idata->processedbuf, returnamount);
-                if (returnamount < idata->processedbytes) {
-                    // move remaining processed bytes up to beginning
-                    memmove(idata->processedbuf, idata->processedbuf + returnamount, sizeof(idata->processedbuf) - returnamount);
-                }
-                bytes -= returnamount;
-                writtenbytes += returnamount;
-                idata->processedbytes -= returnamount;
-                buffer += returnamount;
-            }
-        }else{
+        unsigned int insamples = (idata->unprocessedbytes -
+        idata->unprocessedoffset) / framesize;
+        unsigned int outsamples = idata->processedsize / framesize;
+        int error = speex_resampler_process_interleaved_float(idata->st,
+        (const float*)(idata->unprocessedbuf + idata->unprocessedoffset),
+        &insamples, (float*)idata->processedbuf, &outsamples);
+        if (error != 0) {
             idata->returnerroroneof = 1;
             idata->eof = 1;
             return -1;
         }
+        idata->unprocessedoffset += insamples * framesize;
+        idata->processedbytes = outsamples * framesize;
     }
 
     if (writtenbytes > 0) {
@@ -287,8 +299,22 @@ static size_t audiosourceresample_Position(struct audiosource* source) {
         return 0;
     }
 
-    return (idata->source->position(idata->source) *
-    source->samplerate) / idata->source->samplerate;
+    // the source is ahead of us by what we still have buffered:
+    unsigned int framesize = sizeof(float) * source->channels;
+    size_t pos = idata->source->position(idata->source);
+    size_t unprocessed = (idata->unprocessedbytes -
+    idata->unprocessedoffset) / framesize;
+    if (unprocessed > pos) {
+        unprocessed = pos;
+    }
+    pos = ((pos - unprocessed) * source->samplerate) /
+    idata->source->samplerate;
+    size_t processed = (idata->processedbytes -
+    idata->processedoffset) / framesize;
+    if (processed > pos) {
+        return 0;
+    }
+    return pos - processed;
 }
 
 static int audiosourceresample_Seek(struct audiosource* source, size_t pos) {
@@ -298,14 +324,18 @@ static int audiosourceresample_Seek(struct audiosource* source, size_t pos) {
         return 0;
     }
 
-    // check position against valid boundaries:
-    size_t tpos = (pos * source->samplerate) / idata->source->samplerate;
-    if (tpos > idata->source->length(idata->source)) {
-        tpos = idata->source->length(idata->source);
+    // convert to a source position and check against valid boundaries:
+    size_t spos = (pos * idata->source->samplerate) / source->samplerate;
+    size_t length = idata->source->length(idata->source);
+    if (length > 0 && spos > length) {
+        spos = length;
     }
 
     // try seeking:
-    if (idata->source->seek(idata->source, pos)) {
+    if (idata->source->seek(idata->source, spos)) {
+        idata->sourceeof = 0;
+        idata->eof = 0;
+        audiosourceresample_ResetBuffers(idata);
         return 1;
     }
     return 0;
@@ -356,6 +386,25 @@ struct audiosource* audiosourceresample_Create(struct audiosource* source, unsig
     memset(idata, 0, sizeof(*idata));
     idata->source = source;
     idata->targetrate = targetrate;
+
+    // allocate block buffers, with some room in the resampled one
+    // for rounding:
+    unsigned int framesize = sizeof(float) * source->channels;
+    unsigned int inframes = (source->samplerate * RESAMPLEBLOCKMS) / 1000;
+    unsigned int outframes = (unsigned int)(((unsigned long long)inframes *
+    targetrate) / source->samplerate) + 16;
+    idata->unprocessedsize = inframes * framesize;
+    idata->processedsize = outframes * framesize;
+    idata->unprocessedbuf = malloc(idata->unprocessedsize);
+    idata->processedbuf = malloc(idata->processedsize);
+    if (!idata->unprocessedbuf || !idata->processedbuf) {
+        free(idata->unprocessedbuf);
+        free(idata->processedbuf);
+        free(idata);
+        free(a);
+        source->close(source);
+        return NULL;
+    }
     a->samplerate = targetrate;
     a->channels = source->channels;
     a->format = source->format;
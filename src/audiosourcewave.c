@@ -30,21 +30,405 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-#include "logging.h"
 #include "audiosource.h"
 #include "audiosourcewave.h"
-#include "library.h"
-#include "filelist.h"
-#include "file.h"
 
 
+// WAVE decoder for uncompressed PCM/IEEE float audio.
+// The sample data is passed on as it is (except for mono which is
+// turned into stereo), use audiosourceformatconvert to get it into
+// the format you want.
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+// for reading and expanding mono audio:
+#define MONOBUFSIZE 4096
+
+struct audiosourcewave_internaldata {
+    // file source (or whereever the undecoded audio comes from):
+    struct audiosource* source;
+
+    // EOF information of this file source:
+    int eof;  // we have spilled out an EOF
+    int returnerroroneof;  // keep errors in mind
+
+    // layout of the file:
+    size_t dataoffset;  // start of the sample data in the file
+    size_t databytes;  // size of the sample data
+    size_t dataread;  // sample data bytes read so far
+    unsigned int bytespersample;  // of one channel
+    unsigned int filechannels;  // 1 for mono (we output stereo then)
+
+    // expanded mono sample which wasn't returned completely:
+    char expandedsample[8];
+    unsigned int expandedoffset;
+    unsigned int expandedbytes;
+};
+
+static uint32_t audiosourcewave_Uint32(const unsigned char* p) {
+    return ((uint32_t)p[0]) | ((uint32_t)p[1] << 8) |
+    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t audiosourcewave_Uint16(const unsigned char* p) {
+    return ((uint16_t)p[0]) | ((uint16_t)p[1] << 8);
+}
+
+static int audiosourcewave_ReadFully(struct audiosource* source,
+char* buffer, unsigned int bytes) {
+    // Read exactly the given amount of bytes.
+    // Returns 1 on success, 0 on EOF or error.
+    while (bytes > 0) {
+        int i = source->read(source, buffer, bytes);
+        if (i <= 0) {
+            return 0;
+        }
+        buffer += i;
+        bytes -= i;
+    }
+    return 1;
+}
+
+static int audiosourcewave_Skip(struct audiosource* source,
+size_t bytes) {
+    char buf[512];
+    while (bytes > 0) {
+        unsigned int amount = sizeof(buf);
+        if (amount > bytes) {
+            amount = bytes;
+        }
+        if (!audiosourcewave_ReadFully(source, buf, amount)) {
+            return 0;
+        }
+        bytes -= amount;
+    }
+    return 1;
+}
+
+static int audiosourcewave_SeekFile(struct audiosource* source,
+size_t pos) {
+    // move file source to the given byte position of the sample data:
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    if (idata->source->seekable) {
+        if (!idata->source->seek(idata->source, idata->dataoffset + pos)) {
+            return 0;
+        }
+    } else {
+        if (pos < idata->dataread) {
+            idata->source->rewind(idata->source);
+            if (!audiosourcewave_Skip(idata->source,
+            idata->dataoffset + pos)) {
+                return 0;
+            }
+        } else {
+            if (!audiosourcewave_Skip(idata->source,
+            pos - idata->dataread)) {
+                return 0;
+            }
+        }
+    }
+    idata->dataread = pos;
+    idata->expandedbytes = 0;
+    return 1;
+}
+
+static void audiosourcewave_Rewind(struct audiosource* source) {
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    if (!idata->eof || !idata->returnerroroneof) {
+        idata->eof = 0;
+        idata->returnerroroneof = 0;
+        if (!idata->source->seekable) {
+            // start over completely:
+            idata->source->rewind(idata->source);
+            idata->dataread = 0;
+            idata->expandedbytes = 0;
+            if (!audiosourcewave_Skip(idata->source, idata->dataoffset)) {
+                idata->returnerroroneof = 1;
+            }
+            return;
+        }
+        if (!audiosourcewave_SeekFile(source, 0)) {
+            idata->returnerroroneof = 1;
+        }
+    }
+}
+
+static int audiosourcewave_ReadData(struct audiosource* source,
+char* buffer, unsigned int bytes) {
+    // read sample data as it is stored in the file
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    size_t left = idata->databytes - idata->dataread;
+    if (bytes > left) {
+        bytes = left;
+    }
+    if (bytes == 0) {
+        return 0;
+    }
+    int i = idata->source->read(idata->source, buffer, bytes);
+    if (i > 0) {
+        idata->dataread += i;
+    }
+    return i;
+}
+
+static int audiosourcewave_Read(struct audiosource* source,
+char* buffer, unsigned int bytes) {
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    if (idata->eof) {
+        return -1;
+    }
+
+    int result;
+    if (idata->filechannels == 2) {
+        // no processing needed
+        result = audiosourcewave_ReadData(source, buffer, bytes);
+    } else {
+        // read mono samples and duplicate them for stereo
+        unsigned int samplesize = idata->bytespersample;
+        if (idata->expandedoffset < idata->expandedbytes ||
+        bytes < samplesize * 2) {
+            // return a single sample piece by piece
+            if (idata->expandedoffset >= idata->expandedbytes) {
+                char sample[4];
+                if (audiosourcewave_ReadData(source, sample, samplesize) <
+                (int)samplesize) {
+                    idata->eof = 1;
+                    return 0;
+                }
+                memcpy(idata->expandedsample, sample, samplesize);
+                memcpy(idata->expandedsample + samplesize, sample,
+                samplesize);
+                idata->expandedoffset = 0;
+                idata->expandedbytes = samplesize * 2;
+            }
+            unsigned int amount = idata->expandedbytes -
+            idata->expandedoffset;
+            if (amount > bytes) {
+                amount = bytes;
+            }
+            memcpy(buffer, idata->expandedsample + idata->expandedoffset,
+            amount);
+            idata->expandedoffset += amount;
+            return amount;
+        }
+        char monobuf[MONOBUFSIZE];
+        unsigned int amount = (bytes / 2 / samplesize) * samplesize;
+        if (amount > sizeof(monobuf) / samplesize * samplesize) {
+            amount = sizeof(monobuf) / samplesize * samplesize;
+        }
+        result = 0;
+        if (amount > 0) {
+            // (the file data is read in whole samples only)
+            result = audiosourcewave_ReadData(source, monobuf, amount);
+            if (result > 0 && result % samplesize != 0) {
+                unsigned int missing = samplesize - (result % samplesize);
+                if (audiosourcewave_ReadFully(idata->source,
+                monobuf + result, missing)) {
+                    idata->dataread += missing;
+                    result += missing;
+                } else {
+                    result -= result % samplesize;
+                }
+            }
+        }
+        if (result > 0) {
+            int i = 0;
+            while (i < result) {
+                memcpy(buffer + i * 2, monobuf + i, samplesize);
+                memcpy(buffer + i * 2 + samplesize, monobuf + i,
+                samplesize);
+                i += samplesize;
+            }
+            result *= 2;
+        }
+    }
+    if (result <= 0) {
+        idata->eof = 1;
+        if (result < 0) {
+            idata->returnerroroneof = 1;
+            return -1;
+        }
+        return 0;
+    }
+    return result;
+}
+
+static size_t audiosourcewave_Length(struct audiosource* source) {
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    return idata->databytes / (idata->bytespersample * idata->filechannels);
+}
+
+static size_t audiosourcewave_Position(struct audiosource* source) {
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    return idata->dataread / (idata->bytespersample * idata->filechannels);
+}
+
+static int audiosourcewave_Seek(struct audiosource* source, size_t pos) {
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    if (idata->eof && idata->returnerroroneof) {
+        return 0;
+    }
+    size_t length = audiosourcewave_Length(source);
+    if (pos > length) {
+        pos = length;
+    }
+    if (!audiosourcewave_SeekFile(source,
+    pos * idata->bytespersample * idata->filechannels)) {
+        return 0;
+    }
+    idata->eof = 0;
+    return 1;
+}
+
+static void audiosourcewave_Close(struct audiosource* source) {
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    if (idata) {
+        if (idata->source) {
+            idata->source->close(idata->source);
+        }
+        free(idata);
+    }
+    free(source);
+}
+
+static int audiosourcewave_ParseHeader(struct audiosource* source) {
+    // Parse the RIFF header up to the start of the sample data.
+    // Returns 1 on success, 0 if this isn't a supported WAVE file.
+    struct audiosourcewave_internaldata* idata = source->internaldata;
+    unsigned char header[12];
+    if (!audiosourcewave_ReadFully(idata->source, (char*)header, 12) ||
+    memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return 0;
+    }
+    size_t offset = 12;
+    int havefmt = 0;
+    while (1) {
+        unsigned char chunk[8];
+        if (!audiosourcewave_ReadFully(idata->source, (char*)chunk, 8)) {
+            return 0;
+        }
+        offset += 8;
+        uint32_t chunksize = audiosourcewave_Uint32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            // format description:
+            unsigned char fmt[40];
+            if (chunksize < 16) {
+                return 0;
+            }
+            unsigned int fmtbytes = chunksize;
+            if (fmtbytes > sizeof(fmt)) {
+                fmtbytes = sizeof(fmt);
+            }
+            if (!audiosourcewave_ReadFully(idata->source, (char*)fmt,
+            fmtbytes) || !audiosourcewave_Skip(idata->source,
+            chunksize - fmtbytes + (chunksize % 2))) {
+                return 0;
+            }
+            offset += chunksize + (chunksize % 2);
+
+            unsigned int formattag = audiosourcewave_Uint16(fmt);
+            unsigned int channels = audiosourcewave_Uint16(fmt + 2);
+            unsigned int samplerate = audiosourcewave_Uint32(fmt + 4);
+            unsigned int bits = audiosourcewave_Uint16(fmt + 14);
+            if (formattag == WAVE_FORMAT_EXTENSIBLE) {
+                if (fmtbytes < 26) {
+                    return 0;
+                }
+                // first two bytes of the sub format GUID are the tag:
+                formattag = audiosourcewave_Uint16(fmt + 24);
+            }
+            if (channels < 1 || channels > 2 || samplerate == 0) {
+                return 0;
+            }
+            if (formattag == WAVE_FORMAT_PCM) {
+                if (bits == 8) {
+                    source->format = AUDIOSOURCEFORMAT_U8;
+                } else if (bits == 16) {
+                    source->format = AUDIOSOURCEFORMAT_S16LE;
+                } else if (bits == 24) {
+                    source->format = AUDIOSOURCEFORMAT_S24LE;
+                } else if (bits == 32) {
+                    source->format = AUDIOSOURCEFORMAT_S32LE;
+                } else {
+                    return 0;
+                }
+            } else if (formattag == WAVE_FORMAT_IEEE_FLOAT && bits == 32) {
+                source->format = AUDIOSOURCEFORMAT_F32LE;
+            } else {
+                return 0;
+            }
+            idata->bytespersample = bits / 8;
+            idata->filechannels = channels;
+            source->samplerate = samplerate;
+            source->channels = 2;
+            havefmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            // sample data starts here:
+            if (!havefmt) {
+                return 0;
+            }
+            idata->dataoffset = offset;
+            idata->databytes = chunksize;
+            size_t filesize = 0;
+            if (idata->source->length) {
+                filesize = idata->source->length(idata->source);
+            }
+            if (filesize > offset && idata->databytes > filesize - offset) {
+                // truncated file (or streamed with unknown size)
+                idata->databytes = filesize - offset;
+            }
+            return 1;
+        } else {
+            // skip chunks we don't care about
+            if (!audiosourcewave_Skip(idata->source,
+            chunksize + (chunksize % 2))) {
+                return 0;
+            }
+            offset += chunksize + (chunksize % 2);
+        }
+    }
+}
+
 struct audiosource* audiosourcewave_Create(struct audiosource* source) {
-    if (source) {
+    if (!source) {
+        return NULL;
+    }
+
+    // allocate data struct
+    struct audiosource* a = malloc(sizeof(*a));
+    if (!a) {
         source->close(source);
+        return NULL;
     }
-    return NULL;
-}
+    memset(a, 0, sizeof(*a));
+    a->internaldata = malloc(sizeof(struct audiosourcewave_internaldata));
+    if (!a->internaldata) {
+        free(a);
+        source->close(source);
+        return NULL;
+    }
+    struct audiosourcewave_internaldata* idata = a->internaldata;
+    memset(idata, 0, sizeof(*idata));
+    idata->source = source;
 
+    // set function pointers
+    a->read = &audiosourcewave_Read;
+    a->close = &audiosourcewave_Close;
+    a->rewind = &audiosourcewave_Rewind;
+    a->position = &audiosourcewave_Position;
+    a->length = &audiosourcewave_Length;
+    a->seek = &audiosourcewave_Seek;
+    a->seekable = 1;
 
+    // read file header:
+    if (!audiosourcewave_ParseHeader(a)) {
+        audiosourcewave_Close(a);
+        return NULL;
+    }
+    return a;
+}
 
 #endif // ifdef USE_AUDIO
@@ -0,0 +1,139 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <stdlib.h>
+
+#include "audioworkerpool.h"
+#include "threading.h"
+
+#ifdef WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// maximum amount of worker threads:
+#define MAXAUDIOWORKERS 4
+
+static mutex* poollock = NULL;
+static semaphore* pooljobs = NULL;
+static struct audioworkerjob* firstjob = NULL;
+static struct audioworkerjob* lastjob = NULL;
+
+static void audioworkerpool_Worker(void* userdata) {
+    (void)userdata;
+    while (1) {
+        // wait for the next job:
+        semaphore_Wait(pooljobs);
+        mutex_Lock(poollock);
+        struct audioworkerjob* job = firstjob;
+        firstjob = job->next;
+        if (!firstjob) {
+            lastjob = NULL;
+        }
+        mutex_Release(poollock);
+
+        // the job might requeue or free itself, so don't touch it after:
+        job->func(job->userdata);
+    }
+}
+
+static int audioworkerpool_WorkerCount(void) {
+    // use all but one core (which is busy with the game itself):
+    int cores = 1;
+#ifdef WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    cores = info.dwNumberOfProcessors;
+#else
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    int count = cores - 1;
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > MAXAUDIOWORKERS) {
+        count = MAXAUDIOWORKERS;
+    }
+    return count;
+}
+
+int audioworkerpool_Start(void) {
+    if (poollock) {
+        return 1;
+    }
+    poollock = mutex_Create();
+    pooljobs = semaphore_Create(0);
+    if (!poollock || !pooljobs) {
+        if (poollock) {
+            mutex_Destroy(poollock);
+            poollock = NULL;
+        }
+        if (pooljobs) {
+            semaphore_Destroy(pooljobs);
+            pooljobs = NULL;
+        }
+        return 0;
+    }
+    int count = audioworkerpool_WorkerCount();
+    int spawned = 0;
+    int i = 0;
+    while (i < count) {
+        threadinfo* t = thread_CreateInfo();
+        if (t) {
+            thread_Spawn(t, audioworkerpool_Worker, NULL);
+            thread_FreeInfo(t);
+            spawned++;
+        }
+        i++;
+    }
+    if (spawned == 0) {
+        // without workers, queued jobs would never run. make the
+        // callers fall back to doing the work themselves:
+        mutex_Destroy(poollock);
+        poollock = NULL;
+        semaphore_Destroy(pooljobs);
+        pooljobs = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void audioworkerpool_Queue(struct audioworkerjob* job) {
+    mutex_Lock(poollock);
+    job->next = NULL;
+    if (lastjob) {
+        lastjob->next = job;
+    } else {
+        firstjob = job;
+    }
+    lastjob = job;
+    mutex_Release(poollock);
+    semaphore_Post(pooljobs);
+}
+
+#endif  // USE_AUDIO
@@ -0,0 +1,55 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_AUDIOWORKERPOOL_H_
+#define BLITWIZARD_AUDIOWORKERPOOL_H_
+
+#ifdef USE_AUDIO
+
+// A small pool of worker threads shared by all audio background work
+// (reading and decoding ahead, building seek indexes), so the amount of
+// threads stays the same no matter how many sounds are playing.
+
+struct audioworkerjob {
+    void (*func)(void* userdata);
+    void* userdata;
+    struct audioworkerjob* next;  // used by the pool
+};
+// A job is embedded into whatever it works on, so queueing it
+// doesn't need to allocate anything.
+
+int audioworkerpool_Start(void);
+// Start the worker threads if they aren't running yet. (MAIN THREAD)
+// Returns 1 on success, 0 on failure (also if no thread could be
+// started, in which case the work needs to be done synchronously).
+
+void audioworkerpool_Queue(struct audioworkerjob* job);
+// Queue a job to be run by the next free worker (jobs are started in
+// the order they were queued). The job is not copied, it needs to stay
+// around until its func is called. A job may queue itself again from
+// its func, but must not be queued twice at the same time.
+// Can be used from any thread once the pool is started.
+
+#endif  // USE_AUDIO
+
+#endif  // BLITWIZARD_AUDIOWORKERPOOL_H_
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #ifdef WINDOWS
 #include <windows.h>
 #endif
@@ -62,9 +63,28 @@ int graphicsrender_Draw(const char* texname, int x, int y, float alpha, unsigned
     return graphicsrender_DrawCropped(texname, x, y, alpha, 0, 0, 0, 0, drawwidth, drawheight, rotationcenterx, rotationcentery, rotationangle, horiflipped, red, green, blue);
 }
 
+int graphicsrender_DrawByHandle(int texture, int x, int y, float alpha, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue) {
+    return graphicsrender_DrawCroppedByHandle(texture, x, y, alpha, 0, 0, 0, 0, drawwidth, drawheight, rotationcenterx, rotationcentery, rotationangle, horiflipped, red, green, blue);
+}
 
-int graphics_GetTextureDimensions(const char* name, unsigned int* width, unsigned int* height) {
+int graphicsrender_DrawCropped(const char* texname, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue) {
+    return graphicsrender_DrawCroppedByHandle(graphics_GetTextureHandle(texname), x, y, alpha, sourcex, sourcey, sourcewidth, sourceheight, drawwidth, drawheight, rotationcenterx, rotationcentery, rotationangle, horiflipped, red, green, blue);
+}
+
+int graphics_GetTextureHandle(const char* name) {
     struct graphicstexture* gt = graphicstexturelist_GetTextureByName(name);
+    if (!gt) {
+        return 0;
+    }
+    return gt->handle;
+}
+
+int graphics_GetTextureDimensions(const char* name, unsigned int* width, unsigned int* height) {
+    return graphics_GetTextureDimensionsByHandle(graphics_GetTextureHandle(name), width, height);
+}
+
+int graphics_GetTextureDimensionsByHandle(int texture, unsigned int* width, unsigned int* height) {
+    struct graphicstexture* gt = graphicstexturelist_GetTextureByHandle(texture);
     if (!gt || gt->threadingptr) {
         return 0;
     }
@@ -87,7 +107,7 @@ static int graphics_AndroidTextureReader(void* buffer, size_t bytes, void* userd
 }
 #endif
 
-int graphics_PromptTextureLoading(const char* texture) {
+int graphics_PromptTextureLoading(const char* texture, int priority) {
     // check if texture is already present or being loaded
     struct graphicstexture* gt = graphicstexturelist_GetTextureByName(texture);
     if (gt) {
@@ -110,27 +130,35 @@ int graphics_PromptTextureLoading(const char* texture) {
         free(gt);
         return 0;
     }
+    if (!graphicstexturelist_AddTextureHandle(gt)) {
+        free(gt->name);
+        free(gt);
+        return 0;
+    }
 
     // trigger image fetching thread
 #ifdef SDLRW
     gt->rwops = SDL_RWFromFile(gt->name, "rb");
     if (!gt->rwops) {
+        graphicstexturelist_RemoveTextureHandle(gt);
         free(gt->name);
         free(gt);
         return 0;
     }
-    gt->threadingptr = img_LoadImageThreadedFromFunction(&graphics_AndroidTextureReader, gt->rwops, 0, 0, "rgba", NULL);
+    gt->threadingptr = img_LoadImageThreadedFromFunction(&graphics_AndroidTextureReader, gt->rwops, 0, 0, "rgba", priority, NULL);
 #else
     char* p = file_GetAbsolutePathFromRelativePath(gt->name);
     if (!p) {
+        graphicstexturelist_RemoveTextureHandle(gt);
         free(gt->name);
         free(gt);
         return 0;
     }
-    gt->threadingptr = img_LoadImageThreadedFromFile(p, 0, 0, "rgba", NULL);
+    gt->threadingptr = img_LoadImageThreadedFromFile(p, 0, 0, "rgba", priority, NULL);
     free(p);
 #endif
     if (!gt->threadingptr) {
+        graphicstexturelist_RemoveTextureHandle(gt);
         free(gt->name);
         free(gt);
 #ifdef SDLRW
@@ -141,7 +169,13 @@ int graphics_PromptTextureLoading(const char* texture) {
 
     // add us to the list
     graphicstexturelist_AddTextureToList(gt);
-    graphicstexturelist_AddTextureToHashmap(gt);
+    if (!graphicstexturelist_AddTextureToHashmap(gt)) {
+        // abandon the texture, it will be thrown away as soon as
+        // the threaded image loading was completed:
+        free(gt->name);
+        gt->name = NULL;
+        return 0;
+    }
     return 1;
 }
 
@@ -166,6 +200,7 @@ int graphics_FreeTexture(struct graphicstexture* gt, struct graphicstexture* pre
     }
 #endif
     graphicstexturelist_RemoveTextureFromList(gt, prev);
+    graphicstexturelist_RemoveTextureHandle(gt);
     free(gt);
     return 1;
 }
@@ -206,8 +241,9 @@ int graphics_FinishImageLoading(struct graphicstexture* gt, struct graphicstextu
 
 
 int graphics_LoadTextureInstantly(const char* texture) {
-    // prompt normal async texture loading
-    if (!graphics_PromptTextureLoading(texture)) {
+    // prompt normal async texture loading. We are going to wait for it,
+    // so load it before anything else:
+    if (!graphics_PromptTextureLoading(texture, INT_MAX)) {
         return 0;
     }
     struct graphicstexture* gt = graphicstexturelist_GetTextureByName(texture);
@@ -215,6 +251,9 @@ int graphics_LoadTextureInstantly(const char* texture) {
         return 0;
     }
 
+    // if it was queued already before, move it to the front now:
+    img_SetPriority(gt->threadingptr, INT_MAX);
+
     // wait for loading to finish
     while (!img_CheckSuccess(gt->threadingptr)) {
     }
@@ -236,7 +275,10 @@ void graphics_UnloadTexture(const char* texname, void (*callback)(int success, c
                 callback(0, gt->name);
             }
 
-            // cancel loading by abandoning the texture
+            // cancel loading by abandoning the texture. If the image
+            // loader didn't start on it yet, it won't do so at all:
+            img_CancelJob(gt->threadingptr);
+            graphicstexturelist_RemoveTextureFromHashmap(gt);
             free(gt->name);
             gt->name = NULL;
 
@@ -273,10 +315,13 @@ void graphics_CheckTextureLoading(void (*callback)(int success, const char* text
     graphicstexturelist_DoForAllTextures(&graphics_CheckTextureLoadingCallback, callback);
 }
 
-
 int graphics_IsTextureLoaded(const char* name) {
+    return graphics_IsTextureLoadedByHandle(graphics_GetTextureHandle(name));
+}
+
+int graphics_IsTextureLoadedByHandle(int texture) {
     // check texture state
-    struct graphicstexture* gt = graphicstexturelist_GetTextureByName(name);
+    struct graphicstexture* gt = graphicstexturelist_GetTextureByHandle(texture);
     if (gt) {
         // check for threaded loading
         if (gt->threadingptr) {
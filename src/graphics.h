@@ -50,8 +50,12 @@ int graphics_Init(char** error, int use3dgraphics);
 HWND graphics_GetWindowHWND(); // get win32 HWND handle for the window
 #endif
 
-int graphics_PromptTextureLoading(const char* texture);
+int graphics_PromptTextureLoading(const char* texture, int priority);
 // Prompt texture loading.
+// Textures with a higher priority are loaded first (usually use 0),
+// e.g. use this to get textures which are visible right away loaded
+// before others. The priority of a texture which is already being
+// loaded isn't changed.
 // Returns 0 on fatal error (e.g. out of memory), 1 for operation in progress,
 // 2 for image already loaded.
 
@@ -94,9 +98,16 @@ void graphicsrender_StartFrame(void);
 int graphicsrender_DrawCropped(const char* texname, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue);
 // Draw a texture cropped. Returns 1 on success, 0 when there is no such texture.
 
+int graphicsrender_DrawCroppedByHandle(int texture, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue);
+// Same as graphicsrender_DrawCropped, but takes a texture handle
+// (see graphics_GetTextureHandle) instead of the texture name.
+
 int graphicsrender_Draw(const char* texname, int x, int y, float alpha, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue);
 // Draw a texture. Returns 1 on success, 0 when there is no such texture.
 
+int graphicsrender_DrawByHandle(int texture, int x, int y, float alpha, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue);
+// Same as graphicsrender_Draw, but takes a texture handle.
+
 void graphicsrender_DrawRectangle(int x, int y, int width, int height, float r, float g, float b, float a);
 // Draw a colored rectangle.
 
@@ -112,9 +123,21 @@ void graphics_UnloadTexture(const char* texname, void (*callback)(int success, c
 int graphics_IsTextureLoaded(const char* name);
 // Check if a texture is loaded. 0: no, 1: operation in progress, 2: yes
 
+int graphics_IsTextureLoadedByHandle(int texture);
+// Same as graphics_IsTextureLoaded, but takes a texture handle.
+
 int graphics_GetTextureDimensions(const char* name, unsigned int* width, unsigned int* height);
 // 1 on success, 0 on error
 
+int graphics_GetTextureHandle(const char* name);
+// Get the handle of a texture which is loaded or being loaded.
+// The handle stays the same until the texture is unloaded and can be
+// used to access the texture without looking up its name each time.
+// Returns 0 if there is no such texture.
+
+int graphics_GetTextureDimensionsByHandle(int texture, unsigned int* width, unsigned int* height);
+// Same as graphics_GetTextureDimensions, but takes a texture handle.
+
 int graphics_GetWindowDimensions(unsigned int* width, unsigned int* height);
 // 1 on success, 0 on error (window not opened most likely)
 
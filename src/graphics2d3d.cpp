@@ -189,8 +189,16 @@ int graphics_TextureToHW(struct graphicstexture* gt) {
             return 0;
         }
 
-        // copy pixels into texture
-        memcpy(pixels, gt->pixels, gt->width * gt->height * 4);
+        // copy pixels into texture (rows may be padded)
+        if ((unsigned int)pitch == gt->width * 4) {
+            memcpy(pixels, gt->pixels, gt->width * gt->height * 4);
+        }else{
+            unsigned int r = 0;
+            while (r < gt->height) {
+                memcpy((char*)pixels + pitch * r, (char*)gt->pixels + gt->width * 4 * r, gt->width * 4);
+                r++;
+            }
+        }
 
         // unlock texture
         SDL_UnlockTexture(t);
@@ -247,8 +255,16 @@ void graphics_TextureFromHW(struct graphicstexture* gt) {
                 printf("Warning: SDL_LockTexture() failed\n");
             }else{
 
-                // Copy texture
-                memcpy(gt->pixels, pixels, gt->width * gt->height * 4);
+                // Copy texture (rows may be padded)
+                if ((unsigned int)pitch == gt->width * 4) {
+                    memcpy(gt->pixels, pixels, gt->width * gt->height * 4);
+                }else{
+                    unsigned int r = 0;
+                    while (r < gt->height) {
+                        memcpy((char*)gt->pixels + gt->width * 4 * r, (char*)pixels + pitch * r, gt->width * 4);
+                        r++;
+                    }
+                }
 
                 // unlock texture again
                 SDL_UnlockTexture(gt->tex.sdltex);
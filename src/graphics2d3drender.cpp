@@ -103,10 +103,10 @@ void graphicsrender_DrawRectangle(int x, int y, int width, int height, float r,
 #endif
 }
 
-int graphicsrender_DrawCropped(const char* texname, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue) {
+int graphicsrender_DrawCroppedByHandle(int texture, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue) {
 #ifdef USE_SDL_GRAPHICS
     if (!graphics3d) {
-        struct graphicstexture* gt = graphicstexturelist_GetTextureByName(texname);
+        struct graphicstexture* gt = graphicstexturelist_GetTextureByHandle(texture);
         if (!gt || gt->threadingptr || !gt->tex.sdltex) {
             return 0;
         }
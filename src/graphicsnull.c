@@ -86,11 +86,11 @@ void graphicsrender_DrawRectangle(int x, int y, int width, int height, float r,
     return;
 }
 
-int graphicsrender_DrawCropped(const char* texname, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue) {
+int graphicsrender_DrawCroppedByHandle(int texture, int x, int y, float alpha, unsigned int sourcex, unsigned int sourcey, unsigned int sourcewidth, unsigned int sourceheight, unsigned int drawwidth, unsigned int drawheight, int rotationcenterx, int rotationcentery, double rotationangle, int horiflipped, double red, double green, double blue) {
     // while we cannot truly draw with the null device,
     // ensure the texture is at least valid and loaded from disk:
 
-    struct graphicstexture* gt = graphicstexturelist_GetTextureByName(texname);
+    struct graphicstexture* gt = graphicstexturelist_GetTextureByHandle(texture);
     if (!gt || gt->threadingptr) {
         return 0;
     }
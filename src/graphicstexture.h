@@ -44,8 +44,8 @@ struct graphicstexture {
 
     // pointer to next list element
     struct graphicstexture* next;
-    // pointer to next hashmap bucket element
-    struct graphicstexture* hashbucketnext;
+    // handle for quick access (graphicstexturelist_GetTextureByHandle)
+    int handle;
 
 };
 
@@ -28,6 +28,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #ifdef WINDOWS
 #include <windows.h>
 #endif
@@ -53,11 +54,30 @@
 static struct graphicstexture* texlist = NULL;
 hashmap* texhashmap = NULL;
 
-void graphicstexturelist_InitializeHashmap() {
+// Texture handles work like the sound ids of the audio mixer: the lower
+// bits are an index into the handle table, the upper bits the generation
+// of that handle table entry. The generation is increased each time an
+// entry is reused, so handles of old textures never resolve to a newer
+// texture using the same entry.
+#define HANDLEINDEXBITS 16
+#define HANDLEINDEXMASK ((1 << HANDLEINDEXBITS) - 1)
+#define MAXHANDLEGENERATION (INT_MAX >> HANDLEINDEXBITS)
+struct texturehandle {
+    int generation;
+    struct graphicstexture* gt;  // NULL if unused
+    int nextfree;  // next unused handle table entry
+};
+static struct texturehandle* handles = NULL;
+static int handlecount = 0;
+static int firstfreehandle = -1;
+
+int graphicstexturelist_InitializeHashmap() {
     if (texhashmap) {
-        return;
+        return 1;
     }
-    texhashmap = hashmap_New(1024 * 1024);
+    // the hash map grows when required, so start small:
+    texhashmap = hashmap_New(64, 1);
+    return (texhashmap != NULL);
 }
 
 void graphicstexturelist_AddTextureToList(struct graphicstexture* gt) {
@@ -74,40 +94,98 @@ void graphicstexturelist_RemoveTextureFromList(struct graphicstexture* gt, struc
 }
 
 struct graphicstexture* graphicstexturelist_GetTextureByName(const char* name) {
-    graphicstexturelist_InitializeHashmap();
-    uint32_t i = hashmap_GetIndex(texhashmap, name, strlen(name), 1);
-    struct graphicstexture* gt = (struct graphicstexture*)(texhashmap->items[i]);
-    while (gt && !(strcasecmp(gt->name, name) == 0)) {
-        gt = gt->hashbucketnext;
+    if (!texhashmap) {
+        return NULL;
     }
-    return gt;
+    return (struct graphicstexture*)hashmap_Get(texhashmap, name);
 }
 
-void graphicstexturelist_AddTextureToHashmap(struct graphicstexture* gt) {
-    graphicstexturelist_InitializeHashmap();
-    uint32_t i = hashmap_GetIndex(texhashmap, gt->name, strlen(gt->name), 1);
-    gt->hashbucketnext = (struct graphicstexture*)(texhashmap->items[i]);
-    texhashmap->items[i] = gt;
+struct graphicstexture* graphicstexturelist_GetTextureByHandle(int handle) {
+    if (handle <= 0) {
+        return NULL;
+    }
+    int i = (handle & HANDLEINDEXMASK);
+    if (i >= handlecount || handles[i].generation !=
+    (handle >> HANDLEINDEXBITS)) {
+        return NULL;
+    }
+    struct graphicstexture* gt = handles[i].gt;
+    if (!gt || !gt->name) {
+        // unused or abandoned texture
+        return NULL;
+    }
+    return gt;
 }
 
-void graphicstexturelist_RemoveTextureFromHashmap(struct graphicstexture* gt) {
-    graphicstexturelist_InitializeHashmap();
-    uint32_t i = hashmap_GetIndex(texhashmap, gt->name, strlen(gt->name), 1);
-    struct graphicstexture* gt2 = (struct graphicstexture*)(texhashmap->items[i]);
-    struct graphicstexture* gtprev = NULL;
-    while (gt2) {
-        if (gt2 == gt) {
-            if (gtprev) {
-                gtprev->next = gt->hashbucketnext;
-            }else{
-                texhashmap->items[i] = gt->hashbucketnext;
-            }
-            gt->hashbucketnext = NULL;
-            return;
+int graphicstexturelist_AddTextureHandle(struct graphicstexture* gt) {
+    if (firstfreehandle < 0) {
+        // grow the handle table:
+        int newcount = handlecount * 2;
+        if (newcount < 64) {
+            newcount = 64;
+        }
+        if (newcount > HANDLEINDEXMASK + 1) {
+            newcount = HANDLEINDEXMASK + 1;
+        }
+        if (newcount <= handlecount) {
+            return 0;
+        }
+        struct texturehandle* newhandles = realloc(handles,
+        sizeof(*newhandles) * newcount);
+        if (!newhandles) {
+            return 0;
+        }
+        handles = newhandles;
+        memset(handles + handlecount, 0,
+        sizeof(*handles) * (newcount - handlecount));
+        // chain up the new entries (backwards so low indices come first):
+        int i = newcount - 1;
+        while (i >= handlecount) {
+            handles[i].nextfree = firstfreehandle;
+            firstfreehandle = i;
+            i--;
         }
+        handlecount = newcount;
+    }
+    int i = firstfreehandle;
+    firstfreehandle = handles[i].nextfree;
+    int generation = handles[i].generation + 1;
+    if (generation > MAXHANDLEGENERATION) {
+        generation = 1;
+    }
+    handles[i].generation = generation;
+    handles[i].gt = gt;
+    gt->handle = (generation << HANDLEINDEXBITS) | i;
+    return 1;
+}
+
+void graphicstexturelist_RemoveTextureHandle(struct graphicstexture* gt) {
+    if (gt->handle <= 0) {
+        return;
+    }
+    int i = (gt->handle & HANDLEINDEXMASK);
+    handles[i].gt = NULL;
+    handles[i].nextfree = firstfreehandle;
+    firstfreehandle = i;
+    gt->handle = 0;
+}
+
+int graphicstexturelist_AddTextureToHashmap(struct graphicstexture* gt) {
+    if (!graphicstexturelist_InitializeHashmap()) {
+        return 0;
+    }
+    // the name is used as key, so it needs to be removed from the
+    // hash map again before it is freed:
+    return hashmap_Set(texhashmap, gt->name, gt);
+}
 
-        gtprev = gt2;
-        gt2 = gt2->hashbucketnext;
+void graphicstexturelist_RemoveTextureFromHashmap(struct graphicstexture* gt) {
+    if (!texhashmap) {
+        return;
+    }
+    // only remove the entry if it is actually ours:
+    if (hashmap_Get(texhashmap, gt->name) == gt) {
+        hashmap_Remove(texhashmap, gt->name);
     }
 }
 
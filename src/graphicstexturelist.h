@@ -25,7 +25,19 @@
 
 struct graphicstexture* graphicstexturelist_GetTextureByName(const char* name);
 
-void graphicstexturelist_AddTextureToHashmap(struct graphicstexture* gt);
+struct graphicstexture* graphicstexturelist_GetTextureByHandle(int handle);
+// Get a texture by its handle in constant time. Returns NULL if the
+// texture was unloaded (or abandoned) in the meantime.
+
+int graphicstexturelist_AddTextureHandle(struct graphicstexture* gt);
+// Assign a new handle to the texture (stored in gt->handle).
+// Returns 0 when out of memory or handles, otherwise 1.
+
+void graphicstexturelist_RemoveTextureHandle(struct graphicstexture* gt);
+// Release the texture's handle, so it no longer resolves to the texture.
+
+int graphicstexturelist_AddTextureToHashmap(struct graphicstexture* gt);
+// Make the texture findable by name. Returns 0 when out of memory.
 
 void graphicstexturelist_RemoveTextureFromHashmap(struct graphicstexture* gt);
 
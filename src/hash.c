@@ -62,34 +62,171 @@ uint32_t fnv_32_upper_buf(const void *buf, size_t len) {
 
 // End of public domain code.
 
-hashmap* hashmap_New(uint32_t size) {
+// The hash map uses open addressing with linear probing. Entries cache
+// the hash of their key, so probing mostly compares integers and only
+// calls strcmp() for likely matches. Removal shifts the following
+// entries of the probe sequence back, so no deleted markers are needed.
+
+// grow when more than 3/4 of the slots are in use:
+#define MAXLOAD(size) (((size) / 4) * 3)
+#define MINSIZE 8
+
+static uint32_t hashmap_Hash(hashmap* h, const char* key) {
+    // FNV-1 like fnv_32_buf, but in a single pass over the string and
+    // with ASCII-only upper casing instead of a toupper() call per byte:
+    uint32_t hval = FNV_32_INIT;
+    const unsigned char* p = (const unsigned char*)key;
+    if (h->ignorecase) {
+        while (*p) {
+            unsigned char c = *p++;
+            if (c >= 'a' && c <= 'z') {
+                c -= 'a' - 'A';
+            }
+            hval *= FNV_32_PRIME;
+            hval ^= (uint32_t)c;
+        }
+    }else{
+        while (*p) {
+            hval *= FNV_32_PRIME;
+            hval ^= (uint32_t)*p++;
+        }
+    }
+    return hval;
+}
+
+static uint32_t hashmap_Slot(hashmap* h, uint32_t hash) {
+    // fold the upper bits in, since small tables only use the lowest ones:
+    return (hash ^ (hash >> 16)) & (h->size - 1);
+}
+
+static int hashmap_KeysEqual(hashmap* h, const char* a, const char* b) {
+    if (h->ignorecase) {
+        return (strcasecmp(a, b) == 0);
+    }
+    return (strcmp(a, b) == 0);
+}
+
+static int hashmap_Resize(hashmap* h, uint32_t size) {
+    struct hashmapentry* entries = malloc(sizeof(*entries) * size);
+    if (!entries) {
+        return 0;
+    }
+    memset(entries, 0, sizeof(*entries) * size);
+    struct hashmapentry* oldentries = h->entries;
+    uint32_t oldsize = h->size;
+    h->entries = entries;
+    h->size = size;
+
+    // move over all entries (the hashes don't need to be computed again):
+    uint32_t i = 0;
+    while (i < oldsize) {
+        if (oldentries[i].key) {
+            uint32_t k = hashmap_Slot(h, oldentries[i].hash);
+            while (entries[k].key) {
+                k = (k + 1) & (size - 1);
+            }
+            entries[k] = oldentries[i];
+        }
+        i++;
+    }
+    free(oldentries);
+    return 1;
+}
+
+hashmap* hashmap_New(uint32_t size, int ignorecase) {
     hashmap* hmap = malloc(sizeof(*hmap));
     if (!hmap) {
         return NULL;
     }
-    hmap->items = malloc(sizeof(void*)*size);
-    if (!hmap->items) {
+    memset(hmap, 0, sizeof(*hmap));
+    hmap->ignorecase = ignorecase;
+
+    // pick a power of two with room for the requested amount of entries:
+    uint32_t slots = MINSIZE;
+    while (MAXLOAD(slots) < size && slots < 0x80000000u) {
+        slots *= 2;
+    }
+    if (!hashmap_Resize(hmap, slots)) {
         free(hmap);
         return NULL;
     }
-    memset(hmap->items, 0, sizeof(void*)*size);
-    hmap->size = size;
     return hmap;
 }
 
-uint32_t hashmap_GetIndex(hashmap* h, const char* buf, size_t len, int ignorecase) {
-    uint32_t index;
-    if (ignorecase) {
-        index = fnv_32_upper_buf(buf, len) % h->size;
-    }else{
-        index = fnv_32_buf(buf, len) % h->size;
+static int hashmap_Find(hashmap* h, const char* key, uint32_t hash) {
+    uint32_t i = hashmap_Slot(h, hash);
+    while (h->entries[i].key) {
+        if (h->entries[i].hash == hash &&
+        hashmap_KeysEqual(h, h->entries[i].key, key)) {
+            return (int)i;
+        }
+        i = (i + 1) & (h->size - 1);
+    }
+    return -1;
+}
+
+void* hashmap_Get(hashmap* h, const char* key) {
+    int i = hashmap_Find(h, key, hashmap_Hash(h, key));
+    if (i < 0) {
+        return NULL;
+    }
+    return h->entries[i].value;
+}
+
+int hashmap_Set(hashmap* h, const char* key, void* value) {
+    uint32_t hash = hashmap_Hash(h, key);
+    int i = hashmap_Find(h, key, hash);
+    if (i >= 0) {
+        h->entries[i].key = key;
+        h->entries[i].value = value;
+        return 1;
+    }
+    if (h->count + 1 > MAXLOAD(h->size)) {
+        if (h->size >= 0x80000000u || !hashmap_Resize(h, h->size * 2)) {
+            return 0;
+        }
+    }
+    uint32_t k = hashmap_Slot(h, hash);
+    while (h->entries[k].key) {
+        k = (k + 1) & (h->size - 1);
+    }
+    h->entries[k].hash = hash;
+    h->entries[k].key = key;
+    h->entries[k].value = value;
+    h->count++;
+    return 1;
+}
+
+void* hashmap_Remove(hashmap* h, const char* key) {
+    int found = hashmap_Find(h, key, hashmap_Hash(h, key));
+    if (found < 0) {
+        return NULL;
+    }
+    void* value = h->entries[found].value;
+    uint32_t mask = h->size - 1;
+    uint32_t i = (uint32_t)found;
+    uint32_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!h->entries[j].key) {
+            break;
+        }
+        // move the entry into the gap unless its home slot lies
+        // (cyclically) between the gap and its current slot:
+        uint32_t home = hashmap_Slot(h, h->entries[j].hash);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            h->entries[i] = h->entries[j];
+            i = j;
+        }
     }
-    return index;
+    memset(&h->entries[i], 0, sizeof(h->entries[i]));
+    h->count--;
+    return value;
 }
 
 void hashmap_Free(hashmap* h) {
-    if (h->items) {
-        free(h->items);
+    if (h->entries) {
+        free(h->entries);
     }
     free(h);
 }
@@ -21,11 +21,41 @@
 
 */
 
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t fnv_32_buf(const void *buf, size_t len);
+uint32_t fnv_32_upper_buf(const void *buf, size_t len);
+
+struct hashmapentry {
+    uint32_t hash;  // cached hash of the key
+    const char* key;  // NULL for unused slots
+    void* value;
+};
+
 typedef struct hashmap {
-        uint32_t size;
-        void** items;
+    uint32_t size;  // amount of slots, always a power of two
+    uint32_t count;  // amount of used slots
+    int ignorecase;
+    struct hashmapentry* entries;
 } hashmap;
 
-hashmap* hashmap_New(uint32_t size);
-uint32_t hashmap_GetIndex(hashmap* h, const char* buf, size_t len, int ignorecase);
+hashmap* hashmap_New(uint32_t size, int ignorecase);
+// Create a new string keyed hash map with room for roughly the given
+// amount of entries. It grows automatically when more entries are added.
+// If ignorecase is 1, keys are compared case insensitively.
+
+void* hashmap_Get(hashmap* h, const char* key);
+// Get the value stored for the given key, or NULL if there is none.
+
+int hashmap_Set(hashmap* h, const char* key, void* value);
+// Store a value for the given key (replacing any previous value).
+// The key is not copied, so it needs to stay valid until the entry is
+// removed again (usually it is the name stored in the value itself).
+// Returns 1 on success, 0 when out of memory.
+
+void* hashmap_Remove(hashmap* h, const char* key);
+// Remove the entry for the given key. Returns the value it had,
+// or NULL if there was no such entry.
+
 void hashmap_Free(hashmap* h);
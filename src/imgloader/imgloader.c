@@ -39,6 +39,15 @@
 #include <pthread.h>
 #endif
 
+// Images are loaded by a fixed amount of worker threads (one per CPU core)
+// which take the jobs from a priority queue. Jobs with higher priority are
+// started first, jobs of the same priority in the order they were added.
+#define MAXLOADERTHREADS 16
+
+#define JOB_QUEUED 0
+#define JOB_RUNNING 1
+#define JOB_DONE 2
+
 struct loaderthreadinfo {
     char* path;
     int (*readfunc)(void* buffer, size_t bytes, void* userdata);
@@ -51,41 +60,165 @@ struct loaderthreadinfo {
     int imagewidth,imageheight;
     int maxsizex,maxsizey;
     void(*callback)(void* handle, int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize);
+    // job queue info (protected by poollock):
+    int state;
+    int priority;
+    unsigned int sequence;
+    int queueindex;
+};
+
 #ifdef WIN
-    //windows threads stuff
-    HANDLE threadhandle;
+static CRITICAL_SECTION poollock;
+static HANDLE jobsemaphore = NULL;
 #else
-    //pthreads for unix
-    pthread_t threadhandle;
-    pthread_mutex_t threadeventmutex;
-    int threadeventobject;
+static pthread_mutex_t poollock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobcondition = PTHREAD_COND_INITIALIZER;
 #endif
-};
+static int workercount = 0;
+// queued jobs as binary heap with the next job to start at the top:
+static struct loaderthreadinfo** jobqueue = NULL;
+static int jobqueuecount = 0;
+static int jobqueuesize = 0;
+static unsigned int lastsequence = 0;
 
+static void lockpool(void) {
 #ifdef WIN
-unsigned __stdcall loaderthreadfunction(void* data) {
+    EnterCriticalSection(&poollock);
 #else
-void* loaderthreadfunction(void* data) {
+    pthread_mutex_lock(&poollock);
+#endif
+}
+
+static void unlockpool(void) {
+#ifdef WIN
+    LeaveCriticalSection(&poollock);
+#else
+    pthread_mutex_unlock(&poollock);
 #endif
-    struct loaderthreadinfo* i = data;
+}
+
+static int jobgoesfirst(struct loaderthreadinfo* a, struct loaderthreadinfo* b) {
+    if (a->priority != b->priority) {
+        return (a->priority > b->priority);
+    }
+    return ((int)(a->sequence - b->sequence) < 0);
+}
+
+static void jobqueueswap(int i, int j) {
+    struct loaderthreadinfo* t = jobqueue[i];
+    jobqueue[i] = jobqueue[j];
+    jobqueue[j] = t;
+    jobqueue[i]->queueindex = i;
+    jobqueue[j]->queueindex = j;
+}
+
+static void jobqueueup(int i) {
+    while (i > 0 && jobgoesfirst(jobqueue[i], jobqueue[(i - 1) / 2])) {
+        jobqueueswap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void jobqueuedown(int i) {
+    while (1) {
+        int best = i;
+        int left = i * 2 + 1;
+        int right = left + 1;
+        if (left < jobqueuecount && jobgoesfirst(jobqueue[left], jobqueue[best])) {
+            best = left;
+        }
+        if (right < jobqueuecount && jobgoesfirst(jobqueue[right], jobqueue[best])) {
+            best = right;
+        }
+        if (best == i) {
+            return;
+        }
+        jobqueueswap(i, best);
+        i = best;
+    }
+}
+
+static void jobqueueremove(struct loaderthreadinfo* i) {
+    // move the last job into the gap and restore the heap order:
+    int index = i->queueindex;
+    jobqueuecount--;
+    if (index != jobqueuecount) {
+        struct loaderthreadinfo* moved = jobqueue[jobqueuecount];
+        jobqueue[index] = moved;
+        moved->queueindex = index;
+        jobqueueup(index);
+        jobqueuedown(moved->queueindex);
+    }
+    i->queueindex = -1;
+}
+
+// read all data from a reading function into one buffer, growing it
+// geometrically. Returns the buffer or NULL on error.
+static void* readall(int (*readfunc)(void* buffer, size_t bytes, void* userdata), void* userdata, size_t sizehint, size_t* size) {
+    size_t capacity = sizehint + 1;
+    if (capacity < 64 * 1024) {
+        capacity = 64 * 1024;
+    }
+    size_t currentsize = 0;
+    char* p = malloc(capacity);
+    if (!p) {
+        return NULL;
+    }
+    while (1) {
+        if (currentsize >= capacity) {
+            char* pnew = realloc(p, capacity * 2);
+            if (!pnew) {
+                free(p);
+                return NULL;
+            }
+            p = pnew;
+            capacity *= 2;
+        }
+        // read straight into the buffer:
+        size_t bytes = capacity - currentsize;
+        if (bytes > 0x40000000) {
+            bytes = 0x40000000;  // readfunc returns an int
+        }
+        int k = readfunc(p + currentsize, bytes, userdata);
+        if (k < 0) {
+            free(p);
+            return NULL;
+        }
+        if (k == 0) {
+            break;
+        }
+        currentsize += k;
+    }
+    *size = currentsize;
+    return p;
+}
+
+static int readfromfile(void* buffer, size_t bytes, void* userdata) {
+    return fread(buffer, 1, bytes, (FILE*)userdata);
+}
+
+static void loadimage(struct loaderthreadinfo* i) {
     // first, we probably need to load the image from a file first
     if (!i->memdata && i->path) {
         FILE* r = fopen(i->path, "rb");
         if (r) {
-            char buf[512];
-            int k = fread(buf, 1, sizeof(buf), r);
-            while (k > 0) {
-                void* newp = realloc(i->memdata, i->memdatasize + k);
-                if (!newp) {
-                    if (i->memdata) {free(i->memdata);}
-                    i->memdata = NULL;
-                    break;
+            // get the file size, so we can read it with one allocation
+            // and (usually) a single read:
+            long filesize = -1;
+            if (fseek(r, 0, SEEK_END) == 0) {
+                filesize = ftell(r);
+                if (fseek(r, 0, SEEK_SET) != 0) {
+                    filesize = -1;
                 }
-                i->memdata = newp;
-                memcpy(i->memdata + i->memdatasize, buf, k);
-                i->memdatasize += k;
-                k = fread(buf, 1, sizeof(buf), r);
             }
+            if (filesize < 0) {
+                filesize = 0;
+            }
+            // the file might still change while we read it,
+            // so only use the size as a hint:
+            size_t size = 0;
+            i->memdata = readall(&readfromfile, r, filesize, &size);
+            i->memdatasize = size;
             fclose(r);
         }
         free(i->path);
@@ -93,80 +226,163 @@ void* loaderthreadfunction(void* data) {
     }
     //load from a byte reading function
     if (i->readfunc) {
-        void* p = NULL;
-        size_t currentsize = 0;
-        char buf[1024];
-
-        //read byte chunks:
-        int k = i->readfunc(buf, sizeof(buf), i->readfuncptr);
-        while (k > 0) {
-            currentsize += k;
-            void* pnew = realloc(p, currentsize);
-            if (!pnew) {
-                while (k > 0) {k = i->readfunc(buf, sizeof(buf), i->readfuncptr);}
-                k = -1;
-                break;
-            }
-            p = pnew;
-            //copy read bytes
-            memcpy(p + (currentsize - k), buf, k);
-            k = i->readfunc(buf, sizeof(buf), i->readfuncptr);
-        }
-        //handle error
-        if (k < 0) {
-            if (p) {
-                free(p);
-            }
-        }else{
-            i->memdata = p;
-            i->memdatasize = currentsize;
-        }
+        size_t size = 0;
+        i->memdata = readall(i->readfunc, i->readfuncptr, 0, &size);
+        i->memdatasize = size;
     }
     //now try to load the image!
     if (i->memdata) {
         if (i->memdatasize > 0) {
-            if (!pngloader_LoadRGBA(i->memdata, i->memdatasize, &i->data, &i->datasize, &i->imagewidth, &i->imageheight, i->maxsizex, i->maxsizey)) {
+            //libpng swaps the channels while decoding if we want bgra
+            int bgra = (strcasecmp(i->format, "bgra") == 0);
+            if (!pngloader_LoadRGBAorBGRA(i->memdata, i->memdatasize, bgra, &i->data, &i->datasize, &i->imagewidth, &i->imageheight, i->maxsizex, i->maxsizey)) {
                 i->data = NULL;
                 i->datasize = 0;
             }
         }
         free(i->memdata);
         i->memdata = NULL;
-        
-        //convert it if needed
-        if (strcasecmp(i->format, "bgra") == 0) {
-            img_ConvertRGBAtoBGRA(i->data, i->datasize);
-        }
     }
+}
+
+#ifdef WIN
+unsigned __stdcall loaderthreadfunction(void* data) {
+#else
+void* loaderthreadfunction(void* data) {
+#endif
+    (void)data;
+    while (1) {
+        // wait for the next job:
+#ifdef WIN
+        WaitForSingleObject(jobsemaphore, INFINITE);
+        lockpool();
+        if (jobqueuecount == 0) {
+            // the job we were woken up for got cancelled
+            unlockpool();
+            continue;
+        }
+#else
+        lockpool();
+        while (jobqueuecount == 0) {
+            pthread_cond_wait(&jobcondition, &poollock);
+        }
+#endif
+        struct loaderthreadinfo* i = jobqueue[0];
+        jobqueueremove(i);
+        i->state = JOB_RUNNING;
+        unlockpool();
+
+        loadimage(i);
+
+        // mark the job as done. Don't touch it afterwards since it
+        // may be freed as soon as it is marked done:
+        void(*callback)(void* handle, int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize) = i->callback;
+        int imagewidth = i->imagewidth;
+        int imageheight = i->imageheight;
+        char* imagedata = i->data;
+        unsigned int datasize = i->datasize;
+        lockpool();
+        i->state = JOB_DONE;
+        unlockpool();
 
-    //enter callback if we got one
-    if (i->callback) {
-        i->callback(data, i->imagewidth, i->imageheight, i->data, i->datasize);
+        //enter callback if we got one
+        if (callback) {
+            callback(i, imagewidth, imageheight, imagedata, datasize);
+        }
     }
-    
 #ifdef WIN
     return 0;
 #else
-    pthread_mutex_lock(&i->threadeventmutex);
-    i->threadeventobject = 1;
-    pthread_mutex_unlock(&i->threadeventmutex);
-    pthread_exit(NULL);
     return NULL;
 #endif
 }
 
-void startthread(struct loaderthreadinfo* i) {
+static int startpool(void) {
+    // start the worker threads if we didn't yet
+    if (workercount > 0) {
+        return 1;
+    }
+    int cores = 1;
 #ifdef WIN
-    i->threadhandle = (HANDLE)_beginthreadex(NULL, 0, loaderthreadfunction, i, 0, NULL);
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    cores = info.dwNumberOfProcessors;
+    InitializeCriticalSection(&poollock);
+    jobsemaphore = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+    if (!jobsemaphore) {
+        DeleteCriticalSection(&poollock);
+        return 0;
+    }
+#else
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (cores < 1) {
+        cores = 1;
+    }
+    if (cores > MAXLOADERTHREADS) {
+        cores = MAXLOADERTHREADS;
+    }
+    while (workercount < cores) {
+#ifdef WIN
+        HANDLE h = (HANDLE)_beginthreadex(NULL, 0, loaderthreadfunction, NULL, 0, NULL);
+        if (!h) {
+            break;
+        }
+        CloseHandle(h);
 #else
-    pthread_mutex_init(&i->threadeventmutex, NULL);
-    i->threadeventobject = 0;
-    pthread_create(&i->threadhandle, NULL, loaderthreadfunction, i);
-    pthread_detach(i->threadhandle);
+        pthread_t t;
+        if (pthread_create(&t, NULL, loaderthreadfunction, NULL) != 0) {
+            break;
+        }
+        pthread_detach(t);
 #endif
+        workercount++;
+    }
+    if (workercount == 0) {
+#ifdef WIN
+        CloseHandle(jobsemaphore);
+        jobsemaphore = NULL;
+        DeleteCriticalSection(&poollock);
+#endif
+        return 0;
+    }
+    return 1;
 }
 
-void* img_LoadImageThreadedFromFile(const char* path, int maxwidth, int maxheight, const char* format, void(*callback)(void* handle, int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize)) {
+static int startjob(struct loaderthreadinfo* i) {
+    if (!startpool()) {
+        return 0;
+    }
+    lockpool();
+    if (jobqueuecount >= jobqueuesize) {
+        int newsize = jobqueuesize * 2;
+        if (newsize < 64) {
+            newsize = 64;
+        }
+        struct loaderthreadinfo** newqueue = realloc(jobqueue, sizeof(*newqueue) * newsize);
+        if (!newqueue) {
+            unlockpool();
+            return 0;
+        }
+        jobqueue = newqueue;
+        jobqueuesize = newsize;
+    }
+    i->state = JOB_QUEUED;
+    i->sequence = ++lastsequence;
+    i->queueindex = jobqueuecount;
+    jobqueue[jobqueuecount] = i;
+    jobqueuecount++;
+    jobqueueup(i->queueindex);
+    unlockpool();
+#ifdef WIN
+    ReleaseSemaphore(jobsemaphore, 1, NULL);
+#else
+    pthread_cond_signal(&jobcondition);
+#endif
+    return 1;
+}
+
+void* img_LoadImageThreadedFromFile(const char* path, int maxwidth, int maxheight, const char* format, int priority, void(*callback)(void* handle, int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize)) {
     struct loaderthreadinfo* t = malloc(sizeof(struct loaderthreadinfo));
     if (!t) {return NULL;}
     memset(t, 0, sizeof(*t));
@@ -183,11 +399,15 @@ void* img_LoadImageThreadedFromFile(const char* path, int maxwidth, int maxheigh
     strcpy(t->path, path);
     strcpy(t->format, format);
     t->maxsizex = maxwidth; t->maxsizey = maxheight;
-    startthread(t);
+    t->priority = priority;
+    if (!startjob(t)) {
+        free(t->format);free(t->path);free(t);
+        return NULL;
+    }
     return t;
 }
 
-void* img_LoadImageThreadedFromFunction(int (*readfunc)(void* buffer, size_t bytes, void* userdata), void* userdata, int maxwidth, int maxheight, const char* format, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize)) {
+void* img_LoadImageThreadedFromFunction(int (*readfunc)(void* buffer, size_t bytes, void* userdata), void* userdata, int maxwidth, int maxheight, const char* format, int priority, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize)) {
     struct loaderthreadinfo* t = malloc(sizeof(struct loaderthreadinfo));
     if (!t) {return NULL;}
     memset(t, 0, sizeof(*t));
@@ -201,11 +421,15 @@ void* img_LoadImageThreadedFromFunction(int (*readfunc)(void* buffer, size_t byt
     strcpy(t->format, format);
     t->maxsizex = maxwidth;
     t->maxsizey = maxheight;
-    startthread(t);
+    t->priority = priority;
+    if (!startjob(t)) {
+        free(t->format);free(t);
+        return NULL;
+    }
     return t;
 }
 
-void* img_LoadImageThreadedFromMemory(const void* memdata, unsigned int memdatasize, int maxwidth, int maxheight, const char* format, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize)) {
+void* img_LoadImageThreadedFromMemory(const void* memdata, unsigned int memdatasize, int maxwidth, int maxheight, const char* format, int priority, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize)) {
     struct loaderthreadinfo* t = malloc(sizeof(struct loaderthreadinfo));
     if (!t) {return NULL;}
     memset(t, 0, sizeof(*t));
@@ -223,21 +447,21 @@ void* img_LoadImageThreadedFromMemory(const void* memdata, unsigned int memdatas
     memcpy(t->memdata, memdata, memdatasize);
     t->memdatasize = memdatasize;
     t->maxsizex = maxwidth; t->maxsizey = maxheight;
-    startthread(t);
+    t->priority = priority;
+    if (!startjob(t)) {
+        free(t->format);free(t->memdata);free(t);
+        return NULL;
+    }
     return t;
 }
 
 int img_CheckSuccess(void* handle) {
     if (!handle) {return 1;}
     struct loaderthreadinfo* i = handle;
-#ifdef WIN
-    if (WaitForSingleObject(i->threadhandle, 0) == WAIT_OBJECT_0) {
-#else
-    pthread_mutex_lock(&i->threadeventmutex);
-    int u = i->threadeventobject;
-    pthread_mutex_unlock(&i->threadeventmutex);
-    if (u == 1) {
-#endif
+    lockpool();
+    int state = i->state;
+    unlockpool();
+    if (state == JOB_DONE) {
         //request is no longer running
         return 1;
     }else{
@@ -245,6 +469,34 @@ int img_CheckSuccess(void* handle) {
     }
 }
 
+void img_SetPriority(void* handle, int priority) {
+    if (!handle) {return;}
+    struct loaderthreadinfo* i = handle;
+    lockpool();
+    i->priority = priority;
+    if (i->state == JOB_QUEUED) {
+        // move the job to its new place in the queue
+        jobqueueup(i->queueindex);
+        jobqueuedown(i->queueindex);
+    }
+    unlockpool();
+}
+
+int img_CancelJob(void* handle) {
+    if (!handle) {return 0;}
+    struct loaderthreadinfo* i = handle;
+    lockpool();
+    if (i->state != JOB_QUEUED) {
+        // already running or done
+        unlockpool();
+        return 0;
+    }
+    jobqueueremove(i);
+    i->state = JOB_DONE;
+    unlockpool();
+    return 1;
+}
+
 void img_GetData(void* handle, char** path, int* imgwidth, int* imgheight, char** imgdata) {
     if (!handle) {
         *imgwidth = 0;
@@ -275,11 +527,6 @@ void img_FreeHandle(void* handle) {
     if (i->format) {free(i->format);}
     if (i->path) {free(i->path);}
     //if (i->data) {free(i->data);} //the user needs to do that!
-#ifdef WIN
-    CloseHandle(i->threadhandle);
-#else
-    //should be done by pthread_exit()
-#endif
     free(handle);
 }
 
@@ -290,7 +537,7 @@ static void img_Convert(char* data, int datasize, unsigned char firstchannelto,
         char oldlayout[4];
         memcpy(oldlayout, data + r, 4);
         *(char*)(data + r + firstchannelto) = oldlayout[0];
-        *(char*)(data + r + secondchannelto) = oldlayout[2];
+        *(char*)(data + r + secondchannelto) = oldlayout[1];
         *(char*)(data + r + thirdchannelto) = oldlayout[2];
         *(char*)(data + r + fourthchannelto) = oldlayout[3];
         r += 4;
@@ -21,12 +21,13 @@
 
 */
 
-void* img_LoadImageThreadedFromFile(const char* path, int maxwidth, int maxheight, const char* format, void(*callback)(void* handle, int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize));
+void* img_LoadImageThreadedFromFile(const char* path, int maxwidth, int maxheight, const char* format, int priority, void(*callback)(void* handle, int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize));
 // starts an asynchronous image load. you get back a job handle to check on the status of the job
 // parameters:
 //   - path: path to the file
 //   - maximumwidth/-height: maximum size restrictions (or 0 if any size is allowed) - this is recommended for not wasting too much memory! (e.g. so nobody will load a 50k x 50k image which might be a bad idea)
 //   - format: "rgba", "bgra" are valid parameters for now
+//   - priority: jobs with a higher priority are started first (see img_SetPriority), usually 0
 //   - callback: if you want to be called (in a separate thread!) when stuff is done, specify a function here. otherwise NULL
 //         callback parameters:
 //            - handle: the same thing this function also returns: the job handle. before returning from the callback, you might want to use img_FreeHandle() on it (if you don't want to use the handle somewhere else afterwards)
@@ -34,15 +35,25 @@ void* img_LoadImageThreadedFromFile(const char* path, int maxwidth, int maxheigh
 //            - imgdata: data area containing the raw 32bit rgba image data (or NULL if loading failed!) - you need to use free() on this yourself if not NULL!
 //            - imgdatasize: the size of the image data
 
-void* img_LoadImageThreadedFromMemory(const void* memdata, unsigned int memdatasize, int maxwidth, int maxheight, const char* format, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize));
+void* img_LoadImageThreadedFromMemory(const void* memdata, unsigned int memdatasize, int maxwidth, int maxheight, const char* format, int priority, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize));
 // same as img_LoadImageThreadedFromFile, but takes a memory pointer & size instead of a path to a file on disk
 
-void* img_LoadImageThreadedFromFunction(int (*readfunc)(void* buffer, size_t bytes, void* userdata), void* userdata, int maxwidth, int maxheight, const char* format, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize));
+void* img_LoadImageThreadedFromFunction(int (*readfunc)(void* buffer, size_t bytes, void* userdata), void* userdata, int maxwidth, int maxheight, const char* format, int priority, void(*callback)(int imgwidth, int imgheight, const char* imgdata, unsigned int imgdatasize));
 // same as img_LoadImageThreadedFromFile, but takes a function that will be called to load the file from disk
 
 int img_CheckSuccess(void* handle);
 // check on the progress of a job handle. Returns 1 if job is done (otherwise 0)
 
+void img_SetPriority(void* handle, int priority);
+// Change the priority of a job. Jobs are processed by a fixed amount of worker threads (one per CPU core):
+// jobs with a higher priority are started first, jobs with the same priority in the order they were added.
+// New jobs get the priority they were started with. This has no effect on jobs which have already been started.
+
+int img_CancelJob(void* handle);
+// Cancel a job which hasn't been started yet. Returns 1 if it was cancelled: the job then counts as done
+// (img_CheckSuccess returns 1) without any image data and the callback won't be called for it.
+// Returns 0 if the job is already running or done, in which case it will complete normally.
+
 void img_GetData(void* handle, char** path, int* imgwidth, int* imgheight, char** imgdata);
 // get the resulting raw image data of a _completed_ job.
 // Please note the behaviour is undefined if img_CheckSuccess doesn't return 1 on the handle (certainly including crashes/corruption!)
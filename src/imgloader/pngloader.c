@@ -36,7 +36,6 @@ struct loadpnginfo {
     png_structp png_ptr;
     png_infop info_ptr;
     void** row_pointers;
-    void* imgdat;
 };
 
 static int pngloader_CheckIfPng(const void* data, unsigned int datasize) {
@@ -67,9 +66,6 @@ void pngloader_FreeLoadInfo(struct loadpnginfo* linfo) {
         png_destroy_info_struct(linfo->png_ptr, &linfo->info_ptr);
         linfo->info_ptr = NULL;
     }
-    if (linfo->imgdat) {
-        free(linfo->imgdat);
-    }
     if (linfo->row_pointers) {
         free(linfo->row_pointers);
     }
@@ -86,8 +82,8 @@ int pngloader_AllocateMembers(struct loadpnginfo* linfo) {
     }
     return 1;
 }
-int pngloader_LoadRGBA(const char* pngdata, unsigned int pngdatasize, char** imagedata, unsigned int* imagedatasize, int* imagewidth, int* imageheight, int maxwidth, int maxheight) {
-    png_uint_32 width, height, channels;
+int pngloader_Load(const char* pngdata, unsigned int pngdatasize, int bgra, int maxwidth, int maxheight, void* (*getdestination)(void* userdata, int width, int height), void* userdata) {
+    png_uint_32 width, height;
     int bit_depth, color_type;
       
     //first check
@@ -109,9 +105,6 @@ int pngloader_LoadRGBA(const char* pngdata, unsigned int pngdatasize, char** ima
         return 0;
     }
     
-    // init structs - THIS IS NOT NEEDED so I believe
-    //png_read_init(linfo->png_ptr);
-    
     // set up a custom loader
     png_set_read_fn(linfo->png_ptr, linfo, readdata);
     //now read info stuff
@@ -123,88 +116,79 @@ int pngloader_LoadRGBA(const char* pngdata, unsigned int pngdatasize, char** ima
     if (maxwidth && width > maxwidth) {pngloader_FreeLoadInfo(linfo);return 0;}
     if (maxheight && height > maxheight) {pngloader_FreeLoadInfo(linfo);return 0;}
     
-    //some conversion stuff
-    channels = png_get_channels(linfo->png_ptr, linfo->info_ptr);
-    switch (color_type) {
-        case PNG_COLOR_TYPE_PALETTE:
-            png_set_palette_to_rgb(linfo->png_ptr);
-            channels = 3;
-            break;
-        case PNG_COLOR_TYPE_GRAY:
-            if (bit_depth < 8) {
-                png_set_gray_to_rgb(linfo->png_ptr);
-                bit_depth = 8;
-            }
-            break;
-        case PNG_COLOR_TYPE_GRAY_ALPHA:
-            if (bit_depth < 8) {
-                png_set_gray_to_rgb(linfo->png_ptr);
-                bit_depth = 8;
-            }
-            break;
-    }
-    if (png_get_valid(linfo->png_ptr, linfo->info_ptr, PNG_INFO_tRNS)) {
-        png_set_tRNS_to_alpha(linfo->png_ptr);
-        channels+=1;
-    }
-    if (bit_depth == 16) {png_set_strip_16(linfo->png_ptr);bit_depth = 8;}
-    if (bit_depth != 8) {
-        pngloader_FreeLoadInfo(linfo);return 0; // we don't support this :( sorry
+    //let libpng transform every row into 8 bit RGBA (or BGRA) while
+    //decoding, so the rows can go straight into their final place:
+    png_set_expand(linfo->png_ptr); //palette, low bit depth gray, tRNS
+    if (color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(linfo->png_ptr);
+    }
+    if (bit_depth == 16) {png_set_strip_16(linfo->png_ptr);}
+    if (!(color_type & PNG_COLOR_MASK_ALPHA) && !png_get_valid(linfo->png_ptr, linfo->info_ptr, PNG_INFO_tRNS)) {
+        png_set_filler(linfo->png_ptr, 0xff, PNG_FILLER_AFTER); //opaque alpha
     }
-    if (channels != 3 && channels != 4) {
-        pngloader_FreeLoadInfo(linfo);return 0; //we don't support this :( sorry
+    if (bgra) {
+        png_set_bgr(linfo->png_ptr);
     }
     png_read_update_info(linfo->png_ptr, linfo->info_ptr);
+    if (png_get_bit_depth(linfo->png_ptr, linfo->info_ptr) != 8 || png_get_rowbytes(linfo->png_ptr, linfo->info_ptr) != width * 4) {
+        pngloader_FreeLoadInfo(linfo);return 0; // we don't support this :( sorry
+    }
     
     //ok let's get it - preparations..
     linfo->row_pointers = malloc(height*sizeof(void*)); //row pointers libpng wants for some odd reason
     if (!linfo->row_pointers) {
         pngloader_FreeLoadInfo(linfo);return 0;
     }
-    linfo->imgdat = malloc(channels * width * height); //img data
-    if (!linfo->imgdat) {
+    char* destination = getdestination(userdata, width, height);
+    if (!destination) {
         pngloader_FreeLoadInfo(linfo);return 0;
     }
     int r = 0;
     while (r < height) {
-        linfo->row_pointers[r] = linfo->imgdat + channels * width * r;
+        linfo->row_pointers[r] = destination + width * 4 * r;
         r++;
     }
     
     //loading the image! yeaaa...
     png_read_image(linfo->png_ptr, (png_bytepp)linfo->row_pointers);
     
-    free(linfo->row_pointers); linfo->row_pointers = NULL;
-    
-    //if we have just 3 channels, we really want to expand to 4!
-    if (channels == 3) {
-        void* newimgdat = malloc(4 * width * height);
-        if (!newimgdat) {
-            pngloader_FreeLoadInfo(linfo);printf("cannot allocate new info\n");return 0;
-        }
-        //ugly conversion stuff :p
-        r = 0;
-        while (r < height) {
-            int k = 0;
-            while (k < width) {
-                memcpy(k*4 + r * width*4 + newimgdat, k*3 + r*width*3 + linfo->imgdat, 3); //copy the three channels we got
-                ((char*)newimgdat)[k*4+r*width*4+3] = 255; //set alpha to opaque
-                k++;
-            }
-            r++;
-        }
-        //converted!
-        free(linfo->imgdat);
-        linfo->imgdat = newimgdat;
-        channels = 4;
+    pngloader_FreeLoadInfo(linfo);
+    return 1;
+}
+
+struct loadrgbainfo {
+    char* imgdat;
+    unsigned int imgdatsize;
+    int width;
+    int height;
+};
+
+static void* pngloader_AllocateRGBA(void* userdata, int width, int height) {
+    struct loadrgbainfo* info = userdata;
+    info->imgdatsize = width * height * 4;
+    info->imgdat = malloc(info->imgdatsize);
+    info->width = width;
+    info->height = height;
+    return info->imgdat;
+}
+
+int pngloader_LoadRGBA(const char* pngdata, unsigned int pngdatasize, char** imagedata, unsigned int* imagedatasize, int* imagewidth, int* imageheight, int maxwidth, int maxheight) {
+    return pngloader_LoadRGBAorBGRA(pngdata, pngdatasize, 0, imagedata, imagedatasize, imagewidth, imageheight, maxwidth, maxheight);
+}
+
+int pngloader_LoadRGBAorBGRA(const char* pngdata, unsigned int pngdatasize, int bgra, char** imagedata, unsigned int* imagedatasize, int* imagewidth, int* imageheight, int maxwidth, int maxheight) {
+    struct loadrgbainfo info;
+    memset(&info, 0, sizeof(info));
+    if (!pngloader_Load(pngdata, pngdatasize, bgra, maxwidth, maxheight, &pngloader_AllocateRGBA, &info)) {
+        //a destination might have been allocated before libpng bailed out
+        if (info.imgdat) {free(info.imgdat);}
+        return 0;
     }
     
-    //ok cleanup and export this
-    *imagedatasize = channels * width * height;
-    *imagedata = linfo->imgdat;linfo->imgdat = NULL; //of course we want to keep that
-    *imagewidth = width;
-    *imageheight = height;
-    
-    pngloader_FreeLoadInfo(linfo);
+    //ok export this
+    *imagedatasize = info.imgdatsize;
+    *imagedata = info.imgdat;
+    *imagewidth = info.width;
+    *imageheight = info.height;
     return 1;
 }
@@ -24,3 +24,18 @@
 //This function will be used by the image (imgloader.c). You are advised to use the imgloader, not this function directly.
 int pngloader_LoadRGBA(const char* pngdata, unsigned int pngdatasize, char** imagedata, unsigned int* imagedatasize,
 int* imagewidth, int* imageheight, int maxwidth, int maxheight);
+
+//Same as pngloader_LoadRGBA, but with bgra set to 1 the image is returned in BGRA channel order.
+int pngloader_LoadRGBAorBGRA(const char* pngdata, unsigned int pngdatasize, int bgra, char** imagedata, unsigned int* imagedatasize,
+int* imagewidth, int* imageheight, int maxwidth, int maxheight);
+
+//Decode a png image row by row straight into a destination of your choice.
+//getdestination is called once the image size is known and returns where the
+//first row should go (or NULL to abort). The rows follow each other without
+//any padding, width*4 bytes each.
+//The rows are written as 8 bit RGBA (or BGRA if bgra is 1), the channel order
+//is converted by libpng while decoding.
+//If decoding fails after getdestination was called, the destination contents
+//are undefined and freeing it is up to you.
+int pngloader_Load(const char* pngdata, unsigned int pngdatasize, int bgra, int maxwidth, int maxheight,
+void* (*getdestination)(void* userdata, int width, int height), void* userdata);
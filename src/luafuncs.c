@@ -462,7 +462,9 @@ int luafuncs_loadImage(lua_State* l) {
         lua_pushstring(l, "Failed to load image");
         return lua_error(l);
     }
-    return 0;
+    // return the texture handle which can be used instead of the name:
+    lua_pushnumber(l, graphics_GetTextureHandle(p));
+    return 1;
 #else // ifdef USE_GRAPHICS
     lua_pushstring(l, compiled_without_graphics);
     return lua_error(l);
@@ -476,7 +478,12 @@ int luafuncs_loadImageAsync(lua_State* l) {
         lua_pushstring(l, "First parameter is not a valid image name string");
         return lua_error(l);
     }
-    int i = graphics_PromptTextureLoading(p);
+    // optional priority: images with higher priority are loaded first
+    int priority = 0;
+    if (lua_gettop(l) >= 2 && lua_type(l, 2) == LUA_TNUMBER) {
+        priority = (int)lua_tonumber(l, 2);
+    }
+    int i = graphics_PromptTextureLoading(p, priority);
     if (i == 0) {
         lua_pushstring(l, "Failed to load image due to fatal error: Out of memory?");
         return lua_error(l);
@@ -485,7 +492,8 @@ int luafuncs_loadImageAsync(lua_State* l) {
         lua_pushstring(l, "Image is already loaded");
         return lua_error(l);
     }
-    return 0;
+    lua_pushnumber(l, graphics_GetTextureHandle(p));
+    return 1;
 #else // ifdef USE_GRAPHICS
     lua_pushstring(l, compiled_without_graphics);
     return lua_error(l);
@@ -593,13 +601,19 @@ int luafuncs_sleep(lua_State* l) {
 
 int luafuncs_getImageSize(lua_State* l) {
 #ifdef USE_GRAPHICS
-    const char* p = lua_tostring(l,1);
-    if (!p) {
-        lua_pushstring(l, "First parameter is not a valid image name string");
-        return lua_error(l);
+    int texture = 0;
+    if (lua_type(l, 1) == LUA_TNUMBER) {
+        texture = (int)lua_tonumber(l, 1);
+    }else{
+        const char* p = lua_tostring(l,1);
+        if (!p) {
+            lua_pushstring(l, "First parameter is not a valid image name string or handle");
+            return lua_error(l);
+        }
+        texture = graphics_GetTextureHandle(p);
     }
     unsigned int w,h;
-    if (!graphics_GetTextureDimensions(p, &w,&h)) {
+    if (!graphics_GetTextureDimensionsByHandle(texture, &w,&h)) {
         lua_pushstring(l, "Failed to get image size");
         return lua_error(l);
     }
@@ -716,6 +730,18 @@ void luafuncs_pushnosuchtex(lua_State* l, const char* tex) {
     errmsg[sizeof(errmsg)-1] = 0;
     lua_pushstring(l, errmsg);
 }
+
+static void luafuncs_pushnosuchtexorhandle(lua_State* l, const char* tex, int texture) {
+    // report the texture by name if we have it, otherwise by handle:
+    if (tex) {
+        luafuncs_pushnosuchtex(l, tex);
+        return;
+    }
+    char errmsg[512];
+    snprintf(errmsg,sizeof(errmsg), "Requested texture handle %d isn't loaded or available", texture);
+    errmsg[sizeof(errmsg)-1] = 0;
+    lua_pushstring(l, errmsg);
+}
 #endif
 
 // Helper function to obtain a setting on a settings table at stack pos -1
@@ -747,9 +773,18 @@ static int gettablesetting(lua_State* l, const char* name, int type) {
 
 int luafuncs_drawImage(lua_State* l) {
 #ifdef USE_GRAPHICS
-    const char* p = lua_tostring(l,1);
-    if (!p) {
-        return haveluaerror(l, badargument1, 1, "blitwiz.graphics.drawImage", "string", lua_strtype(l, 1));
+    // the image can be given by name or by the handle loadImage returned.
+    // Look it up once here, everything below works with the handle:
+    const char* p = NULL;
+    int texture = 0;
+    if (lua_type(l, 1) == LUA_TNUMBER) {
+        texture = (int)lua_tonumber(l, 1);
+    }else{
+        p = lua_tostring(l,1);
+        if (!p) {
+            return haveluaerror(l, badargument1, 1, "blitwiz.graphics.drawImage", "string or number", lua_strtype(l, 1));
+        }
+        texture = graphics_GetTextureHandle(p);
     }
 
     if (!drawingallowed) {
@@ -829,7 +864,7 @@ int luafuncs_drawImage(lua_State* l) {
     int rotationcentery = 0;
     // make rotation center default to image center
     unsigned int imgw,imgh;
-    if (graphics_GetTextureDimensions(p, &imgw, &imgh)) {
+    if (graphics_GetTextureDimensionsByHandle(texture, &imgw, &imgh)) {
         rotationcenterx = imgw/2;
         rotationcentery = imgh/2;
     }
@@ -896,8 +931,8 @@ int luafuncs_drawImage(lua_State* l) {
 
     // empty draw calls aren't possible, but we will "emulate" it to provide an error on a missing texture anyway
     if (scalex <= 0 || scaley <= 0 || cutwidth == 0 || cutheight == 0) {
-        if (!graphics_IsTextureLoaded(p)) {
-            luafuncs_pushnosuchtex(l, p);
+        if (!graphics_IsTextureLoadedByHandle(texture)) {
+            luafuncs_pushnosuchtexorhandle(l, p, texture);
             return lua_error(l);
         }
     }
@@ -910,7 +945,7 @@ int luafuncs_drawImage(lua_State* l) {
 
     if (imgdraww == 0 || imgdrawh == 0) {
         unsigned int w,h;
-        if (graphics_GetTextureDimensions(p, &w, &h)) {
+        if (graphics_GetTextureDimensionsByHandle(texture, &w, &h)) {
             if (imgdraww == 0) {imgdraww = w;}
             if (imgdrawh == 0) {imgdrawh = h;}
         }
@@ -919,8 +954,8 @@ int luafuncs_drawImage(lua_State* l) {
     unsigned int drawheight = (unsigned int)((float)(imgdrawh) * scaley + 0.5f);
 
     // draw:
-    if (!graphicsrender_DrawCropped(p, x, y, alpha, cutx, cuty, cutwidth, cutheight, drawwidth, drawheight, rotationcenterx, rotationcentery, rotationangle, horiflipped, red, green, blue)) {
-        luafuncs_pushnosuchtex(l, p);
+    if (!graphicsrender_DrawCroppedByHandle(texture, x, y, alpha, cutx, cuty, cutwidth, cutheight, drawwidth, drawheight, rotationcenterx, rotationcentery, rotationangle, horiflipped, red, green, blue)) {
+        luafuncs_pushnosuchtexorhandle(l, p, texture);
         return lua_error(l);
     }
     return 0;
@@ -1034,6 +1069,55 @@ int luafuncs_getBackendName(lua_State* l) {
 #endif
 }
 
+int luafuncs_setTargetLatency(lua_State* l) {
+#ifdef USE_AUDIO
+    if (lua_type(l, 1) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwiz.audio.setTargetLatency", "number", lua_strtype(l, 1));
+    }
+    int latency = lua_tointeger(l, 1);
+    if (latency < 0) {
+        return haveluaerror(l, badargument2, 1,
+        "blitwiz.audio.setTargetLatency", "latency cannot be negative");
+    }
+    main_SetAudioLatency(latency);
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+int luafuncs_getLatencyInfo(lua_State* l) {
+#ifdef USE_AUDIO
+    main_InitAudio();
+    struct audiostats stats;
+    memset(&stats, 0, sizeof(stats));
+#if defined(USE_SDL_AUDIO) || defined(WINDOWS)
+    audio_GetStats(&stats);
+#endif
+    // return a table with latency (ms), underruns (count)
+    // and callbackTime/callbackTimePeak (ms):
+    lua_newtable(l);
+    lua_pushstring(l, "latency");
+    lua_pushnumber(l, stats.latency);
+    lua_settable(l, -3);
+    lua_pushstring(l, "underruns");
+    lua_pushnumber(l, stats.underruns);
+    lua_settable(l, -3);
+    lua_pushstring(l, "callbackTime");
+    lua_pushnumber(l, stats.callbacktime / 1000.0);
+    lua_settable(l, -3);
+    lua_pushstring(l, "callbackTimePeak");
+    lua_pushnumber(l, stats.callbacktimepeak / 1000.0);
+    lua_settable(l, -3);
+    return 1;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
 int luafuncs_openConsole(lua_State* intentionally_unused) {
     win32console_Launch();
     return 0;
@@ -1185,7 +1269,7 @@ int luafuncs_adjust(lua_State* l) {
     memset(iref,0,sizeof(*iref));
     iref->magic = IDREF_MAGIC;
     iref->type = IDREF_SOUND;
-    iref->ref.id = audiomixer_PlaySoundFromDisk(p, priority, volume, panning, 0, fadein, looping);
+    iref->ref.id = audiomixer_PlaySoundFromDisk(p, priority, AUDIOMIXER_BUS_SFX, volume, panning, 0, fadein, looping);
     if (iref->ref.id < 0) {
         char errormsg[512];
         snprintf(errormsg, sizeof(errormsg), "Cannot play sound \"%s\"", p);
@@ -69,6 +69,8 @@ int luafuncs_play(lua_State* l);
 int luafuncs_playing(lua_State* l);
 int luafuncs_stop(lua_State* l);
 int luafuncs_adjust(lua_State* l);
+int luafuncs_setTargetLatency(lua_State* l);
+int luafuncs_getLatencyInfo(lua_State* l);
 
 // Strings:
 int luafuncs_startswith(lua_State* l);
@@ -42,17 +42,82 @@
 // @license zlib
 // @module blitwizard.audio
 
+#include "os.h"
 #include "luafuncs_media_object.h"
 #include "luaheader.h"
 #include "luastate.h"
 #include "luaerror.h"
+#include "audio.h"
+#include "audiomixer.h"
+#include "main.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 struct mediaobject* mediaObjects = NULL;
 
 static int garbagecollect_mediaobjref(lua_State* l);
+static void mediaobject_UpdateIsPlaying(struct mediaobject* o);
+
+#ifdef USE_AUDIO
+static int mediaobject_BusFromStack(lua_State* l, int index, int argno,
+        const char* funcname) {
+    // get the mix bus from a bus name argument. returns -1 after
+    // raising a lua error if the name is invalid:
+    if (lua_type(l, index) != LUA_TSTRING) {
+        haveluaerror(l, badargument1, argno, funcname, "string",
+        lua_strtype(l, index));
+        return -1;
+    }
+    int bus = audiomixer_GetBusByName(lua_tostring(l, index));
+    if (bus < 0) {
+        haveluaerror(l, badargument2, argno, funcname,
+        "unknown bus (expected \"music\", \"sfx\", \"ui\" or \"voice\")");
+        return -1;
+    }
+    return bus;
+}
+#endif
+
+static const char* mediaobject_FuncName(int type, const char* func) {
+    // name of the lua function for error messages:
+    static char name[64];
+    const char* typename = "???";
+    switch (type) {
+    case MEDIA_TYPE_AUDIO_SIMPLE:
+        typename = "simpleSound";
+        break;
+    case MEDIA_TYPE_AUDIO_PANNED:
+        typename = "pannedSound";
+        break;
+    case MEDIA_TYPE_AUDIO_POSITIONED:
+        typename = "positionedSound";
+        break;
+    }
+    snprintf(name, sizeof(name), "blitwizard.audio.%s:%s", typename, func);
+    name[sizeof(name)-1] = 0;
+    return name;
+}
+
+static struct mediaobject* mediaobject_FromStack(lua_State* l, int type, const char* func) {
+    // the sound object is the implicit first argument of a : call
+    if (lua_type(l, 1) != LUA_TUSERDATA) {
+        haveluaerror(l, badargument1, 1, mediaobject_FuncName(type, func),
+        "sound object", lua_strtype(l, 1));
+        return NULL;
+    }
+    struct luaidref* idref = lua_touserdata(l, 1);
+    if (!idref || idref->magic != IDREF_MAGIC
+    || idref->type != IDREF_MEDIA) {
+        haveluaerror(l, badargument1, 1, mediaobject_FuncName(type, func),
+        "sound object", "invalid userdata");
+        return NULL;
+    }
+    return idref->ref.mobj;
+}
+
 int luafuncs_media_object_new(lua_State* l, int type) {
     // check which function called us:
     char funcname_simple[] = "blitwizard.audio.simpleSound:new";
@@ -89,6 +154,23 @@ int luafuncs_media_object_new(lua_State* l, int type) {
         return haveluaerror(l, "Sound file \"%s\" not found", p);
     }
 
+    // optional second argument is the mix bus:
+    int bus = AUDIOMIXER_BUS_SFX;
+#ifdef USE_AUDIO
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        bus = mediaobject_BusFromStack(l, 3, 2, funcname);
+        if (bus < 0) {
+            return 0;
+        }
+    }
+#endif
+
+    // remember the file name for playing it:
+    char* soundname = strdup(p);
+    if (!soundname) {
+        return haveluaerror(l, "Failed to allocate media object");
+    }
+
     // generate new sound object:
     struct luaidref* iref = lua_newuserdata(l, sizeof(*iref));
     memset(iref, 0, sizeof(*iref));
@@ -96,6 +178,7 @@ int luafuncs_media_object_new(lua_State* l, int type) {
     iref->type = IDREF_MEDIA;
     iref->ref.mobj = malloc(sizeof(struct mediaobject));
     if (!iref->ref.mobj) {
+        free(soundname);
         lua_pop(l, 1);
         return haveluaerror(l, "Failed to allocate media object");
     }
@@ -104,6 +187,17 @@ int luafuncs_media_object_new(lua_State* l, int type) {
     memset(m, 0, sizeof(*m));
     m->type = type;
     m->refcount++;
+    m->mediainfo.sound.volume = 1;
+    m->mediainfo.sound.soundname = soundname;
+    m->mediainfo.sound.bus = bus;
+
+    // make obj:play() etc. resolve to the functions of the class table
+    // which :new was called on:
+    lua_getmetatable(l, -1);
+    lua_pushstring(l, "__index");
+    lua_pushvalue(l, 1);
+    lua_rawset(l, -3);
+    lua_pop(l, 1);
 
     // set proper default priority:
     switch (type) {
@@ -128,19 +222,663 @@ int luafuncs_media_object_new(lua_State* l, int type) {
 }
 
 int luafuncs_media_object_play(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    struct mediaobject* m = mediaobject_FromStack(l, type, "play");
+    if (!m) {
+        return 0;
+    }
+    const char* funcname = mediaobject_FuncName(type, "play");
+
+    // panned sounds take the panning as second parameter:
+    int arg = 2;
+    float volume = 1;
+    float panning = 0;
+    int loop = 0;
+    float fadein = -1;
+    if (lua_gettop(l) >= arg && lua_type(l, arg) != LUA_TNIL) {
+        if (lua_type(l, arg) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, arg - 1, funcname,
+            "number", lua_strtype(l, arg));
+        }
+        volume = lua_tonumber(l, arg);
+    }
+    arg++;
+    if (type == MEDIA_TYPE_AUDIO_PANNED) {
+        if (lua_gettop(l) >= arg && lua_type(l, arg) != LUA_TNIL) {
+            if (lua_type(l, arg) != LUA_TNUMBER) {
+                return haveluaerror(l, badargument1, arg - 1, funcname,
+                "number", lua_strtype(l, arg));
+            }
+            panning = lua_tonumber(l, arg);
+        }
+        arg++;
+    }
+    if (lua_gettop(l) >= arg && lua_type(l, arg) != LUA_TNIL) {
+        if (lua_type(l, arg) != LUA_TBOOLEAN) {
+            return haveluaerror(l, badargument1, arg - 1, funcname,
+            "boolean", lua_strtype(l, arg));
+        }
+        loop = lua_toboolean(l, arg);
+    }
+    arg++;
+    if (lua_gettop(l) >= arg && lua_type(l, arg) != LUA_TNIL) {
+        if (lua_type(l, arg) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, arg - 1, funcname,
+            "number", lua_strtype(l, arg));
+        }
+        fadein = lua_tonumber(l, arg);
+        if (fadein <= 0) {
+            fadein = -1;
+        }
+    }
+    if (volume < 0) {
+        volume = 0;
+    }
+    if (volume > 1) {
+        volume = 1;
+    }
+    if (panning < -1) {
+        panning = -1;
+    }
+    if (panning > 1) {
+        panning = 1;
+    }
+
+    // a sound object plays only once at a time:
+    mediaobject_UpdateIsPlaying(m);
+    if (m->isPlaying) {
+        return 0;
+    }
+
+    main_InitAudio();
+    int id;
+    if (type == MEDIA_TYPE_AUDIO_POSITIONED) {
+        // the mixer pans and attenuates it according to its position:
+        id = audiomixer_PlayPositionedSoundFromDisk(
+        m->mediainfo.sound.soundname, m->mediainfo.sound.priority,
+        m->mediainfo.sound.bus, volume, (float)m->mediainfo.sound.x,
+        (float)m->mediainfo.sound.y, (float)m->mediainfo.sound.z,
+        fadein, loop);
+    }else{
+        // simple sounds skip the panning/amplification postprocessing:
+        id = audiomixer_PlaySoundFromDisk(m->mediainfo.sound.soundname,
+        m->mediainfo.sound.priority, m->mediainfo.sound.bus, volume,
+        panning, (type == MEDIA_TYPE_AUDIO_SIMPLE), fadein, loop);
+    }
+    if (id < 0) {
+        return haveluaerror(l, "Cannot play sound \"%s\"",
+        m->mediainfo.sound.soundname);
+    }
+    m->mediainfo.sound.soundid = id;
+    m->mediainfo.sound.volume = volume;
+    m->mediainfo.sound.panning = panning;
+    m->isPlaying = 1;
     return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
 }
 
 int luafuncs_media_object_stop(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    struct mediaobject* m = mediaobject_FromStack(l, type, "stop");
+    if (!m) {
+        return 0;
+    }
+    float fadeout = 0;
+    if (lua_gettop(l) >= 2 && lua_type(l, 2) != LUA_TNIL) {
+        if (lua_type(l, 2) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 1,
+            mediaobject_FuncName(type, "stop"), "number",
+            lua_strtype(l, 2));
+        }
+        fadeout = lua_tonumber(l, 2);
+    }
+    mediaobject_UpdateIsPlaying(m);
+    if (!m->isPlaying) {
+        return 0;
+    }
+    if (fadeout > 0) {
+        // the mix clock counts frames at 48kHz:
+        audiomixer_FadeSoundAt(m->mediainfo.sound.soundid,
+        audiomixer_GetMixClock(), (unsigned int)(fadeout * 48000),
+        0, 1);
+    } else {
+        audiomixer_StopSound(m->mediainfo.sound.soundid);
+        m->isPlaying = 0;
+    }
     return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
 }
 
 int luafuncs_media_object_setPriority(lua_State* l, int type) {
+    struct mediaobject* m = mediaobject_FromStack(l, type, "setPriority");
+    if (!m) {
+        return 0;
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        mediaobject_FuncName(type, "setPriority"), "number",
+        lua_strtype(l, 2));
+    }
+    int priority = (int)floor(lua_tonumber(l, 2));
+    if (priority < 0) {
+        priority = 0;
+    }
+    if (priority > 20) {
+        priority = 20;
+    }
+    m->mediainfo.sound.priority = priority;
     return 0;
 }
 
 int luafuncs_media_object_adjust(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    struct mediaobject* m = mediaobject_FromStack(l, type, "adjust");
+    if (!m) {
+        return 0;
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        mediaobject_FuncName(type, "adjust"), "number",
+        lua_strtype(l, 2));
+    }
+    float volume = lua_tonumber(l, 2);
+    if (volume < 0) {
+        volume = 0;
+    }
+    if (volume > 1) {
+        volume = 1;
+    }
+    mediaobject_UpdateIsPlaying(m);
+    if (!m->isPlaying) {
+        return 0;
+    }
+    m->mediainfo.sound.volume = volume;
+    audiomixer_AdjustSound(m->mediainfo.sound.soundid, volume,
+    m->mediainfo.sound.panning, (type != MEDIA_TYPE_AUDIO_PANNED));
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+int luafuncs_media_object_setPosition(lua_State* l, int type) {
+    struct mediaobject* m = mediaobject_FromStack(l, type, "setPosition");
+    if (!m) {
+        return 0;
+    }
+    const char* funcname = mediaobject_FuncName(type, "setPosition");
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, funcname, "number",
+        lua_strtype(l, 2));
+    }
+    if (lua_type(l, 3) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2, funcname, "number",
+        lua_strtype(l, 3));
+    }
+    double z = 0;
+    if (lua_gettop(l) >= 4 && lua_type(l, 4) != LUA_TNIL) {
+        if (lua_type(l, 4) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3, funcname, "number",
+            lua_strtype(l, 4));
+        }
+        z = lua_tonumber(l, 4);
+        m->mediainfo.sound.is3d = 1;
+    }
+    m->mediainfo.sound.x = lua_tonumber(l, 2);
+    m->mediainfo.sound.y = lua_tonumber(l, 3);
+    m->mediainfo.sound.z = z;
+#ifdef USE_AUDIO
+    mediaobject_UpdateIsPlaying(m);
+    if (m->isPlaying) {
+        float position[3];
+        position[0] = m->mediainfo.sound.x;
+        position[1] = m->mediainfo.sound.y;
+        position[2] = m->mediainfo.sound.z;
+        audiomixer_SetSoundPositions(1, &m->mediainfo.sound.soundid,
+        position);
+    }
+#endif
+    return 0;
+}
+
+#ifdef USE_AUDIO
+static uint64_t mediaobject_SecondsToClock(double seconds) {
+    // the mix clock counts frames at 48kHz:
+    if (seconds <= 0) {
+        return 0;
+    }
+    return (uint64_t)(seconds * 48000 + 0.5);
+}
+#endif
+
+int luafuncs_media_object_schedule(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    struct mediaobject* m = mediaobject_FromStack(l, type, "schedule");
+    if (!m) {
+        return 0;
+    }
+    const char* funcname = mediaobject_FuncName(type, "schedule");
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1, funcname, "number",
+        lua_strtype(l, 2));
+    }
+    uint64_t startclock = mediaobject_SecondsToClock(lua_tonumber(l, 2));
+    float volume = 1;
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 2, funcname, "number",
+            lua_strtype(l, 3));
+        }
+        volume = lua_tonumber(l, 3);
+    }
+    int loop = 0;
+    if (lua_gettop(l) >= 4 && lua_type(l, 4) != LUA_TNIL) {
+        if (lua_type(l, 4) != LUA_TBOOLEAN) {
+            return haveluaerror(l, badargument1, 3, funcname, "boolean",
+            lua_strtype(l, 4));
+        }
+        loop = lua_toboolean(l, 4);
+    }
+    unsigned int fadeinframes = 0;
+    if (lua_gettop(l) >= 5 && lua_type(l, 5) != LUA_TNIL) {
+        if (lua_type(l, 5) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 4, funcname, "number",
+            lua_strtype(l, 5));
+        }
+        fadeinframes = mediaobject_SecondsToClock(lua_tonumber(l, 5));
+    }
+    if (volume < 0) {
+        volume = 0;
+    }
+    if (volume > 1) {
+        volume = 1;
+    }
+
+    // a sound object plays only once at a time:
+    mediaobject_UpdateIsPlaying(m);
+    if (m->isPlaying) {
+        return 0;
+    }
+
+    main_InitAudio();
+    int id = audiomixer_ScheduleSoundFromDisk(m->mediainfo.sound.soundname,
+    m->mediainfo.sound.priority, m->mediainfo.sound.bus, volume, loop,
+    startclock, fadeinframes);
+    if (id < 0) {
+        return haveluaerror(l, "Cannot play sound \"%s\"",
+        m->mediainfo.sound.soundname);
+    }
+    m->mediainfo.sound.soundid = id;
+    m->mediainfo.sound.volume = volume;
+    m->isPlaying = 1;
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+int luafuncs_media_object_crossfade(lua_State* l, int type) {
+#ifdef USE_AUDIO
+    struct mediaobject* m = mediaobject_FromStack(l, type, "crossfade");
+    if (!m) {
+        return 0;
+    }
+    const char* funcname = mediaobject_FuncName(type, "crossfade");
+
+    // the sound we fade from can be any sound object:
+    struct luaidref* idref = NULL;
+    if (lua_type(l, 2) == LUA_TUSERDATA) {
+        idref = lua_touserdata(l, 2);
+    }
+    if (!idref || idref->magic != IDREF_MAGIC
+    || idref->type != IDREF_MEDIA) {
+        return haveluaerror(l, badargument1, 1, funcname, "sound object",
+        lua_strtype(l, 2));
+    }
+    struct mediaobject* from = idref->ref.mobj;
+    if (lua_type(l, 3) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2, funcname, "number",
+        lua_strtype(l, 3));
+    }
+    unsigned int fadeframes = mediaobject_SecondsToClock(
+    lua_tonumber(l, 3));
+    float volume = 1;
+    if (lua_gettop(l) >= 4 && lua_type(l, 4) != LUA_TNIL) {
+        if (lua_type(l, 4) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3, funcname, "number",
+            lua_strtype(l, 4));
+        }
+        volume = lua_tonumber(l, 4);
+    }
+    int loop = 0;
+    if (lua_gettop(l) >= 5 && lua_type(l, 5) != LUA_TNIL) {
+        if (lua_type(l, 5) != LUA_TBOOLEAN) {
+            return haveluaerror(l, badargument1, 4, funcname, "boolean",
+            lua_strtype(l, 5));
+        }
+        loop = lua_toboolean(l, 5);
+    }
+    uint64_t startclock = 0;
+    if (lua_gettop(l) >= 6 && lua_type(l, 6) != LUA_TNIL) {
+        if (lua_type(l, 6) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 5, funcname, "number",
+            lua_strtype(l, 6));
+        }
+        startclock = mediaobject_SecondsToClock(lua_tonumber(l, 6));
+    }
+    if (volume < 0) {
+        volume = 0;
+    }
+    if (volume > 1) {
+        volume = 1;
+    }
+
+    mediaobject_UpdateIsPlaying(m);
+    if (m->isPlaying || from == m) {
+        return 0;
+    }
+
+    // if the other sound doesn't play, this simply fades in:
+    int oldid = -1;
+    mediaobject_UpdateIsPlaying(from);
+    if (from->isPlaying) {
+        oldid = from->mediainfo.sound.soundid;
+    }
+
+    main_InitAudio();
+    int id = audiomixer_CrossfadeSoundFromDisk(oldid,
+    m->mediainfo.sound.soundname, m->mediainfo.sound.priority,
+    m->mediainfo.sound.bus, volume, loop, startclock, fadeframes);
+    if (id < 0) {
+        return haveluaerror(l, "Cannot play sound \"%s\"",
+        m->mediainfo.sound.soundname);
+    }
+    m->mediainfo.sound.soundid = id;
+    m->mediainfo.sound.volume = volume;
+    m->isPlaying = 1;
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+/// Get the time of the mix clock in seconds. The mix clock counts the
+// audio mixed so far with sample precision and doesn't drift from the
+// audio output like the game time does, so use it to line up
+// @{blitwizard.audio.simpleSound:schedule|scheduled} sounds and
+// @{blitwizard.audio.simpleSound:crossfade|crossfades} exactly,
+// e.g. to the beat of music which plays already.
+// @function getMixClock
+// @treturn number mix clock time in seconds
+// @usage -- start a sound exactly one second from now:
+// mysound:schedule(blitwiz.audio.getMixClock() + 1)
+
+int luafuncs_media_getMixClock(lua_State* l) {
+#ifdef USE_AUDIO
+    main_InitAudio();
+    lua_pushnumber(l, (double)audiomixer_GetMixClock() / 48000.0);
+    return 1;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+/// Set the position of the listener (usually the camera or the
+// player character) which @{blitwizard.audio.positionedSound|positioned
+// sounds} are heard from. The default position is 0, 0, 0.
+// @function setListenerPosition
+// @tparam number x X coordinate
+// @tparam number y Y coordinate
+// @tparam number z (optional) Z coordinate for 3d games, defaults to 0
+
+int luafuncs_media_setListenerPosition(lua_State* l) {
+#ifdef USE_AUDIO
+    if (lua_type(l, 1) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.audio.setListenerPosition", "number",
+        lua_strtype(l, 1));
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2,
+        "blitwizard.audio.setListenerPosition", "number",
+        lua_strtype(l, 2));
+    }
+    float z = 0;
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3,
+            "blitwizard.audio.setListenerPosition", "number",
+            lua_strtype(l, 3));
+        }
+        z = lua_tonumber(l, 3);
+    }
+    main_InitAudio();
+    audiomixer_SetListenerPosition(lua_tonumber(l, 1), lua_tonumber(l, 2),
+    z);
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+#ifdef USE_AUDIO
+// batch buffers for setSoundPositions, reused across calls:
+static int* batchids = NULL;
+static float* batchpositions = NULL;
+static int batchsize = 0;
+#endif
+
+/// Move many @{blitwizard.audio.positionedSound|positioned sounds}
+// at once. This is much faster than calling
+// @{blitwizard.audio.positionedSound:setPosition|setPosition} for each
+// of them, so use it to update all moving sounds once per frame.
+// @function setSoundPositions
+// @tparam table positions A list with four entries for each sound: the positioned sound object, followed by its new x, y and z coordinates
+// @usage -- move two sounds:
+// blitwizard.audio.setSoundPositions({sound1, 5, 2, 0, sound2, -3, 1, 0})
+
+int luafuncs_media_setSoundPositions(lua_State* l) {
+#ifdef USE_AUDIO
+    if (lua_type(l, 1) != LUA_TTABLE) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.audio.setSoundPositions", "table", lua_strtype(l, 1));
+    }
+    int entries = lua_rawlen(l, 1);
+    if (entries % 4 != 0) {
+        return haveluaerror(l, badargument2, 1,
+        "blitwizard.audio.setSoundPositions",
+        "needs four entries (sound, x, y, z) for each sound");
+    }
+    int count = entries / 4;
+    if (count > batchsize) {
+        int* newids = realloc(batchids, sizeof(int) * count);
+        if (!newids) {
+            return haveluaerror(l, "Out of memory");
+        }
+        batchids = newids;
+        float* newpositions = realloc(batchpositions,
+        sizeof(float) * 3 * count);
+        if (!newpositions) {
+            return haveluaerror(l, "Out of memory");
+        }
+        batchpositions = newpositions;
+        batchsize = count;
+    }
+
+    // collect the playing sounds and remember all positions:
+    int playing = 0;
+    int i = 0;
+    while (i < count) {
+        lua_rawgeti(l, 1, i * 4 + 1);
+        struct luaidref* idref = NULL;
+        if (lua_type(l, -1) == LUA_TUSERDATA) {
+            idref = lua_touserdata(l, -1);
+        }
+        if (!idref || idref->magic != IDREF_MAGIC ||
+        idref->type != IDREF_MEDIA || idref->ref.mobj->type !=
+        MEDIA_TYPE_AUDIO_POSITIONED) {
+            return haveluaerror(l, badargument2, 1,
+            "blitwizard.audio.setSoundPositions",
+            "list entries need to be positioned sounds followed by coordinates");
+        }
+        struct mediaobject* m = idref->ref.mobj;
+        lua_pop(l, 1);
+        double position[3];
+        int k = 0;
+        while (k < 3) {
+            lua_rawgeti(l, 1, i * 4 + 2 + k);
+            if (lua_type(l, -1) != LUA_TNUMBER) {
+                return haveluaerror(l, badargument2, 1,
+                "blitwizard.audio.setSoundPositions",
+                "list entries need to be positioned sounds followed by coordinates");
+            }
+            position[k] = lua_tonumber(l, -1);
+            lua_pop(l, 1);
+            k++;
+        }
+        m->mediainfo.sound.x = position[0];
+        m->mediainfo.sound.y = position[1];
+        m->mediainfo.sound.z = position[2];
+        mediaobject_UpdateIsPlaying(m);
+        if (m->isPlaying) {
+            batchids[playing] = m->mediainfo.sound.soundid;
+            batchpositions[playing * 3] = position[0];
+            batchpositions[playing * 3 + 1] = position[1];
+            batchpositions[playing * 3 + 2] = position[2];
+            playing++;
+        }
+        i++;
+    }
+
+    // hand them to the mixer in one go:
+    if (playing > 0) {
+        audiomixer_SetSoundPositions(playing, batchids, batchpositions);
+    }
     return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+/// Set how @{blitwizard.audio.positionedSound|positioned sounds} get
+// quieter with their distance to the listener. Sounds closer than the
+// reference distance play at full volume, and sounds farther away than
+// the maximum distance don't get any quieter.
+// @function setDistanceModel
+// @tparam number referencedistance Distance up to which sounds play at full volume (default: 1)
+// @tparam number maxdistance Distance after which sounds don't get quieter anymore (default: 1000)
+// @tparam number rolloff (optional) How fast sounds get quieter with distance, 0 for not at all (default: 1)
+
+int luafuncs_media_setDistanceModel(lua_State* l) {
+#ifdef USE_AUDIO
+    if (lua_type(l, 1) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 1,
+        "blitwizard.audio.setDistanceModel", "number", lua_strtype(l, 1));
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2,
+        "blitwizard.audio.setDistanceModel", "number", lua_strtype(l, 2));
+    }
+    float rolloff = 1;
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3,
+            "blitwizard.audio.setDistanceModel", "number",
+            lua_strtype(l, 3));
+        }
+        rolloff = lua_tonumber(l, 3);
+    }
+    main_InitAudio();
+    audiomixer_SetDistanceModel(lua_tonumber(l, 1), lua_tonumber(l, 2),
+    rolloff);
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+/// Set the volume of a mix bus. Every sound plays on one of the buses
+// "music", "sfx", "ui" or "voice" (specified when creating it, "sfx"
+// by default), and the bus volume applies on top of the sound's own
+// volume. Use this e.g. for separate music and effect volume settings.
+// @function setBusVolume
+// @tparam string bus Name of the bus: "music", "sfx", "ui" or "voice"
+// @tparam number volume New volume from 0 (quiet) to 1 (full volume, default)
+// @tparam number fadeseconds (optional) Fade to the new volume over the given time in seconds instead of changing it instantly
+
+int luafuncs_media_setBusVolume(lua_State* l) {
+#ifdef USE_AUDIO
+    int bus = mediaobject_BusFromStack(l, 1, 1,
+    "blitwizard.audio.setBusVolume");
+    if (bus < 0) {
+        return 0;
+    }
+    if (lua_type(l, 2) != LUA_TNUMBER) {
+        return haveluaerror(l, badargument1, 2,
+        "blitwizard.audio.setBusVolume", "number", lua_strtype(l, 2));
+    }
+    float volume = lua_tonumber(l, 2);
+    if (volume < 0) {
+        volume = 0;
+    }
+    if (volume > 1) {
+        volume = 1;
+    }
+    float fadeseconds = 0;
+    if (lua_gettop(l) >= 3 && lua_type(l, 3) != LUA_TNIL) {
+        if (lua_type(l, 3) != LUA_TNUMBER) {
+            return haveluaerror(l, badargument1, 3,
+            "blitwizard.audio.setBusVolume", "number",
+            lua_strtype(l, 3));
+        }
+        fadeseconds = lua_tonumber(l, 3);
+    }
+    main_InitAudio();
+    audiomixer_SetBusVolume(bus, volume, fadeseconds);
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
+}
+
+/// Mute or unmute a mix bus, see @{blitwizard.audio.setBusVolume}.
+// Sounds on a muted bus keep playing silently.
+// @function setBusMute
+// @tparam string bus Name of the bus: "music", "sfx", "ui" or "voice"
+// @tparam boolean mute true to mute the bus, false to unmute it
+
+int luafuncs_media_setBusMute(lua_State* l) {
+#ifdef USE_AUDIO
+    int bus = mediaobject_BusFromStack(l, 1, 1,
+    "blitwizard.audio.setBusMute");
+    if (bus < 0) {
+        return 0;
+    }
+    if (lua_type(l, 2) != LUA_TBOOLEAN) {
+        return haveluaerror(l, badargument1, 2,
+        "blitwizard.audio.setBusMute", "boolean", lua_strtype(l, 2));
+    }
+    main_InitAudio();
+    audiomixer_SetBusMute(bus, lua_toboolean(l, 2));
+    return 0;
+#else // ifdef USE_AUDIO
+    lua_pushstring(l, compiled_without_audio);
+    return lua_error(l);
+#endif
 }
 
 /// Implements a simple sound which has no
@@ -161,6 +899,7 @@ int luafuncs_media_object_adjust(lua_State* l, int type) {
 /// Create a new simple sound object.
 // @function new
 // @tparam string filename Filename of the audio file you want to play
+// @tparam string bus (optional) @{blitwizard.audio.setBusVolume|Mix bus} the sound plays on: "music", "sfx" (default), "ui" or "voice"
 
 int luafuncs_media_simpleSound_new(lua_State* l) {
     return luafuncs_media_object_new(l, MEDIA_TYPE_AUDIO_SIMPLE);
@@ -233,6 +972,39 @@ int luafuncs_media_simpleSound_adjust(lua_State* l) {
     return luafuncs_media_object_adjust(l, MEDIA_TYPE_AUDIO_SIMPLE);
 }
 
+/// Play the simple sound starting exactly at the given
+// @{blitwizard.audio.getMixClock|mix clock} time. The sound is opened
+// and starts decoding right away, so schedule it at least a few
+// hundred milliseconds ahead. Does nothing if the sound plays already.
+// @function schedule
+// @tparam number time Mix clock time in seconds to start at
+// @tparam number volume (optional) Volume from 0 (quiet) to 1 (full volume, default)
+// @tparam boolean loop (optional) If set to true, the sound will loop until explicitely stopped
+// @tparam number fadein (optional) Fade in from silence over the given amount of seconds
+
+int luafuncs_media_simpleSound_schedule(lua_State* l) {
+    return luafuncs_media_object_schedule(l, MEDIA_TYPE_AUDIO_SIMPLE);
+}
+
+/// Play the simple sound while fading out another sound object,
+// both changing with sample precision at the same time. The other
+// sound stops when the crossfade is done. If it doesn't play, this
+// sound simply fades in.
+// @function crossfade
+// @tparam userdata from The sound object to fade out
+// @tparam number seconds Duration of the crossfade in seconds
+// @tparam number volume (optional) Volume to fade in to from 0 (quiet) to 1 (full volume, default)
+// @tparam boolean loop (optional) If set to true, the sound will loop until explicitely stopped
+// @tparam number time (optional) @{blitwizard.audio.getMixClock|Mix clock} time in seconds to start the crossfade at. If not specified, it starts as soon as possible
+// @usage -- change the music on the next bar of a 120 bpm song:
+// local bar = 2
+// local now = blitwiz.audio.getMixClock()
+// nextmusic:crossfade(music, 1, 1, true, (math.floor(now / bar) + 1) * bar)
+
+int luafuncs_media_simpleSound_crossfade(lua_State* l) {
+    return luafuncs_media_object_crossfade(l, MEDIA_TYPE_AUDIO_SIMPLE);
+}
+
 /// Implements a sound with simple left/right stereo panning.
 // If you want to make a sound emit from a specific location,
 // you should probably use a
@@ -242,6 +1014,7 @@ int luafuncs_media_simpleSound_adjust(lua_State* l) {
 /// Create a new panned sound object.
 // @function new
 // @tparam string filename Filename of the audio file you want to play
+// @tparam string bus (optional) @{blitwizard.audio.setBusVolume|Mix bus} the sound plays on: "music", "sfx" (default), "ui" or "voice"
 
 int luafuncs_media_pannedSound_new(lua_State* l) {
     return luafuncs_media_object_new(l, MEDIA_TYPE_AUDIO_PANNED);
@@ -275,26 +1048,41 @@ int luafuncs_media_pannedSound_stop(lua_State* l) {
 // @tparam number priority Priority from 0 (lowest) to 20 (highest), values will be rounded down to have no decimal places (0.5 becomes 0, 1.7 becomes 1, etc)
 
 int luafuncs_media_pannedSound_setPriority(lua_State* l) {
-    return luafuncs_media_object_setPriority(l, MEDIA_TYPE_AUDIO_SIMPLE);
+    return luafuncs_media_object_setPriority(l, MEDIA_TYPE_AUDIO_PANNED);
 }
 
-/// Implements a positioned sound which can either follow a
-// specific @{blitwizard.object|blitwizard object} or which
-// you can move to any position you like. It will alter volume
-// based on distance and channels based on direction to simulate
-// its room placement.
+/// Implements a positioned sound which you can move to any position
+// you like. The mixer alters its volume based on the distance to the
+// @{blitwizard.audio.setListenerPosition|listener} and its channels
+// based on the direction to simulate its room placement.
+//
+// Positioned sounds default to a priority of 2.
+// @usage -- play a sound to the right of the listener:
+// mysound = blitwizard.audio.positionedSound:new("blubber.ogg")
+// mysound:setPosition(5, 0)
+// mysound:play()
 // @type positionedSound
 
-
-/// Create a new positioned sound object.
+/// Create a new positioned sound object. It is placed at 0, 0, 0
+// until you @{blitwizard.audio.positionedSound:setPosition|move it}.
 // @function new
 // @tparam string filename Filename of the audio file you want to play
-// @tparam userdata object (optional) Specify a @{blitwizard.object|blitwizard object} to which the sound should stick. If you don't specify an object to stick to, the sound can be freely placed with @{position}
+// @tparam string bus (optional) @{blitwizard.audio.setBusVolume|Mix bus} the sound plays on: "music", "sfx" (default), "ui" or "voice"
 
 int luafuncs_media_positionedSound_new(lua_State* l) {
     return luafuncs_media_object_new(l, MEDIA_TYPE_AUDIO_POSITIONED);
 }
 
+/// Play the sound represented by the positioned sound object
+// at its current position.
+// @function play
+// @tparam number volume (optional) Volume at which the sound plays from 0 (quiet) to 1 (full volume) when close to the listener. Defaults to 1
+// @tparam boolean loop (optional) If set to true, the sound will loop until explicitely stopped. If set to false or if not specified, it will play once
+// @tparam number fadein (optional) Fade in from silence to the specified volume in the given amount of seconds, instead of playing at full volume right from the start
+
+int luafuncs_media_positionedSound_play(lua_State* l) {
+    return luafuncs_media_object_play(l, MEDIA_TYPE_AUDIO_POSITIONED);
+}
 
 /// Stop the sound represented by the positioned sound object.
 // Does nothing if the sound doesn't currently play
@@ -305,12 +1093,44 @@ int luafuncs_media_positionedSound_stop(lua_State* l) {
     return luafuncs_media_object_stop(l, MEDIA_TYPE_AUDIO_POSITIONED);
 }
 
+/// Set the sound priority of the positioned sound,
+// see explanation of @{blitwizard.audio.simpleSound:setPriority}.
+// @function setPriority
+// @tparam number priority Priority from 0 (lowest) to 20 (highest), values will be rounded down to have no decimal places (0.5 becomes 0, 1.7 becomes 1, etc)
 
+int luafuncs_media_positionedSound_setPriority(lua_State* l) {
+    return luafuncs_media_object_setPriority(l, MEDIA_TYPE_AUDIO_POSITIONED);
+}
+
+/// Adjust the volume of a positioned sound while it is playing
+// (does nothing if it's not)
+// @function adjust
+// @tparam number volume New volume from 0 (quiet) to 1 (full volume)
+
+int luafuncs_media_positionedSound_adjust(lua_State* l) {
+    return luafuncs_media_object_adjust(l, MEDIA_TYPE_AUDIO_POSITIONED);
+}
+
+/// Move the positioned sound. A playing sound moves smoothly
+// to its new position over the next mixed block.
+// To move many sounds each frame, use
+// @{blitwizard.audio.setSoundPositions} instead.
+// @function setPosition
+// @tparam number x X coordinate
+// @tparam number y Y coordinate
+// @tparam number z (optional) Z coordinate for 3d games, defaults to 0
+
+int luafuncs_media_positionedSound_setPosition(lua_State* l) {
+    return luafuncs_media_object_setPosition(l, MEDIA_TYPE_AUDIO_POSITIONED);
+}
 
 // Various cleanup and management functions:
 
 void cleanupMediaObject(struct mediaobject* o) {
-    
+    if (o->mediainfo.sound.soundname) {
+        free((char*)o->mediainfo.sound.soundname);
+        o->mediainfo.sound.soundname = NULL;
+    }
 }
 
 void deleteMediaObject(struct mediaobject* o) {
@@ -334,7 +1154,12 @@ void deleteMediaObject(struct mediaobject* o) {
 }
 
 static void mediaobject_UpdateIsPlaying(struct mediaobject* o) {
-
+#ifdef USE_AUDIO
+    if (o->isPlaying &&
+    !audiomixer_IsSoundPlaying(o->mediainfo.sound.soundid)) {
+        o->isPlaying = 0;
+    }
+#endif
 }
 
 void checkAllMediaObjectsForCleanup() {
@@ -33,8 +33,24 @@ int luafuncs_media_simpleSound_play(lua_State* l);
 int luafuncs_media_simpleSound_stop(lua_State* l);
 int luafuncs_media_simpleSound_setPriority(lua_State* l);
 int luafuncs_media_simpleSound_adjust(lua_State* l);
+int luafuncs_media_simpleSound_schedule(lua_State* l);
+int luafuncs_media_simpleSound_crossfade(lua_State* l);
 int luafuncs_media_pannedSound_new(lua_State* l);
+int luafuncs_media_pannedSound_play(lua_State* l);
+int luafuncs_media_pannedSound_stop(lua_State* l);
+int luafuncs_media_pannedSound_setPriority(lua_State* l);
 int luafuncs_media_positionedSound_new(lua_State* l);
+int luafuncs_media_positionedSound_play(lua_State* l);
+int luafuncs_media_positionedSound_stop(lua_State* l);
+int luafuncs_media_positionedSound_setPriority(lua_State* l);
+int luafuncs_media_positionedSound_adjust(lua_State* l);
+int luafuncs_media_positionedSound_setPosition(lua_State* l);
+int luafuncs_media_setListenerPosition(lua_State* l);
+int luafuncs_media_setSoundPositions(lua_State* l);
+int luafuncs_media_setDistanceModel(lua_State* l);
+int luafuncs_media_setBusVolume(lua_State* l);
+int luafuncs_media_setBusMute(lua_State* l);
+int luafuncs_media_getMixClock(lua_State* l);
 void checkAllMediaObjectsForCleanup(void);
 
 #endif  // BLITWIZARD_LUAFUNCS_OBJECT_MEDIA_H_
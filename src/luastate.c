@@ -30,6 +30,7 @@
 #include "luafuncs_objectphysics.h"
 #include "luafuncs_physics.h"
 #include "luafuncs_net.h"
+#include "luafuncs_media_object.h"
 #include "luaerror.h"
 
 #include <stdlib.h>
@@ -245,6 +246,98 @@ static void luastate_CreateGraphicsTable(lua_State* l) {
     lua_settable(l, -3);
 }*/
 
+static void luastate_CreateAudioTable(lua_State* l) {
+    lua_newtable(l);
+    lua_pushstring(l, "setTargetLatency");
+    lua_pushcfunction(l, &luafuncs_setTargetLatency);
+    lua_settable(l, -3);
+    lua_pushstring(l, "getLatencyInfo");
+    lua_pushcfunction(l, &luafuncs_getLatencyInfo);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "simpleSound");
+    lua_newtable(l);
+    lua_pushstring(l, "new");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_new);
+    lua_settable(l, -3);
+    lua_pushstring(l, "play");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_play);
+    lua_settable(l, -3);
+    lua_pushstring(l, "stop");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_stop);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setPriority");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_setPriority);
+    lua_settable(l, -3);
+    lua_pushstring(l, "adjust");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_adjust);
+    lua_settable(l, -3);
+    lua_pushstring(l, "schedule");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_schedule);
+    lua_settable(l, -3);
+    lua_pushstring(l, "crossfade");
+    lua_pushcfunction(l, &luafuncs_media_simpleSound_crossfade);
+    lua_settable(l, -3);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "pannedSound");
+    lua_newtable(l);
+    lua_pushstring(l, "new");
+    lua_pushcfunction(l, &luafuncs_media_pannedSound_new);
+    lua_settable(l, -3);
+    lua_pushstring(l, "play");
+    lua_pushcfunction(l, &luafuncs_media_pannedSound_play);
+    lua_settable(l, -3);
+    lua_pushstring(l, "stop");
+    lua_pushcfunction(l, &luafuncs_media_pannedSound_stop);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setPriority");
+    lua_pushcfunction(l, &luafuncs_media_pannedSound_setPriority);
+    lua_settable(l, -3);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "positionedSound");
+    lua_newtable(l);
+    lua_pushstring(l, "new");
+    lua_pushcfunction(l, &luafuncs_media_positionedSound_new);
+    lua_settable(l, -3);
+    lua_pushstring(l, "play");
+    lua_pushcfunction(l, &luafuncs_media_positionedSound_play);
+    lua_settable(l, -3);
+    lua_pushstring(l, "stop");
+    lua_pushcfunction(l, &luafuncs_media_positionedSound_stop);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setPriority");
+    lua_pushcfunction(l, &luafuncs_media_positionedSound_setPriority);
+    lua_settable(l, -3);
+    lua_pushstring(l, "adjust");
+    lua_pushcfunction(l, &luafuncs_media_positionedSound_adjust);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setPosition");
+    lua_pushcfunction(l, &luafuncs_media_positionedSound_setPosition);
+    lua_settable(l, -3);
+    lua_settable(l, -3);
+
+    lua_pushstring(l, "setListenerPosition");
+    lua_pushcfunction(l, &luafuncs_media_setListenerPosition);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setSoundPositions");
+    lua_pushcfunction(l, &luafuncs_media_setSoundPositions);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setDistanceModel");
+    lua_pushcfunction(l, &luafuncs_media_setDistanceModel);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setBusVolume");
+    lua_pushcfunction(l, &luafuncs_media_setBusVolume);
+    lua_settable(l, -3);
+    lua_pushstring(l, "setBusMute");
+    lua_pushcfunction(l, &luafuncs_media_setBusMute);
+    lua_settable(l, -3);
+    lua_pushstring(l, "getMixClock");
+    lua_pushcfunction(l, &luafuncs_media_getMixClock);
+    lua_settable(l, -3);
+}
+
 static void luastate_CreateTimeTable(lua_State* l) {
     lua_newtable(l);
     lua_pushstring(l, "getTime");
@@ -291,6 +384,34 @@ int luastate_GetWantFFmpeg() {
     return 1;
 }
 
+int luastate_GetAudioChannels() {
+    lua_getglobal(scriptstate, "audiochannels");
+    if (lua_type(scriptstate, -1) == LUA_TNUMBER) {
+        int i = lua_tointeger(scriptstate, -1);
+        lua_pop(scriptstate, 1);
+        if (i > 0) {
+            return i;
+        }
+        return 0;
+    }
+    lua_pop(scriptstate, 1);
+    return 0;
+}
+
+int luastate_GetAudioLatency() {
+    lua_getglobal(scriptstate, "audiolatency");
+    if (lua_type(scriptstate, -1) == LUA_TNUMBER) {
+        int i = lua_tointeger(scriptstate, -1);
+        lua_pop(scriptstate, 1);
+        if (i > 0) {
+            return i;
+        }
+        return 0;
+    }
+    lua_pop(scriptstate, 1);
+    return 0;
+}
+
 static int gettraceback(lua_State* l) {
     char errormsg[2048] = "";
 
@@ -426,6 +547,10 @@ static lua_State* luastate_New(void) {
     luastate_CreateNetTable(l);
     lua_settable(l, -3);
 
+    lua_pushstring(l, "audio");
+    luastate_CreateAudioTable(l);
+    lua_settable(l, -3);
+
     /*lua_pushstring(l, "sound");
     luastate_CreateSoundTable(l);
     lua_settable(l, -3);*/
@@ -29,6 +29,8 @@ int luastate_DoInitialFile(const char* file, int argcount, char** error);
 
 char* luastate_GetPreferredAudioBackend(void);
 int luastate_GetWantFFmpeg(void);
+int luastate_GetAudioChannels(void); // 0 if not specified
+int luastate_GetAudioLatency(void); // milliseconds, 0 if not specified
 void luastate_PrintStackDebug(void);
 void luastate_SetGCCallback(void* luastate, int tablestackindex, int (*callback)(void*));
 void luastate_GCCollect(void);
@@ -58,6 +58,7 @@ extern int drawingallowed; // stored in luafuncs.c, checks if we come from an on
 #include "audio.h"
 #include "main.h"
 #include "audiomixer.h"
+#include "audiorender.h"
 #include "logging.h"
 #include "audiosourceffmpeg.h"
 #include "physics.h"
@@ -89,6 +90,10 @@ void* main_DefaultPhysics2dPtr() {
 }
 
 void main_Quit(int returncode) {
+#ifdef USE_AUDIO
+    // complete the rendered audio file if we are writing one
+    audiorender_Finish();
+#endif
     listeners_CloseAll();
     if (sdlinitialised) {
 #ifdef USE_SDL_AUDIO
@@ -107,38 +112,37 @@ void fatalscripterror(void) {
 }
 
 int simulateaudio = 0;
+int renderaudio = 0;  // mixer output goes to a file instead of a device
 int audioinitialised = 0;
-void main_InitAudio(void) {
-#ifdef USE_AUDIO
-    if (audioinitialised) {
-        return;
-    }
-    audioinitialised = 1;
+static int audiolatency = 0;  // target latency in milliseconds, 0 for default
 
+#if defined(USE_AUDIO) && (defined(USE_SDL_AUDIO) || defined(WINDOWS))
+static void main_OpenAudioDevice(void) {
     // get audio backend
     char* p = luastate_GetPreferredAudioBackend();
+    char* error;
 
-    // load FFmpeg if we happen to want it
-    if (luastate_GetWantFFmpeg()) {
-        audiosourceffmpeg_LoadFFmpeg();
-    }else{
-        audiosourceffmpeg_DisableFFmpeg();
+    // the device buffer holds a power-of-two amount of samples,
+    // smallest one giving at least the requested latency:
+    unsigned int buffersize = 0;
+    if (audiolatency > 0) {
+        buffersize = 1;
+        while (buffersize < (unsigned int)audiolatency * 48) {
+            buffersize *= 2;
+        }
     }
 
-#if defined(USE_SDL_AUDIO) || defined(WINDOWS)
-    char* error;
-
     // initialise audio - try 32bit first
     s16mixmode = 0;
 #ifndef FORCES16AUDIO
-    if (!audio_Init(&audiomixer_GetBuffer, 0, p, 0, &error)) {
+    if (!audio_Init(&audiomixer_GetBuffer, buffersize, p, 0, &error)) {
         if (error) {
             free(error);
         }
 #endif
         // try 16bit now
         s16mixmode = 1;
-        if (!audio_Init(&audiomixer_GetBuffer, 0, p, 1, &error)) {
+        if (!audio_Init(&audiomixer_GetBuffer, buffersize, p, 1, &error)) {
             printwarning("Warning: Failed to initialise audio: %s",error);
             if (error) {
                 free(error);
@@ -153,6 +157,42 @@ void main_InitAudio(void) {
     if (p) {
         free(p);
     }
+}
+#endif
+
+void main_InitAudio(void) {
+#ifdef USE_AUDIO
+    if (audioinitialised) {
+        return;
+    }
+    audioinitialised = 1;
+
+    // load FFmpeg if we happen to want it
+    if (luastate_GetWantFFmpeg()) {
+        audiosourceffmpeg_LoadFFmpeg();
+    }else{
+        audiosourceffmpeg_DisableFFmpeg();
+    }
+
+    // set amount of mixer channels if specified
+    int audiochannels = luastate_GetAudioChannels();
+    if (audiochannels > 0) {
+        audiomixer_SetMaxChannels(audiochannels);
+    }
+
+    // get target latency if not set at runtime already
+    if (audiolatency <= 0) {
+        audiolatency = luastate_GetAudioLatency();
+    }
+
+#if defined(USE_SDL_AUDIO) || defined(WINDOWS)
+    if (renderaudio) {
+        // we are rendering to a file, so no device is needed
+        simulateaudio = 1;
+        s16mixmode = 0;
+        return;
+    }
+    main_OpenAudioDevice();
 #else  // USE_SDL_AUDIO || WINDOWS
     // simulate audio:
     simulateaudio = 1;
@@ -164,6 +204,22 @@ void main_InitAudio(void) {
 #endif  // ifdef USE_AUDIO
 }
 
+void main_SetAudioLatency(int milliseconds) {
+    if (milliseconds < 0) {
+        milliseconds = 0;
+    }
+    if (milliseconds == audiolatency) {
+        return;
+    }
+    audiolatency = milliseconds;
+#if defined(USE_AUDIO) && (defined(USE_SDL_AUDIO) || defined(WINDOWS))
+    // reopen the device with the new buffer size if it is running:
+    if (audioinitialised && !simulateaudio) {
+        main_OpenAudioDevice();
+    }
+#endif
+}
+
 
 static void quitevent(void) {
     char* error;
@@ -356,6 +412,10 @@ int main(int argc, char** argv) {
     int option_templatepathset = 0;
     int nextoptionistemplatepath = 0;
     int nextoptionisscriptarg = 0;
+    const char* option_renderaudiofile = NULL;
+    double option_renderaudioseconds = 0;
+    int nextoptionisrenderfile = 0;
+    int nextoptionisrenderseconds = 0;
     int gcframecount = 0;
 
 #ifdef WINDOWS
@@ -391,6 +451,26 @@ int main(int argc, char** argv) {
                 continue;
             }
 
+            // process render audio option parameters:
+            if (nextoptionisrenderfile) {
+                nextoptionisrenderfile = 0;
+                nextoptionisrenderseconds = 1;
+                option_renderaudiofile = argv[i];
+                i++;
+                continue;
+            }
+            if (nextoptionisrenderseconds) {
+                nextoptionisrenderseconds = 0;
+                option_renderaudioseconds = atof(argv[i]);
+                if (option_renderaudioseconds <= 0) {
+                    printerror("Error: -renderaudio needs a positive "
+                    "amount of seconds");
+                    return 1;
+                }
+                i++;
+                continue;
+            }
+
             // various options:
             if ((argv[i][0] == '-' || strcasecmp(argv[i],"/?") == 0)
             && !nextoptionisscriptarg) {
@@ -415,6 +495,13 @@ int main(int argc, char** argv) {
                            "the\n"
                            "                          folder of the script\n");
                     printf("   -help                  Show this help text and quit\n");
+                    printf("   -renderaudio [file] [seconds]\n"
+                           "                          Run faster than realtime "
+                           "and\n"
+                           "                          write the given amount "
+                           "of audio\n"
+                           "                          to a .wav file instead "
+                           "of playing it\n");
                     printf("   -templatepath [path]   Check another place for "
                            "templates\n"
                            "                          (not the default "
@@ -432,6 +519,11 @@ int main(int argc, char** argv) {
                     i++;
                     continue;
                 }
+                if (strcasecmp(argv[i],"-renderaudio") == 0) {
+                    nextoptionisrenderfile = 1;
+                    i++;
+                    continue;
+                }
                 if (strcmp(argv[i], "-v") == 0 || strcasecmp(argv[i], "-version") == 0
                 || strcasecmp(argv[i], "--version") == 0) {
                     printf("blitwizard %s (C) 2011-2013 Jonas Thiem et al\n",VERSION);
@@ -547,10 +639,35 @@ int main(int argc, char** argv) {
         i++;
     }
 
+    if (nextoptionisrenderfile || nextoptionisrenderseconds) {
+        printerror("Error: -renderaudio needs a file name and an amount "
+        "of seconds");
+        return 1;
+    }
+
 #ifdef USE_AUDIO
     // This needs to be done at some point before we actually 
     // initialise audio so that the mixer is ready for use then
     audiomixer_Init();
+
+    if (option_renderaudiofile) {
+        // render audio to a file, with game time passing independently
+        // of real time so the result is reproducible:
+        char* rendererror;
+        if (!audiorender_Start(option_renderaudiofile,
+        option_renderaudioseconds, &rendererror)) {
+            printerror("Error: %s", rendererror);
+            free(rendererror);
+            return 1;
+        }
+        renderaudio = 1;
+        time_UseVirtualClock();
+    }
+#else
+    if (option_renderaudiofile) {
+        printerror("Error: %s", compiled_without_audio);
+        return 1;
+    }
 #endif
 
     // check the provided path:
@@ -811,13 +928,24 @@ int main(int argc, char** argv) {
     while (!wantquit) {
         blitwizonstepworked = 1;
         blitwizondrawworked = 0;
+#ifdef USE_AUDIO
+        if (renderaudio) {
+            // game time passes in fixed steps as fast as we can go
+            time_AdvanceVirtualClock(TIMESTEP);
+        }
+#endif
         uint64_t time = time_GetMilliseconds();
 
         // this is a hack for SDL bug http://bugzilla.libsdl.org/show_bug.cgi?id=1422
 
 #ifdef USE_AUDIO
         // simulate audio
-        if (simulateaudio) {
+        if (renderaudio) {
+            // write out the audio of the game time passed so far
+            if (!audiorender_Advance(time - simulateaudiotime)) {
+                main_Quit(0);
+            }
+        }else if (simulateaudio) {
             while (simulateaudiotime < time_GetMilliseconds()) {
                 char buf[48 * 4 * 2];
                 audiomixer_GetBuffer(buf, 48 * 4 * 2);
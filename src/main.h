@@ -22,6 +22,7 @@
 */
 
 void main_InitAudio(void);
+void main_SetAudioLatency(int milliseconds);  // 0 for default
 void main_Quit(int returncode);
 void* main_DefaultPhysics2dPtr(void);  // pointer to 2d physics context
 void* main_DefaultPhysics3dPtr(void);  // pointer to 3d physics context
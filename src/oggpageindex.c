@@ -0,0 +1,320 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "os.h"
+
+#ifdef USE_AUDIO
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "audiosource.h"
+#include "audiosourcefile.h"
+#include "audioworkerpool.h"
+#include "oggpageindex.h"
+#include "threading.h"
+
+// Indexes of this many files are kept around:
+#define OGGINDEXCACHESIZE 16
+
+// Scan buffer (needs to hold at least one page of max. 65307 bytes):
+#define OGGSCANBUFSIZE (1024 * 128)
+#define OGGPAGEHEADERSIZE 27
+
+// The scan is done in steps of this many buffer refills on the audio
+// worker pool, so stream refills queued meanwhile don't have to wait
+// for the whole file:
+#define OGGSCANSTEPREADS 8
+
+struct oggpage {
+    int64_t offset;
+    int64_t granule;
+};
+
+struct oggpageindex {
+    char* path;
+    struct oggpage* pages;
+    unsigned int pagecount;
+    unsigned int pagealloc;
+    int complete;  // set by the builder when done (atomic)
+    int usable;  // 0 if the file has more than one logical stream
+    int refcount;  // (atomic)
+
+    // state of the scan, which is done by the builder job:
+    struct audioworkerjob builderjob;
+    struct audiosource* file;
+    unsigned char* buf;
+    int64_t bufoffset;  // file offset of buf[0]
+    unsigned int start;
+    unsigned int end;
+    int fileeof;
+    int haveserial;
+    uint32_t serial;
+};
+
+// cache of recently used indexes (MAIN THREAD):
+static mutex* indexcachelock = NULL;
+static struct oggpageindex* indexcache[OGGINDEXCACHESIZE];
+static unsigned int indexcacheuse[OGGINDEXCACHESIZE];
+static unsigned int indexcacheclock = 0;
+
+void oggpageindex_Release(struct oggpageindex* index) {
+    if (__atomic_sub_fetch(&index->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(index->pages);
+        free(index->path);
+        free(index);
+    }
+}
+
+static int oggpageindex_AddPage(struct oggpageindex* index, int64_t offset,
+int64_t granule) {
+    if (index->pagecount >= index->pagealloc) {
+        unsigned int newalloc = index->pagealloc * 2;
+        if (newalloc < 256) {
+            newalloc = 256;
+        }
+        struct oggpage* newpages = realloc(index->pages,
+        sizeof(*newpages) * newalloc);
+        if (!newpages) {
+            return 0;
+        }
+        index->pages = newpages;
+        index->pagealloc = newalloc;
+    }
+    index->pages[index->pagecount].offset = offset;
+    index->pages[index->pagecount].granule = granule;
+    index->pagecount++;
+    return 1;
+}
+
+static int oggpageindex_Scan(struct oggpageindex* index) {
+    // Walk through the pages of the file and remember the granule
+    // positions, until the file is done or OGGSCANSTEPREADS refills of
+    // the scan buffer were needed. Returns 1 if the scan should go on,
+    // 0 if it is done (index->usable tells whether it succeeded).
+    int reads = 0;
+    while (1) {
+        // make sure a full page header is available:
+        if (index->end - index->start < OGGPAGEHEADERSIZE + 255 &&
+        !index->fileeof) {
+            if (reads >= OGGSCANSTEPREADS) {
+                return 1;
+            }
+            if (index->start > 0) {
+                memmove(index->buf, index->buf + index->start,
+                index->end - index->start);
+                index->bufoffset += index->start;
+                index->end -= index->start;
+                index->start = 0;
+            }
+            int i = index->file->read(index->file,
+            (char*)index->buf + index->end, OGGSCANBUFSIZE - index->end);
+            reads++;
+            if (i <= 0) {
+                index->fileeof = 1;
+                if (i < 0) {
+                    index->usable = 0;
+                    return 0;
+                }
+            }else{
+                index->end += i;
+            }
+            continue;
+        }
+        if (index->end - index->start < OGGPAGEHEADERSIZE) {
+            return 0;
+        }
+
+        // find the next page:
+        unsigned char* p = index->buf + index->start;
+        if (memcmp(p, "OggS", 4) != 0) {
+            index->start++;
+            continue;
+        }
+        unsigned int segments = p[26];
+        if (index->end - index->start < OGGPAGEHEADERSIZE + segments) {
+            // truncated page at the end of the file
+            return 0;
+        }
+        unsigned int pagesize = OGGPAGEHEADERSIZE + segments;
+        unsigned int i = 0;
+        while (i < segments) {
+            pagesize += p[OGGPAGEHEADERSIZE + i];
+            i++;
+        }
+
+        // granule position and stream serial are little endian:
+        uint64_t granule = 0;
+        i = 0;
+        while (i < 8) {
+            granule |= ((uint64_t)p[6 + i]) << (8 * i);
+            i++;
+        }
+        uint32_t pageserial = (uint32_t)p[14] | ((uint32_t)p[15] << 8) |
+        ((uint32_t)p[16] << 16) | ((uint32_t)p[17] << 24);
+        if (!index->haveserial) {
+            index->serial = pageserial;
+            index->haveserial = 1;
+        }else if (pageserial != index->serial) {
+            // chained or multiplexed streams aren't supported
+            index->usable = 0;
+            return 0;
+        }
+
+        // pages without a finished packet have granule position -1:
+        if ((int64_t)granule != -1) {
+            if (!oggpageindex_AddPage(index, index->bufoffset + index->start,
+            (int64_t)granule)) {
+                index->usable = 0;
+                return 0;
+            }
+        }
+
+        // skip the page (body might not be in the buffer yet):
+        if (pagesize <= index->end - index->start) {
+            index->start += pagesize;
+        }else{
+            int64_t next = index->bufoffset + index->start + pagesize;
+            if (!index->file->seek(index->file, (size_t)next)) {
+                // the file couldn't be reopened, so the rest is unknown
+                index->usable = 0;
+                return 0;
+            }
+            index->bufoffset = next;
+            index->start = 0;
+            index->end = 0;
+        }
+    }
+}
+
+static void oggpageindex_Builder(void* userdata) {
+    // builder job run by the audio worker pool, scanning a part of the
+    // file each time it runs:
+    struct oggpageindex* index = userdata;
+    if (!index->file) {
+        index->file = audiosourcefile_Create(index->path);
+        index->buf = malloc(OGGSCANBUFSIZE);
+        index->usable = (index->file && index->buf);
+    }
+    if (index->usable && oggpageindex_Scan(index)) {
+        // give other jobs a turn, then go on:
+        audioworkerpool_Queue(&index->builderjob);
+        return;
+    }
+
+    // done:
+    if (index->file) {
+        index->file->close(index->file);
+        index->file = NULL;
+    }
+    free(index->buf);
+    index->buf = NULL;
+    __atomic_store_n(&index->complete, 1, __ATOMIC_RELEASE);
+    oggpageindex_Release(index);
+}
+
+struct oggpageindex* oggpageindex_Get(const char* path) {
+    if (!indexcachelock) {
+        indexcachelock = mutex_Create();
+        if (!indexcachelock) {
+            return NULL;
+        }
+    }
+    mutex_Lock(indexcachelock);
+    indexcacheclock++;
+
+    // see if we know this file already:
+    int i = 0;
+    int oldest = 0;
+    while (i < OGGINDEXCACHESIZE) {
+        if (indexcache[i] && strcmp(indexcache[i]->path, path) == 0) {
+            indexcacheuse[i] = indexcacheclock;
+            __atomic_add_fetch(&indexcache[i]->refcount, 1,
+            __ATOMIC_RELAXED);
+            mutex_Release(indexcachelock);
+            return indexcache[i];
+        }
+        if (!indexcache[i] || (indexcache[oldest] &&
+        indexcacheuse[i] < indexcacheuse[oldest])) {
+            oldest = i;
+        }
+        i++;
+    }
+
+    // create a new index:
+    struct oggpageindex* index = malloc(sizeof(*index));
+    if (!index) {
+        mutex_Release(indexcachelock);
+        return NULL;
+    }
+    memset(index, 0, sizeof(*index));
+    index->path = strdup(path);
+    if (!index->path || !audioworkerpool_Start()) {
+        free(index->path);
+        free(index);
+        mutex_Release(indexcachelock);
+        return NULL;
+    }
+    index->builderjob.func = &oggpageindex_Builder;
+    index->builderjob.userdata = index;
+
+    // replace the least recently used cache entry:
+    if (indexcache[oldest]) {
+        oggpageindex_Release(indexcache[oldest]);
+    }
+    indexcache[oldest] = index;
+    indexcacheuse[oldest] = indexcacheclock;
+
+    // references are held by the cache, the builder and our caller:
+    index->refcount = 3;
+    mutex_Release(indexcachelock);
+    audioworkerpool_Queue(&index->builderjob);
+    return index;
+}
+
+int oggpageindex_Lookup(struct oggpageindex* index, int64_t granule, int64_t* offset, int64_t* pagegranule) {
+    if (!__atomic_load_n(&index->complete, __ATOMIC_ACQUIRE) ||
+    !index->usable) {
+        return 0;
+    }
+
+    // binary search for the last page below the granule position:
+    unsigned int low = 0;
+    unsigned int high = index->pagecount;
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+        if (index->pages[mid].granule < granule) {
+            low = mid + 1;
+        }else{
+            high = mid;
+        }
+    }
+    if (low == 0) {
+        return 0;
+    }
+    *offset = index->pages[low - 1].offset;
+    *pagegranule = index->pages[low - 1].granule;
+    return 1;
+}
+
+#endif  // USE_AUDIO
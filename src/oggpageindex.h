@@ -0,0 +1,56 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_OGGPAGEINDEX_H_
+#define BLITWIZARD_OGGPAGEINDEX_H_
+
+#ifdef USE_AUDIO
+
+#include <stdint.h>
+
+// An index of the pages of an .ogg file (file offset and granule
+// position of each page), so seeking can jump to the right page
+// directly instead of bisecting through the file.
+// Indexes are built on the audio worker pool and kept for recently
+// used files, so they only need to be built once per file.
+
+struct oggpageindex;
+
+struct oggpageindex* oggpageindex_Get(const char* path);
+// Get the page index for the given file, starting to build it in the
+// background if it isn't known yet. (MAIN THREAD)
+// Returns NULL if no index can be built. Release the index when done.
+
+int oggpageindex_Lookup(struct oggpageindex* index, int64_t granule, int64_t* offset, int64_t* pagegranule);
+// Find the last page with a granule position below the given one.
+// Returns 1 and sets offset and pagegranule to the page's file offset
+// and granule position on success, 0 if the index isn't complete yet,
+// unusable (chained streams) or there is no such page.
+
+void oggpageindex_Release(struct oggpageindex* index);
+// Give up a reference obtained with oggpageindex_Get().
+// Can be used from any thread.
+
+#endif  // USE_AUDIO
+
+#endif  // BLITWIZARD_OGGPAGEINDEX_H_
@@ -0,0 +1,107 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "os.h"
+#include "spscqueue.h"
+
+struct spscqueue {
+    unsigned int elementsize;
+    unsigned int capacity;  // always a power of two
+    char* elements;
+
+    // both positions only ever increase (and wrap around at UINT_MAX).
+    // The producer only writes writepos, the consumer only readpos:
+    unsigned int writepos;
+    unsigned int readpos;
+};
+
+spscqueue* spscqueue_Create(unsigned int elementsize, unsigned int capacity) {
+    if (elementsize == 0 || capacity == 0) {
+        return NULL;
+    }
+    spscqueue* q = malloc(sizeof(*q));
+    if (!q) {
+        return NULL;
+    }
+    memset(q, 0, sizeof(*q));
+
+    // round up capacity to a power of two:
+    q->capacity = 1;
+    while (q->capacity < capacity) {
+        q->capacity *= 2;
+    }
+    q->elementsize = elementsize;
+
+    q->elements = malloc(q->elementsize * q->capacity);
+    if (!q->elements) {
+        free(q);
+        return NULL;
+    }
+    return q;
+}
+
+int spscqueue_Push(spscqueue* q, const void* element) {
+    unsigned int writepos = q->writepos;
+    unsigned int readpos = __atomic_load_n(&q->readpos, __ATOMIC_ACQUIRE);
+    if (writepos - readpos >= q->capacity) {
+        // queue is full
+        return 0;
+    }
+    memcpy(q->elements + (writepos & (q->capacity - 1)) * q->elementsize,
+    element, q->elementsize);
+
+    // publish the element to the consumer:
+    __atomic_store_n(&q->writepos, writepos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int spscqueue_Pop(spscqueue* q, void* element) {
+    unsigned int readpos = q->readpos;
+    unsigned int writepos = __atomic_load_n(&q->writepos, __ATOMIC_ACQUIRE);
+    if (readpos == writepos) {
+        // queue is empty
+        return 0;
+    }
+    memcpy(element, q->elements + (readpos & (q->capacity - 1)) *
+    q->elementsize, q->elementsize);
+
+    // hand the element slot back to the producer:
+    __atomic_store_n(&q->readpos, readpos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+unsigned int spscqueue_Count(spscqueue* q) {
+    return __atomic_load_n(&q->writepos, __ATOMIC_ACQUIRE) -
+    __atomic_load_n(&q->readpos, __ATOMIC_ACQUIRE);
+}
+
+void spscqueue_Destroy(spscqueue* q) {
+    if (!q) {
+        return;
+    }
+    free(q->elements);
+    free(q);
+}
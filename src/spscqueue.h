@@ -0,0 +1,53 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef BLITWIZARD_SPSCQUEUE_H_
+#define BLITWIZARD_SPSCQUEUE_H_
+
+// A lock-free queue for exactly one producer thread and exactly one
+// consumer thread. Neither side ever blocks: pushing to a full queue
+// and popping from an empty queue simply fail.
+
+typedef struct spscqueue spscqueue;
+
+spscqueue* spscqueue_Create(unsigned int elementsize, unsigned int capacity);
+// Create a queue holding up to capacity elements of elementsize bytes.
+// capacity is rounded up to the next power of two.
+// Returns NULL on allocation failure.
+
+int spscqueue_Push(spscqueue* q, const void* element);
+// Copy an element into the queue (PRODUCER THREAD).
+// Returns 1 on success, 0 if the queue is full.
+
+int spscqueue_Pop(spscqueue* q, void* element);
+// Copy the oldest element out of the queue and remove it
+// (CONSUMER THREAD). Returns 1 on success, 0 if the queue is empty.
+
+unsigned int spscqueue_Count(spscqueue* q);
+// Get the amount of elements currently queued (any thread, but the
+// result may be outdated immediately if the other side is active).
+
+void spscqueue_Destroy(spscqueue* q);
+// Free the queue. Neither side must use it anymore.
+
+#endif  // BLITWIZARD_SPSCQUEUE_H_
@@ -53,7 +53,23 @@ int startinitialised = 0;
 
 uint64_t oldtime = 0;
 uint64_t timeoffset = 0;
+
+// virtual clock for headless rendering:
+static int virtualclock = 0;
+static uint64_t virtualtime = 0;
+
+void time_UseVirtualClock(void) {
+    virtualclock = 1;
+}
+
+void time_AdvanceVirtualClock(uint32_t milliseconds) {
+    virtualtime += milliseconds;
+}
+
 uint64_t time_GetMilliseconds() {
+    if (virtualclock) {
+        return virtualtime;
+    }
 #if defined(HAVE_SDL) || defined(WINDOWS)
 #ifdef HAVE_SDL
     uint64_t i = SDL_GetTicks();
@@ -110,6 +126,10 @@ uint64_t time_GetMilliseconds() {
 }
 
 void time_Sleep(uint32_t milliseconds) {
+    if (virtualclock) {
+        // nobody waits for virtual time to pass
+        return;
+    }
 #ifdef HAVE_SDL
     SDL_Delay(milliseconds);
 #else
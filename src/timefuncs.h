@@ -39,6 +39,15 @@ uint64_t time_GetMilliseconds(void);
 
 void time_Sleep(uint32_t milliseconds);
 // Sleep for a specified amount of time.
+// Returns immediately when using the virtual clock.
+
+void time_UseVirtualClock(void);
+// Switch to a virtual clock which starts at 0 and only moves
+// forward through time_AdvanceVirtualClock(). Used to run the
+// game faster than real time (e.g. for rendering audio to a file).
+
+void time_AdvanceVirtualClock(uint32_t milliseconds);
+// Advance the virtual clock by the given amount of time.
 
 #endif  // BLITWIZARD_TIMEFUNCS_H_
 
@@ -0,0 +1,269 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+// Audio mixing benchmark.
+//
+// This feeds a number of channels with synthetic sine audio through the
+// same fade/pan/vol and loop stages the mixer uses, mixes them with the
+// mixer's kernel and reports how much CPU time each channel
+// costs per second of 48kHz audio.
+//
+// Each run is done twice: once with sources that hand out only one
+// stereo sample per read (which is how the fade/pan/vol stage used to
+// pull its audio, one indirect read through the decoder chain per
+// sample) as the baseline, and once with the regular block reads.
+//
+// Build it with "make audiobench" in the tests directory, then run:
+//   ./audiobench [channels] [seconds] [buffer size in samples]
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "os.h"
+#include "audiosource.h"
+#include "audiosourcefadepanvol.h"
+#include "audiosourceloop.h"
+#include "audiomixerkernel.h"
+
+// amount of distinct sine samples we keep in memory per channel:
+#define SINESAMPLES (48000 / 4)
+
+struct sinesource_internaldata {
+    float* samples;
+    unsigned int bytes;
+    unsigned int pos;
+    int perframe;  // return at most one stereo sample per read
+};
+
+static int sinesource_Read(struct audiosource* source, char* buffer, unsigned int bytes) {
+    struct sinesource_internaldata* idata = source->internaldata;
+    if (idata->perframe && bytes > sizeof(float) * 2) {
+        bytes = sizeof(float) * 2;
+    }
+    if (bytes > idata->bytes - idata->pos) {
+        bytes = idata->bytes - idata->pos;
+    }
+    memcpy(buffer, (char*)idata->samples + idata->pos, bytes);
+    idata->pos += bytes;
+    return bytes;
+}
+
+static void sinesource_Rewind(struct audiosource* source) {
+    struct sinesource_internaldata* idata = source->internaldata;
+    idata->pos = 0;
+}
+
+static size_t sinesource_Position(struct audiosource* source) {
+    struct sinesource_internaldata* idata = source->internaldata;
+    return idata->pos / (sizeof(float) * 2);
+}
+
+static size_t sinesource_Length(struct audiosource* source) {
+    struct sinesource_internaldata* idata = source->internaldata;
+    return idata->bytes / (sizeof(float) * 2);
+}
+
+static int sinesource_Seek(struct audiosource* source, size_t pos) {
+    struct sinesource_internaldata* idata = source->internaldata;
+    if (pos > sinesource_Length(source)) {
+        return 0;
+    }
+    idata->pos = pos * sizeof(float) * 2;
+    return 1;
+}
+
+static void sinesource_Close(struct audiosource* source) {
+    struct sinesource_internaldata* idata = source->internaldata;
+    free(idata->samples);
+    free(idata);
+    free(source);
+}
+
+static struct audiosource* sinesource_Create(float frequency, int perframe) {
+    struct audiosource* a = malloc(sizeof(*a));
+    struct sinesource_internaldata* idata = malloc(sizeof(*idata));
+    if (!a || !idata) {
+        free(a);
+        free(idata);
+        return NULL;
+    }
+    memset(a, 0, sizeof(*a));
+    memset(idata, 0, sizeof(*idata));
+    idata->bytes = SINESAMPLES * sizeof(float) * 2;
+    idata->perframe = perframe;
+    idata->samples = malloc(idata->bytes);
+    if (!idata->samples) {
+        free(a);
+        free(idata);
+        return NULL;
+    }
+    unsigned int i = 0;
+    while (i < SINESAMPLES) {
+        float v = 0.5 * sin(((double)i / 48000.0) * frequency * 2 * M_PI);
+        idata->samples[i * 2] = v;
+        idata->samples[i * 2 + 1] = v;
+        i++;
+    }
+
+    a->internaldata = idata;
+    a->read = &sinesource_Read;
+    a->rewind = &sinesource_Rewind;
+    a->position = &sinesource_Position;
+    a->length = &sinesource_Length;
+    a->seek = &sinesource_Seek;
+    a->close = &sinesource_Close;
+    a->samplerate = 48000;
+    a->channels = 2;
+    a->format = AUDIOSOURCEFORMAT_F32LE;
+    a->seekable = 1;
+    return a;
+}
+
+static int runbench(int channelcount, double seconds, unsigned int buffersamples, int perframe, double* cpuseconds) {
+    // Mix the given amount of audio and store the CPU time it took.
+    // Returns 1 on success, 0 if a channel failed to deliver all the
+    // audio it was asked for (which would make the timing meaningless).
+
+    // set up one looping fade/pan/vol chain per channel:
+    struct audiosource** channels = malloc(sizeof(*channels) * channelcount);
+    float* mixbuf = malloc(buffersamples * sizeof(float) * 2);
+    float* channelbuf = malloc(buffersamples * sizeof(float) * 2);
+    if (!channels || !mixbuf || !channelbuf) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+    int i = 0;
+    while (i < channelcount) {
+        struct audiosource* fadepanvol = audiosourcefadepanvol_Create(
+        sinesource_Create(220 + i * 20, perframe));
+        if (!fadepanvol) {
+            printf("Failed to create channel %d\n", i);
+            exit(1);
+        }
+        audiosourcefadepanvol_SetPanVol(fadepanvol, 0.8,
+        ((float)(i % 9) - 4) / 4, 0);
+        channels[i] = audiosourceloop_Create(fadepanvol);
+        if (!channels[i]) {
+            printf("Failed to create channel %d\n", i);
+            exit(1);
+        }
+        audiosourceloop_SetLooping(channels[i], 1);
+        i++;
+    }
+
+    // mix the requested amount of audio:
+    unsigned int bufferbytes = buffersamples * sizeof(float) * 2;
+    unsigned long long totalsamples = (unsigned long long)(seconds * 48000);
+    unsigned long long mixedsamples = 0;
+    unsigned long long wantedbytes = 0;
+    unsigned long long readbytes = 0;
+    unsigned int shortreads = 0;
+    clock_t start = clock();
+    while (mixedsamples < totalsamples) {
+        memset(mixbuf, 0, bufferbytes);
+        i = 0;
+        while (i < channelcount) {
+            int k = channels[i]->read(channels[i], (char*)channelbuf, bufferbytes);
+            wantedbytes += bufferbytes;
+            if (k > 0) {
+                audiomixerkernel_Mix(mixbuf, channelbuf, k / sizeof(float));
+                readbytes += k;
+            }
+            if (k < (int)bufferbytes) {
+                shortreads++;
+            }
+            i++;
+        }
+        mixedsamples += buffersamples;
+    }
+    *cpuseconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    i = 0;
+    while (i < channelcount) {
+        channels[i]->close(channels[i]);
+        i++;
+    }
+    free(channels);
+    free(mixbuf);
+    free(channelbuf);
+
+    if (shortreads > 0) {
+        printf("Error: %u channel reads returned less than requested, got %llu of %llu bytes\n",
+        shortreads, readbytes, wantedbytes);
+        return 0;
+    }
+    return 1;
+}
+
+static void report(const char* name, int channelcount, double audioseconds, double cpuseconds) {
+    printf("%s: %.3f seconds CPU time, %.2f microseconds per channel per second of audio",
+    name, cpuseconds, (cpuseconds * 1000000.0) / (audioseconds * channelcount));
+    if (cpuseconds > 0) {
+        printf(", %.1fx faster than realtime", audioseconds / cpuseconds);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    int channelcount = 32;
+    double seconds = 60;
+    unsigned int buffersamples = 2048;
+    if (argc > 1) {
+        channelcount = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        seconds = atof(argv[2]);
+    }
+    if (argc > 3) {
+        buffersamples = atoi(argv[3]);
+    }
+    if (channelcount <= 0 || seconds <= 0 || buffersamples <= 0) {
+        printf("Usage: audiobench [channels] [seconds] [buffer size in samples]\n");
+        return 1;
+    }
+
+    audiomixerkernel_Init();
+
+    // round up to full buffers like the mixing loop does:
+    double audioseconds = (double)(((unsigned long long)(seconds * 48000)
+    + buffersamples - 1) / buffersamples * buffersamples) / 48000.0;
+    printf("Mixing %d channels (%s kernel), %.1f seconds of audio\n",
+    channelcount, audiomixerkernel_GetName(), audioseconds);
+
+    double baselinecpu, blockcpu;
+    if (!runbench(channelcount, seconds, buffersamples, 1, &baselinecpu)) {
+        return 1;
+    }
+    report("Per sample reads (baseline)", channelcount, audioseconds, baselinecpu);
+    if (!runbench(channelcount, seconds, buffersamples, 0, &blockcpu)) {
+        return 1;
+    }
+    report("Block reads", channelcount, audioseconds, blockcpu);
+    if (blockcpu > 0) {
+        printf("Speedup: %.2fx\n", baselinecpu / blockcpu);
+    }
+    return 0;
+}
@@ -0,0 +1,252 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+// Sample format conversion benchmark.
+//
+// This converts a large block of synthetic audio for every format pair
+// audiosourceformatconvert supports, first with the plain C kernels and
+// then with the kernels audioconvertkernel_Init() picks for this CPU,
+// and reports the throughput of each. Conversions to a format of the same
+// or larger sample size are done in place, like audiosourceformatconvert
+// does it. The output of the picked kernels is checked against the
+// output of the C kernels, and the benchmark fails if they disagree.
+//
+// Build it with "make convertbench" in the tests directory, then run:
+//   ./convertbench [seconds of 48kHz stereo audio per block] [iterations]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "os.h"
+#include "audiosource.h"
+#include "audioconvertkernel.h"
+#include "audiomixerkernel.h"
+
+static const char* formatname(unsigned int format) {
+    switch (format) {
+    case AUDIOSOURCEFORMAT_U8:
+        return "u8";
+    case AUDIOSOURCEFORMAT_S16LE:
+        return "s16le";
+    case AUDIOSOURCEFORMAT_S24LE:
+        return "s24le";
+    case AUDIOSOURCEFORMAT_F32LE:
+        return "f32le";
+    case AUDIOSOURCEFORMAT_S32LE:
+        return "s32le";
+    default:
+        return "unknown";
+    }
+}
+
+static void fillsine(char* buffer, unsigned int format,
+unsigned int samples) {
+    // write a 440Hz sine at half volume in the given format:
+    unsigned int size = audioconvertkernel_SampleSize(format);
+    unsigned int i = 0;
+    while (i < samples) {
+        double v = 0.5 * sin(((double)(i / 2) / 48000.0) * 440 * 2 * M_PI);
+        char* p = buffer + i * size;
+        if (format == AUDIOSOURCEFORMAT_U8) {
+            *(unsigned char*)p = (unsigned char)(128 + v * 127);
+        }else if (format == AUDIOSOURCEFORMAT_F32LE) {
+            float f = v;
+            memcpy(p, &f, sizeof(f));
+        }else{
+            // signed integer formats, written little endian:
+            int32_t s = (int32_t)(v * 2147483647.0);
+            s >>= (4 - size) * 8;
+            unsigned int k = 0;
+            while (k < size) {
+                p[k] = (char)((uint32_t)s >> (k * 8));
+                k++;
+            }
+        }
+        i++;
+    }
+}
+
+static int comparepair(unsigned int targetformat, const char* result,
+const char* reference, unsigned int samples) {
+    // Check the converted samples against the C kernel output. Returns
+    // the amount of differing samples. f32le -> s16le is done by the
+    // mixer's kernels which may round differently, so allow an error of
+    // one there:
+    unsigned int size = audioconvertkernel_SampleSize(targetformat);
+    if (targetformat != AUDIOSOURCEFORMAT_S16LE) {
+        unsigned int bad = 0;
+        unsigned int i = 0;
+        while (i < samples) {
+            if (memcmp(result + i * size, reference + i * size, size) != 0) {
+                bad++;
+            }
+            i++;
+        }
+        return bad;
+    }
+    unsigned int bad = 0;
+    unsigned int i = 0;
+    while (i < samples) {
+        int16_t a, b;
+        memcpy(&a, result + i * 2, sizeof(a));
+        memcpy(&b, reference + i * 2, sizeof(b));
+        if (abs((int)a - (int)b) > 1) {
+            bad++;
+        }
+        i++;
+    }
+    return bad;
+}
+
+static double benchpair(unsigned int sourceformat, unsigned int targetformat,
+char* buffer, char* sourcebuf, unsigned int samples, int iterations) {
+    audioconvertkernel_func convert = audioconvertkernel_Get(sourceformat,
+    targetformat);
+    unsigned int sourcesize = audioconvertkernel_SampleSize(sourceformat);
+    unsigned int targetsize = audioconvertkernel_SampleSize(targetformat);
+    fillsine(sourcebuf, sourceformat, samples);
+
+    double cpuseconds = 0;
+    int i = 0;
+    while (i < iterations) {
+        // set up the source data like audiosourceformatconvert_Read does:
+        char* source = sourcebuf;
+        if (targetsize >= sourcesize) {
+            source = buffer + samples * (targetsize - sourcesize);
+            memcpy(source, sourcebuf, samples * sourcesize);
+        }
+        clock_t start = clock();
+        convert(buffer, source, samples);
+        cpuseconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+        i++;
+    }
+    return cpuseconds;
+}
+
+int main(int argc, char** argv) {
+    double seconds = 10;
+    int iterations = 20;
+    if (argc > 1) {
+        seconds = atof(argv[1]);
+    }
+    if (argc > 2) {
+        iterations = atoi(argv[2]);
+    }
+    unsigned int samples = (unsigned int)(seconds * 48000) * 2;
+    if (samples == 0 || iterations <= 0) {
+        printf("Usage: convertbench [seconds per block] [iterations]\n");
+        return 1;
+    }
+
+    char* buffer = malloc(samples * 4);
+    char* sourcebuf = malloc(samples * 4);
+    if (!buffer || !sourcebuf) {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    double audioseconds = seconds * iterations;
+    printf("Converting %.1f seconds of 48kHz stereo audio per format pair\n",
+    audioseconds);
+
+    // time all pairs with the C kernels (which are in use until
+    // the kernels are initialised), then with the picked ones:
+    double times[2][AUDIOSOURCEFORMAT_S32LE + 1][AUDIOSOURCEFORMAT_S32LE + 1];
+    char* reference[AUDIOSOURCEFORMAT_S32LE + 1][AUDIOSOURCEFORMAT_S32LE + 1];
+    memset(reference, 0, sizeof(reference));
+    int failed = 0;
+    int pass = 0;
+    while (pass < 2) {
+        if (pass == 1) {
+            // f32le -> s16le uses the mixer's kernel, so set up both:
+            audiomixerkernel_Init();
+            audioconvertkernel_Init();
+        }
+        unsigned int sourceformat = AUDIOSOURCEFORMAT_U8;
+        while (sourceformat <= AUDIOSOURCEFORMAT_S32LE) {
+            unsigned int targetformat = AUDIOSOURCEFORMAT_U8;
+            while (targetformat <= AUDIOSOURCEFORMAT_S32LE) {
+                if (audioconvertkernel_Get(sourceformat, targetformat)) {
+                    times[pass][sourceformat][targetformat] = benchpair(
+                    sourceformat, targetformat, buffer, sourcebuf,
+                    samples, iterations);
+                    unsigned int outputbytes = samples *
+                    audioconvertkernel_SampleSize(targetformat);
+                    if (pass == 0) {
+                        // keep the C kernel output to check against:
+                        reference[sourceformat][targetformat] =
+                        malloc(outputbytes);
+                        if (!reference[sourceformat][targetformat]) {
+                            printf("Out of memory\n");
+                            return 1;
+                        }
+                        memcpy(reference[sourceformat][targetformat],
+                        buffer, outputbytes);
+                    }else{
+                        unsigned int bad = comparepair(targetformat, buffer,
+                        reference[sourceformat][targetformat], samples);
+                        if (bad > 0) {
+                            printf("Error: %s -> %s: %u of %u samples differ "
+                            "from the C kernel\n", formatname(sourceformat),
+                            formatname(targetformat), bad, samples);
+                            failed = 1;
+                        }
+                        free(reference[sourceformat][targetformat]);
+                        reference[sourceformat][targetformat] = NULL;
+                    }
+                }
+                targetformat++;
+            }
+            sourceformat++;
+        }
+        pass++;
+    }
+
+    // report results:
+    double msamples = (samples / 1000000.0) * iterations;
+    unsigned int sourceformat = AUDIOSOURCEFORMAT_U8;
+    while (sourceformat <= AUDIOSOURCEFORMAT_S32LE) {
+        unsigned int targetformat = AUDIOSOURCEFORMAT_U8;
+        while (targetformat <= AUDIOSOURCEFORMAT_S32LE) {
+            if (audioconvertkernel_Get(sourceformat, targetformat)) {
+                double ctime = times[0][sourceformat][targetformat];
+                double kerneltime = times[1][sourceformat][targetformat];
+                printf("%5s -> %-5s  c: %8.1f Msamples/s  %s: %8.1f Msamples/s\n",
+                formatname(sourceformat), formatname(targetformat),
+                ctime > 0 ? msamples / ctime : 0,
+                audioconvertkernel_GetName(),
+                kerneltime > 0 ? msamples / kerneltime : 0);
+            }
+            targetformat++;
+        }
+        sourceformat++;
+    }
+
+    free(buffer);
+    free(sourcebuf);
+    return failed;
+}
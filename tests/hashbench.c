@@ -0,0 +1,193 @@
+
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+// Hash map benchmark.
+//
+// This registers a number of texture-like names both in the hash map of
+// hash.c and in a copy of the fixed size table with chained buckets it
+// replaced (1M buckets, as used for the texture list before), then
+// reports the average lookup latency and the memory used by each.
+//
+// Build it with "make hashbench" in the tests directory, then run:
+//   ./hashbench [names] [lookups]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+
+// The old table: a fixed amount of buckets with the entries chained up
+// through a pointer in the entry itself.
+#define OLDBUCKETS (1024 * 1024)
+
+struct oldentry {
+    char* name;
+    struct oldentry* hashbucketnext;
+};
+
+struct oldtable {
+    uint32_t size;
+    void** items;
+};
+
+static struct oldtable* oldtable_New(uint32_t size) {
+    struct oldtable* t = malloc(sizeof(*t));
+    if (!t) {
+        return NULL;
+    }
+    t->items = malloc(sizeof(void*) * size);
+    if (!t->items) {
+        free(t);
+        return NULL;
+    }
+    memset(t->items, 0, sizeof(void*) * size);
+    t->size = size;
+    return t;
+}
+
+static void oldtable_Add(struct oldtable* t, struct oldentry* e) {
+    uint32_t i = fnv_32_upper_buf(e->name, strlen(e->name)) % t->size;
+    e->hashbucketnext = t->items[i];
+    t->items[i] = e;
+}
+
+static struct oldentry* oldtable_Get(struct oldtable* t, const char* name) {
+    uint32_t i = fnv_32_upper_buf(name, strlen(name)) % t->size;
+    struct oldentry* e = t->items[i];
+    while (e && !(strcasecmp(e->name, name) == 0)) {
+        e = e->hashbucketnext;
+    }
+    return e;
+}
+
+static double now(void) {
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv) {
+    int count = 200;
+    int lookups = 10000000;
+    if (argc > 1) {
+        count = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        lookups = atoi(argv[2]);
+    }
+    if (count <= 0 || lookups <= 0) {
+        printf("Usage: hashbench [names] [lookups]\n");
+        return 1;
+    }
+
+    // make up some texture names:
+    struct oldentry* entries = malloc(sizeof(*entries) * count);
+    int* order = malloc(sizeof(*order) * lookups);
+    if (!entries || !order) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    int i = 0;
+    while (i < count) {
+        char name[64];
+        snprintf(name, sizeof(name), "gfx/sprites/sprite%d.png", i);
+        entries[i].name = strdup(name);
+        i++;
+    }
+    // look up the names in random order:
+    srand(1);
+    i = 0;
+    while (i < lookups) {
+        order[i] = rand() % count;
+        i++;
+    }
+
+    // set up both tables:
+    double start = now();
+    struct oldtable* oldtable = oldtable_New(OLDBUCKETS);
+    i = 0;
+    while (i < count) {
+        oldtable_Add(oldtable, &entries[i]);
+        i++;
+    }
+    double oldsetup = now() - start;
+    start = now();
+    hashmap* h = hashmap_New(0, 1);
+    i = 0;
+    while (i < count) {
+        if (!hashmap_Set(h, entries[i].name, &entries[i])) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        i++;
+    }
+    double newsetup = now() - start;
+
+    // time the lookups:
+    int found = 0;
+    start = now();
+    i = 0;
+    while (i < lookups) {
+        if (oldtable_Get(oldtable, entries[order[i]].name)) {
+            found++;
+        }
+        i++;
+    }
+    double oldtime = now() - start;
+    start = now();
+    i = 0;
+    while (i < lookups) {
+        if (hashmap_Get(h, entries[order[i]].name)) {
+            found++;
+        }
+        i++;
+    }
+    double newtime = now() - start;
+    if (found != lookups * 2) {
+        printf("Lookup failed!\n");
+        return 1;
+    }
+
+    // report results:
+    printf("%d names, %d lookups\n", count, lookups);
+    printf("old chained table: %6.1f ns per lookup, setup %.3f ms, "
+    "%zu KB (%u buckets)\n",
+    (oldtime * 1000000000.0) / lookups, oldsetup * 1000.0,
+    (sizeof(void*) * oldtable->size) / 1024, oldtable->size);
+    printf("open addressing:   %6.1f ns per lookup, setup %.3f ms, "
+    "%zu KB (%u slots)\n",
+    (newtime * 1000000000.0) / lookups, newsetup * 1000.0,
+    (sizeof(struct hashmapentry) * h->size) / 1024, h->size);
+
+    hashmap_Free(h);
+    free(oldtable->items);
+    free(oldtable);
+    i = 0;
+    while (i < count) {
+        free(entries[i].name);
+        i++;
+    }
+    free(entries);
+    free(order);
+    return 0;
+}
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# This test confirms the -renderaudio option works.
+# It renders one second of game audio playing a short test sound
+# to a .wav file (48kHz float stereo) and compares it against
+# the checked-in reference rendering.
+
+source preparetest.sh
+
+echo "local sound = blitwiz.audio.simpleSound:new(\"luatests/renderaudio-sound.wav\")
+sound:play()
+function blitwiz.on_step()
+end" > ./test.lua
+$RUNBLITWIZARD -renderaudio ./testoutput.wav 1 ./test.lua > /dev/null
+rm ./test.lua
+
+# float mixing may differ in the last bits between machines,
+# which wavcompare tolerates:
+$RUNBINARY./wavcompare$EXEEXT ./testoutput.wav luatests/renderaudio-reference.wav
+result=$?
+rm ./testoutput.wav
+
+if [ "x$result" = "x0" ]; then
+    exit 0
+else
+    exit 1
+fi
@@ -0,0 +1,121 @@
+#!/bin/bash
+
+# This test confirms the blitwiz.audio sound objects work.
+# It writes a short silent .wav file, then creates, plays, adjusts,
+# moves and stops sound objects on it while rendering audio with
+# -renderaudio (so no sound device is needed), and checks wrong
+# arguments are reported as errors.
+
+source preparetest.sh
+
+cat > ./test.lua <<'EOF'
+-- write a tenth of a second of silence (48kHz mono 16bit):
+local function le(value, bytes)
+    local s = ""
+    for i = 1, bytes do
+        s = s .. string.char(value % 256)
+        value = math.floor(value / 256)
+    end
+    return s
+end
+local frames = 4800
+local f = io.open("soundobjects.wav", "wb")
+f:write("RIFF" .. le(36 + frames * 2, 4) .. "WAVEfmt " .. le(16, 4) ..
+    le(1, 2) .. le(1, 2) .. le(48000, 4) .. le(96000, 4) .. le(2, 2) ..
+    le(16, 2) .. "data" .. le(frames * 2, 4) ..
+    string.rep("\0", frames * 2))
+f:close()
+
+-- missing files are reported when creating the object:
+if pcall(function()
+    blitwiz.audio.simpleSound:new("soundobjects-missing.wav")
+end) then
+    error("missing sound file not reported")
+end
+
+local simple = blitwiz.audio.simpleSound:new("soundobjects.wav")
+simple:setPriority(7)
+simple:play(0.5)
+simple:play()  -- does nothing, it plays already
+simple:adjust(0.8)
+simple:stop()
+simple:play(1, false, 0.05)
+simple:stop(0.05)
+
+local panned = blitwiz.audio.pannedSound:new("soundobjects.wav")
+panned:setPriority(0)
+panned:play(1, -0.5, true)
+if pcall(function() panned:play("loud") end) then
+    error("wrong volume type not reported")
+end
+if pcall(function() panned:setPriority() end) then
+    error("missing priority not reported")
+end
+panned:stop()
+
+blitwiz.audio.setListenerPosition(1, 2)
+blitwiz.audio.setDistanceModel(1, 100, 0.5)
+local positioned = blitwiz.audio.positionedSound:new("soundobjects.wav")
+local other = blitwiz.audio.positionedSound:new("soundobjects.wav")
+positioned:setPosition(5, 0)
+positioned:play(1, true)
+positioned:setPosition(-3, 4, 1)
+positioned:adjust(0.3)
+blitwiz.audio.setSoundPositions({positioned, 2, 2, 0, other, 0, 0, 0})
+if pcall(function()
+    blitwiz.audio.setSoundPositions({positioned, 2, 2})
+end) then
+    error("incomplete position list not reported")
+end
+if pcall(function()
+    blitwiz.audio.setSoundPositions({simple, 2, 2, 0})
+end) then
+    error("non-positioned sound in position list not reported")
+end
+positioned:stop()
+
+blitwiz.audio.setBusVolume("music", 0.5, 0.1)
+blitwiz.audio.setBusMute("ui", true)
+blitwiz.audio.setBusMute("ui", false)
+local music = blitwiz.audio.simpleSound:new("soundobjects.wav", "music")
+music:play()
+music:stop()
+if pcall(function()
+    blitwiz.audio.simpleSound:new("soundobjects.wav", "nosuchbus")
+end) then
+    error("unknown bus not reported")
+end
+if pcall(function() blitwiz.audio.setBusVolume("sfx") end) then
+    error("missing bus volume not reported")
+end
+
+local now = blitwiz.audio.getMixClock()
+if type(now) ~= "number" or now < 0 then
+    error("invalid mix clock")
+end
+local first = blitwiz.audio.simpleSound:new("soundobjects.wav", "music")
+local second = blitwiz.audio.simpleSound:new("soundobjects.wav", "music")
+first:schedule(now + 0.05, 1, true, 0.01)
+second:crossfade(first, 0.1, 0.5, true, now + 0.1)
+if pcall(function() second:crossfade("first", 0.1) end) then
+    error("wrong crossfade sound not reported")
+end
+second:stop()
+
+print("xxokyy")
+function blitwiz.on_step()
+end
+EOF
+$RUNBLITWIZARD -renderaudio ./testoutput.wav 0.5 ./test.lua > ./testoutput
+rm ./test.lua
+rm -f ./soundobjects.wav
+rm -f ./testoutput.wav
+
+testoutput="`cat ./testoutput | grep xx | sed 's/[ \n\r]*$//g'`"
+rm ./testoutput
+
+if [ "x$testoutput" = "xxxokyy" ]; then
+    exit 0
+else
+    exit 1
+fi
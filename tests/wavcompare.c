@@ -0,0 +1,189 @@
+/* blitwizard game engine - source code file
+
+  Copyright (C) 2011-2013 Jonas Thiem
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+// Compares a .wav file of 32bit float samples (as written by
+// -renderaudio) against a reference file, sample by sample.
+//
+// Mixing is done in floating point, so results might differ in the
+// last bits between compilers and CPUs. Samples may therefore differ
+// by the given tolerance (default: 0.0001, way below anything audible).
+//
+// It is built by "make check" in the tests directory and used by
+// luatests/renderaudio.sh:
+//   ./wavcompare file.wav reference.wav [tolerance]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define DEFAULTTOLERANCE 0.0001
+
+struct wavfile {
+    unsigned int channels;
+    unsigned int samplerate;
+    unsigned int frames;
+    float* samples;
+};
+
+static uint32_t read32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+    ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static int wavfile_Load(const char* path, struct wavfile* w) {
+    // read the whole file:
+    memset(w, 0, sizeof(*w));
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Cannot open \"%s\"\n", path);
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 12) {
+        printf("\"%s\" is too short for a .wav file\n", path);
+        fclose(f);
+        return 0;
+    }
+    unsigned char* data = malloc(size);
+    if (!data) {
+        printf("Out of memory\n");
+        fclose(f);
+        return 0;
+    }
+    if (fread(data, 1, size, f) != (size_t)size) {
+        printf("Cannot read \"%s\"\n", path);
+        free(data);
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+    if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+        printf("\"%s\" is not a .wav file\n", path);
+        free(data);
+        return 0;
+    }
+
+    // walk the chunks for the format and the samples:
+    int haveformat = 0;
+    long pos = 12;
+    while (pos + 8 <= size) {
+        uint32_t chunksize = read32(data + pos + 4);
+        const unsigned char* chunk = data + pos + 8;
+        if (chunksize > (uint32_t)(size - pos - 8)) {
+            chunksize = size - pos - 8;
+        }
+        if (memcmp(data + pos, "fmt ", 4) == 0 && chunksize >= 16) {
+            if (read16(chunk) != 3 || read16(chunk + 14) != 32) {
+                printf("\"%s\" doesn't contain 32bit float samples\n",
+                path);
+                free(data);
+                return 0;
+            }
+            w->channels = read16(chunk + 2);
+            w->samplerate = read32(chunk + 4);
+            haveformat = 1;
+        } else if (memcmp(data + pos, "data", 4) == 0 && haveformat &&
+        w->channels > 0) {
+            w->frames = chunksize / (4 * w->channels);
+            if (w->frames == 0) {
+                break;
+            }
+            w->samples = malloc(sizeof(float) * w->frames * w->channels);
+            if (!w->samples) {
+                printf("Out of memory\n");
+                free(data);
+                return 0;
+            }
+            // .wav data is little endian:
+            unsigned int i = 0;
+            while (i < w->frames * w->channels) {
+                uint32_t value = read32(chunk + i * 4);
+                memcpy(&w->samples[i], &value, sizeof(float));
+                i++;
+            }
+            free(data);
+            return 1;
+        }
+        pos += 8 + chunksize + (chunksize % 2);
+    }
+    printf("\"%s\" has no audio data\n", path);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage: wavcompare file.wav reference.wav [tolerance]\n");
+        return 1;
+    }
+    double tolerance = DEFAULTTOLERANCE;
+    if (argc >= 4) {
+        tolerance = atof(argv[3]);
+    }
+
+    struct wavfile file, reference;
+    if (!wavfile_Load(argv[1], &file) ||
+    !wavfile_Load(argv[2], &reference)) {
+        return 1;
+    }
+    if (file.channels != reference.channels ||
+    file.samplerate != reference.samplerate ||
+    file.frames != reference.frames) {
+        printf("Format differs: %u channels, %uHz, %u frames "
+        "(reference: %u channels, %uHz, %u frames)\n",
+        file.channels, file.samplerate, file.frames,
+        reference.channels, reference.samplerate, reference.frames);
+        return 1;
+    }
+
+    // find the largest difference and how many samples are off:
+    double maxdifference = 0;
+    unsigned int maxdifferenceframe = 0;
+    unsigned int bad = 0;
+    unsigned int i = 0;
+    while (i < file.frames * file.channels) {
+        double difference = fabs((double)file.samples[i] -
+        (double)reference.samples[i]);
+        if (difference > maxdifference || difference != difference) {
+            maxdifference = difference;
+            maxdifferenceframe = i / file.channels;
+        }
+        if (!(difference <= tolerance)) {
+            bad++;
+        }
+        i++;
+    }
+    printf("%u frames, largest difference %g at frame %u, "
+    "%u samples off by more than %g\n", file.frames, maxdifference,
+    maxdifferenceframe, bad, tolerance);
+    free(file.samples);
+    free(reference.samples);
+    return (bad > 0);
+}